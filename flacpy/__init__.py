@@ -1,3 +1,7 @@
-from ._flacpy import load, save, FLACAudio
+from collections.abc import Mapping as _Mapping
+from ._flacpy import load, load_async, load_many, build_index, overview, scan, iter_chunks, save, encode, update_metadata, stats, open, FLACAudio, Writer, Metadata, DecoderPool
 
-__all__ = ['load', 'save', 'FLACAudio']
\ No newline at end of file
+_Mapping.register(Metadata)
+
+# open is left out of __all__ so that star imports don't shadow the builtin
+__all__ = ['load', 'load_async', 'load_many', 'build_index', 'overview', 'scan', 'iter_chunks', 'save', 'encode', 'update_metadata', 'stats', 'FLACAudio', 'Writer', 'Metadata', 'DecoderPool']
\ No newline at end of file
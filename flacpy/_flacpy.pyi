@@ -1,59 +1,633 @@
-from typing import Dict, Any, Union, Optional, TypedDict, List
+from typing import Dict, Any, Union, Optional, TypedDict, List, Sequence, Tuple, Iterator, Mapping, Literal, overload
+import os
+import asyncio
 import numpy as np
 from numpy.typing import NDArray
 
+# a path, a bytes-like object holding a whole FLAC stream,
+# or a (path, offset, length) window of a larger file that gets memory-mapped
+FLACSource = Union[str, os.PathLike[str], bytes, bytearray, memoryview, Tuple[Union[str, os.PathLike[str]], int, int]]
+
+class Metadata(Mapping[str, Any]):
+    """
+    Read-only mapping of a stream's metadata, returned by load and FLACAudio.metadata. The
+    metadata blocks are kept as decoded and a key's value is only built the first time it is
+    accessed, so stream info can be read without converting tags or cover art. Picture
+    "data" is a read-only memoryview of the block itself, call bytes() on it for a copy.
+    """
+    def keys(self) -> List[str]: ...  # type: ignore[override]
+    def values(self) -> List[Any]: ...  # type: ignore[override]
+    def items(self) -> List[Tuple[str, Any]]: ...  # type: ignore[override]
+    def to_dict(self) -> Dict[str, Any]:
+        """Plain dict of every key, values are shared with the mapping."""
+        ...
+
 class FLACAudio:
-    """FLAC audio container class."""
-    pass
+    """
+    Open FLAC stream for repeated reads, returned by open. The decoder and the parsed
+    metadata are kept between reads, and reading on from where the previous read stopped
+    continues decoding without seeking. Can be shared between threads: reads run one at a
+    time, and seek, position and closed wait for a read in progress.
+    """
+    def __init__(self, filename: FLACSource) -> None: ...
+    @property
+    def metadata(self) -> Metadata:
+        """
+        The same Metadata on every access. Its tag dict and picture list are built once and
+        shared by every caller, so copy them (copy.deepcopy) before making changes.
+        """
+        ...
+    @property
+    def channels(self) -> int: ...
+    @property
+    def sample_rate(self) -> int: ...
+    @property
+    def bits_per_sample(self) -> int: ...
+    @property
+    def total_samples(self) -> int:
+        """Length in samples, 0 if the stream doesn't say."""
+        ...
+    @property
+    def position(self) -> int:
+        """Sample the next read without a start_sample begins at."""
+        ...
+    @property
+    def closed(self) -> bool: ...
+    def read(self, start_sample: Optional[int] = None, num_samples: int = 0) -> NDArray[np.int32]:
+        """
+        Read audio as a (frames × channels) array.
+        
+        Args:
+            start_sample: Sample index to start reading from (None = the current position)
+            num_samples: Number of samples to read (0 = all remaining)
+        """
+        ...
+    def seek(self, sample: int) -> int:
+        """Set the position the next read starts from."""
+        ...
+    def close(self) -> None: ...
+    def __enter__(self) -> "FLACAudio": ...
+    def __exit__(self, *args: Any) -> None: ...
+
+def open(filename: FLACSource) -> FLACAudio:
+    """
+    Open a FLAC file for repeated reads, parsing its metadata once.
+    
+    Args:
+        filename: Source to open, anything accepted by load
+        
+    Returns:
+        FLACAudio reader
+    """
+    ...
+
+# named encoder settings accepted by save and encode
+EncoderPreset = Literal["fast", "balanced", "small", "archive"]
+
+# dtypes load can decode straight into
+SampleDType = Union[type, str, np.dtype]
 
 class AudioData(TypedDict):
-    audio: NDArray[np.int32]
+    audio: NDArray[Any]  # int32 unless load was given a dtype
     sample_rate: int
     bits_per_sample: int
-    metadata: Dict[str, Any]
+    metadata: Metadata
 
 class MetadataData(TypedDict):
-    metadata: Dict[str, Any]
+    metadata: Metadata
 
 def load(
-    filename: str,
+    filename: FLACSource,
     start_sample: int = 0,
     num_samples: int = 0,
-    metadata_only: bool = False
+    metadata_only: bool = False,
+    index: Optional[Union[NDArray[np.uint64], str, os.PathLike[str]]] = None,
+    dtype: Optional[SampleDType] = None,
+    normalize: bool = False,
+    threads: int = 1,
+    channels: Optional[Sequence[int]] = None,
+    downmix: Optional[str] = None,
+    out: Optional[Any] = None,
+    out_offset: int = 0,
+    return_stats: bool = False
 ) -> Union[AudioData, MetadataData]:
     """
     Load a FLAC file with optional offset and length.
     
     Args:
-        filename: Path to the FLAC file
+        filename: Path to the FLAC file, a bytes-like object holding a FLAC stream, or a
+            (path, offset, length) tuple addressing a stream inside a larger file (length 0 = to the end)
         start_sample: Sample index to start loading from
         num_samples: Number of samples to load (0 = all remaining)
         metadata_only: If True, only load metadata without audio
+        index: Frame index from build_index, or the path of a saved index. Decoding starts
+            at the frame holding start_sample and only STREAMINFO is read from the metadata.
+            An index that no longer matches the stream raises RuntimeError
+        dtype: int16, int32 (default), float32 or float64. Samples are converted as they are
+            decoded, so no second array is made. Without normalize, values are the stream's own
+            integers, and int16 needs a stream of at most 16 bits
+        normalize: Scale floats to [-1, 1) and shift integers so the stream's full scale is the
+            dtype's full scale
+        threads: Number of decoder threads (0 = one per core). Long ranges are split into
+            slices, aligned to seekpoints or indexed frames where possible, that are decoded
+            side by side straight into the output array
+        channels: Stream channels to keep, in output order. The others are never copied
+        downmix: "mono" averages the kept channels (all by default) into a single channel
+        out: Writable int16, int32, float32 or float64 buffer of shape (frames, channels), or
+            (frames,) for a single output channel, to decode into instead of a new array. Strided
+            views such as a slice of a batch array are written in place. The dtype defaults to
+            out's own, and frames past the end of the stream are left untouched
+        out_offset: Frame of out where decoding starts
+        return_stats: Also return this call's phase timings and counters under "stats", in the
+            form of stats()["load"]. They are added to the module-wide totals as well
         
     Returns:
-        Dictionary containing audio data and/or metadata
+        Dictionary containing audio data and/or metadata. With out, "audio" is a view of the
+        frames written
+    """
+    ...
+
+def load_async(
+    filename: FLACSource,
+    start_sample: int = 0,
+    num_samples: int = 0,
+    metadata_only: bool = False,
+    index: Optional[Union[NDArray[np.uint64], str, os.PathLike[str]]] = None,
+    dtype: Optional[SampleDType] = None,
+    normalize: bool = False,
+    threads: int = 1,
+    channels: Optional[Sequence[int]] = None,
+    downmix: Optional[str] = None,
+    out: Optional[Any] = None,
+    out_offset: int = 0,
+    return_stats: bool = False,
+    timeout: Optional[float] = None
+) -> asyncio.Future[Union[AudioData, MetadataData]]:
+    """
+    Load a FLAC file like load, but on a worker thread. Must be called from a running event
+    loop, the returned future is resolved on that loop and decoding never holds the GIL.
+    
+    Loads run on the module's thread pool, leaving one of its workers free for threaded loads
+    and saves (on a single-core host they share the only one), and raise
+    RuntimeError up front if too many are already waiting. Cancelling the future stops the
+    decoder at its next frame.
+    
+    Args:
+        filename, start_sample, num_samples, metadata_only, index, dtype, normalize, threads,
+        channels, downmix, out, out_offset, return_stats: As for load. out stays exported, and
+            so can't be resized, until the future is done
+        timeout: Seconds from the call after which the future fails with TimeoutError and the
+            decoder stops, time spent waiting for a worker included
+        
+    Returns:
+        Future of the dictionary load would return
+    """
+    ...
+
+class FLACChunkIterator(Iterator[NDArray[np.int32]]):
+    """Iterator over fixed-size chunks of a FLAC stream, returned by iter_chunks."""
+    def __next__(self) -> NDArray[np.int32]: ...
+    def close(self) -> None:
+        """Stop decoding ahead and release the underlying file."""
+        ...
+
+def iter_chunks(
+    filename: FLACSource,
+    chunk_samples: int,
+    start_sample: int = 0,
+    num_samples: int = 0,
+    prefetch: int = 1
+) -> FLACChunkIterator:
+    """
+    Iterate over a FLAC file in fixed-size chunks without holding the whole range in memory.
+    
+    Args:
+        filename: Source to read, anything accepted by load
+        chunk_samples: Number of samples per chunk, the last chunk may be shorter
+        start_sample: Sample index to start reading from
+        num_samples: Number of samples to read (0 = all remaining)
+        prefetch: Number of chunks decoded ahead on a background thread (0 = decode on demand)
+        
+    Returns:
+        Iterator of (frames × channels) int32 arrays
+    """
+    ...
+
+def build_index(
+    filename: FLACSource,
+    save_path: Optional[Union[str, os.PathLike[str]]] = None
+) -> NDArray[np.uint64]:
+    """
+    Index every frame of a FLAC file for fast repeated partial loads.
+    
+    Args:
+        filename: Source to index, anything accepted by load
+        save_path: Optional path to also save the index to as a compact binary sidecar, which
+            records the stream's STREAMINFO and length so it can't be used once the file changes
+        
+    Returns:
+        (frames × 2) array of (first sample, byte offset) rows, offsets relative to the start of the source
+    """
+    ...
+
+class OverviewData(TypedDict):
+    min: NDArray[np.int32]
+    max: NDArray[np.int32]
+    rms: NDArray[np.float64]
+    block: int
+    num_samples: int
+    sample_rate: int
+    bits_per_sample: int
+
+def overview(
+    filename: FLACSource,
+    bins: int = 1000,
+    block: int = 0,
+    start_sample: int = 0,
+    num_samples: int = 0
+) -> OverviewData:
+    """
+    Compute a per-bin min/max/RMS summary of a FLAC file for waveform displays and QA. The
+    summary is accumulated as frames are decoded, so memory use only depends on the number
+    of bins and the samples themselves are never stored.
+    
+    Args:
+        filename: Source to summarize, anything accepted by load
+        bins: Number of bins to split the range into
+        block: Samples per bin, used instead of bins when given (needed for streams that
+            don't report their length)
+        start_sample: Sample index to start from
+        num_samples: Number of samples to summarize (0 = all remaining)
+        
+    Returns:
+        Dictionary with (bins × channels) min, max and rms arrays in sample units, the
+        samples per bin and the number of samples summarized. The last bin may be partial
+    """
+    ...
+
+class ScanData(TypedDict, total=False):
+    sample_rate: NDArray[np.uint32]
+    channels: NDArray[np.int32]
+    bits_per_sample: NDArray[np.int32]
+    total_samples: NDArray[np.uint64]
+    valid: NDArray[np.bool_]
+    errors: List[Optional[str]]
+    tags: Union[List[Dict[str, str]], Dict[str, List[Optional[str]]]]
+    pictures: List[List[Dict[str, Any]]]
+
+def scan(
+    filenames: Sequence[FLACSource],
+    fields: Optional[Sequence[str]] = None,
+    include_pictures: bool = False,
+    threads: int = 0
+) -> ScanData:
+    """
+    Read the stream info and tags of many FLAC files in parallel, for indexing large libraries.
+    Only the metadata header is read, natively and without libFLAC, and blocks that aren't
+    wanted (pictures unless asked for, the vorbis comment when fields is empty) are skipped
+    without being read.
+    
+    Args:
+        filenames: Sources to scan, anything accepted by load
+        fields: Tag names to collect, case-insensitive. None collects every tag
+        include_pictures: Also read embedded pictures
+        threads: Number of worker threads (0 = one per core)
+        
+    Returns:
+        Columnar dictionary with one entry per file: sample_rate, channels, bits_per_sample
+        and total_samples arrays, a valid array and an errors list (None for files that
+        were read). tags is a list of per-file dicts, or with fields a dict of one list per
+        field holding None where a file doesn't have it. pictures is a list of per-file
+        lists of picture dicts with the keys load uses, except that "data" is a bytes copy
+        rather than a memoryview, since scan doesn't keep the metadata blocks around
+    """
+    ...
+
+class BatchAudioData(AudioData, total=False):
+    num_samples: int
+
+def load_many(
+    filenames: Sequence[FLACSource],
+    start_samples: Optional[Union[int, Sequence[int]]] = None,
+    num_samples: Optional[Union[int, Sequence[int]]] = None,
+    threads: int = 0,
+    out: Optional[NDArray[np.int32]] = None
+) -> List[BatchAudioData]:
+    """
+    Load many FLAC files in parallel on a native thread pool.
+    
+    Args:
+        filenames: Sources to load, anything accepted by load
+        start_samples: Sample index to start loading from, per file or for all files
+        num_samples: Number of samples to load per file or for all files (0 = all remaining)
+        threads: Number of decode threads (0 = one per core)
+        out: Optional preallocated int32 array (files × frames × channels) to decode into,
+            rows are zero padded after shorter clips and longer clips are truncated
+        
+    Returns:
+        List of dictionaries containing audio data and metadata, in file order. When out
+        is given each audio entry is a view of its row and num_samples holds its length
     """
     ...
 
 def save(
     filename: str,
-    audio: NDArray[np.int32],
-    metadata: Optional[Dict[str, Any]] = None,
+    audio: NDArray[Any],
+    metadata: Optional[Mapping[str, Any]] = None,
     sample_rate: int = 44100,
     bits_per_sample: int = 16,
-    compression_level: int = 5,
-    metadata_pad_len: int = 0
+    compression_level: Optional[int] = None,
+    metadata_pad_len: int = 0,
+    threads: int = 1,
+    seekpoint_interval: Union[int, float] = 10.0,
+    normalize: bool = False,
+    dither: bool = False,
+    verify: Optional[bool] = None,
+    do_md5: Optional[bool] = None,
+    preset: Optional[EncoderPreset] = None,
+    blocksize: Optional[int] = None,
+    max_lpc_order: Optional[int] = None,
+    qlp_coeff_precision: Optional[int] = None,
+    apodization: Optional[str] = None,
+    exhaustive_model_search: Optional[bool] = None,
+    max_residual_partition_order: Optional[int] = None
 ) -> None:
     """
     Save audio data to a FLAC file with optional metadata.
     
     Args:
         filename: Path to save the FLAC file
-        audio: Audio data as 2D NumPy array (frames × channels)
-        metadata: Optional metadata dictionary
+        audio: Audio data as 2D NumPy array (frames × channels) of int16, int32, float32 or
+            float64, in any memory layout. It is read in place and quantized block by block
+            while encoding, so no full-size copy is made
+        metadata: Optional metadata mapping, a dict or a Metadata from load (picture data can be any buffer)
         sample_rate: Sample rate in Hz
         bits_per_sample: Bit depth of the saved audio
-        compression_level: FLAC compression level (0-8)
-        metadata_pad_len: Pad metadata blocks up to this length
+        compression_level: FLAC compression level (0-8, None = 5 or the preset's level)
+        metadata_pad_len: Pad metadata blocks, seektable included, up to this length
+        threads: Number of encoder threads (0 = one per core). Long inputs are split into
+            block-aligned chunks that are encoded in parallel and stitched into one stream
+        seekpoint_interval: Spacing of the seektable used by partial loads, an int counts
+            samples and a float counts seconds (0 = no seektable)
+        normalize: Treat the audio as full scale of its dtype, [-1, 1) for floats, and scale it
+            to bits_per_sample. Otherwise values are sample values as they are. Floats are
+            always rounded and clipped to the sample range
+        dither: Add triangular (TPDF) dither when quantizing float audio
+        verify: Decode every frame again inside libFLAC and compare it with the input. Catches
+            encoder bugs at roughly twice the CPU cost (None = on, unless the preset says otherwise)
+        do_md5: Store the MD5 of the audio in STREAMINFO (None = on, unless the preset says otherwise)
+        preset: Named starting point that the other arguments override: "fast" (level 0, no
+            verify, no MD5) for scratch and cache files, "balanced" (level 5, no verify),
+            "small" (level 8, no verify) or "archive" (level 8, exhaustive model search, verify)
+        blocksize: Samples per frame instead of the level's choice
+        max_lpc_order: Maximum LPC order (0 = fixed predictors only)
+        qlp_coeff_precision: Precision of the quantized LPC coefficients (0 = automatic)
+        apodization: libFLAC window specification, e.g. "tukey(5e-1);partial_tukey(2)"
+        exhaustive_model_search: Try every LPC order, slow but slightly smaller
+        max_residual_partition_order: Maximum Rice partition order (0-15)
+    """
+    ...
+
+@overload
+def encode(
+    audio: NDArray[Any],
+    metadata: Optional[Mapping[str, Any]] = None,
+    sample_rate: int = 44100,
+    bits_per_sample: int = 16,
+    compression_level: Optional[int] = None,
+    metadata_pad_len: int = 0,
+    threads: int = 1,
+    seekpoint_interval: Union[int, float] = 10.0,
+    out: None = None,
+    normalize: bool = False,
+    dither: bool = False,
+    verify: Optional[bool] = None,
+    do_md5: Optional[bool] = None,
+    preset: Optional[EncoderPreset] = None,
+    blocksize: Optional[int] = None,
+    max_lpc_order: Optional[int] = None,
+    qlp_coeff_precision: Optional[int] = None,
+    apodization: Optional[str] = None,
+    exhaustive_model_search: Optional[bool] = None,
+    max_residual_partition_order: Optional[int] = None
+) -> bytes: ...
+
+@overload
+def encode(
+    audio: NDArray[Any],
+    metadata: Optional[Mapping[str, Any]] = None,
+    sample_rate: int = 44100,
+    bits_per_sample: int = 16,
+    compression_level: Optional[int] = None,
+    metadata_pad_len: int = 0,
+    threads: int = 1,
+    seekpoint_interval: Union[int, float] = 10.0,
+    *,
+    out: Union[bytearray, memoryview],
+    normalize: bool = False,
+    dither: bool = False,
+    verify: Optional[bool] = None,
+    do_md5: Optional[bool] = None,
+    preset: Optional[EncoderPreset] = None,
+    blocksize: Optional[int] = None,
+    max_lpc_order: Optional[int] = None,
+    qlp_coeff_precision: Optional[int] = None,
+    apodization: Optional[str] = None,
+    exhaustive_model_search: Optional[bool] = None,
+    max_residual_partition_order: Optional[int] = None
+) -> int:
+    """
+    Encode audio data to a FLAC stream in memory, without touching the filesystem.
+    
+    Args:
+        audio: Audio data as 2D NumPy array (frames × channels)
+        metadata: Optional metadata mapping, a dict or a Metadata from load (picture data can be any buffer)
+        sample_rate: Sample rate in Hz
+        bits_per_sample: Bit depth of the encoded audio
+        compression_level: FLAC compression level (0-8, None = 5 or the preset's level)
+        metadata_pad_len: Pad metadata blocks, seektable included, up to this length
+        threads: Number of encoder threads (0 = one per core)
+        seekpoint_interval: Seektable spacing as in save
+        out: Optional writable buffer to encode into. Raises ValueError if the stream
+            does not fit
+        normalize: Input scaling as in save
+        dither: Dither float input as in save
+        verify, do_md5, preset, blocksize, max_lpc_order, qlp_coeff_precision, apodization,
+        exhaustive_model_search, max_residual_partition_order: Encoder options as in save
+        
+    Returns:
+        The encoded stream as bytes, or the number of bytes written when out is given
+    """
+    ...
+
+@overload
+def update_metadata(
+    filename: Union[str, os.PathLike[str]],
+    metadata: Mapping[str, Any],
+    threads: int = 0,
+    use_padding: bool = True
+) -> None: ...
+
+@overload
+def update_metadata(
+    filename: Sequence[Union[str, os.PathLike[str]]],
+    metadata: Union[Mapping[str, Any], Sequence[Mapping[str, Any]]],
+    threads: int = 0,
+    use_padding: bool = True
+) -> List[Optional[str]]:
+    """
+    Replace the tags and/or pictures of FLAC files without decoding or re-encoding the audio.
+    When the new blocks fit in the file's padding (see metadata_pad_len in save) only the
+    header is rewritten in place, otherwise the audio frames are copied unchanged into a
+    rewritten file.
+    
+    Args:
+        filename: Path of the file to edit, or a sequence of paths to edit in parallel
+        metadata: Mapping as accepted by save. "vorbis_comment" and "pictures" replace what the
+            file has (None or an empty list removes them), missing keys are left alone. The
+            old vendor string is kept unless a new one is given. With a sequence of paths this
+            can also be a sequence holding one mapping per file
+        threads: Number of worker threads for a sequence of paths (0 = one per core)
+        use_padding: Use and resize the file's padding, False always rewrites the file
+        
+    Returns:
+        None for a single path, which raises RuntimeError on failure. For a sequence of paths,
+        a list with None for every file that was updated and an error message otherwise
+    """
+    ...
+
+class LoadStatsData(TypedDict):
+    calls: int
+    total_ns: int
+    open_ns: int
+    metadata_ns: int
+    seek_ns: int  # seeking includes decoding the frame that holds the first sample
+    decode_ns: int
+    output_ns: int
+    bytes_read: int
+    frames_decoded: int
+    frames_skipped: int  # decoded before the requested range started
+    seeks: int
+
+class SaveStatsData(TypedDict):
+    calls: int
+    total_ns: int
+    convert_ns: int  # converting and interleaving input that isn't int32
+    encode_ns: int  # libFLAC's verify and md5 run inside the same calls
+    finish_ns: int
+    md5_ns: int  # only for streams encoded as stitched chunks on older libFLAC
+    write_ns: int  # likewise, sequential saves write from within encode_ns
+    samples_encoded: int
+
+class StatsData(TypedDict):
+    enabled: bool
+    load: LoadStatsData
+    save: SaveStatsData
+
+def stats(reset: bool = False, enable: Optional[bool] = None) -> StatsData:
+    """
+    Phase timings in nanoseconds and counters of every load and save, summed since import or the
+    last reset. Collection is off until enabled, except for loads given return_stats=True,
+    which are always counted. The counters are atomic, so loads and saves on other threads
+    keep adding to them without a lock. Phase times are summed over the threads a call used,
+    so with threads > 1 they can exceed total_ns.
+    
+    Args:
+        reset: Zero the totals after reading them
+        enable: Turn collection on or off for every call, None leaves it as it is
+        
+    Returns:
+        Dictionary with the collection state and the "load" and "save" totals
+    """
+    ...
+
+class DecoderPool:
+    """
+    Decoders and output memory reused across loads, for tight loops that load many clips.
+    Decoders are recycled instead of constructed per call, and output arrays are views of
+    pooled buffers that go back to the pool once the array is freed, so steady-state loads
+    don't fault in fresh pages. Safe to share between threads.
+    """
+    def __init__(self, max_decoders: int = 0, max_idle_bytes: int = 256 << 20) -> None:
+        """
+        Args:
+            max_decoders: Idle decoders kept for reuse (0 = one per core)
+            max_idle_bytes: Idle output memory kept for reuse, freed arrays beyond this are released
+        """
+        ...
+    def load(
+        self,
+        filename: FLACSource,
+        start_sample: int = 0,
+        num_samples: int = 0,
+        metadata_only: bool = False,
+        index: Optional[Union[NDArray[np.uint64], str, os.PathLike[str]]] = None,
+        dtype: Optional[SampleDType] = None,
+        normalize: bool = False,
+        threads: int = 1,
+        channels: Optional[Sequence[int]] = None,
+        downmix: Optional[str] = None,
+        out: Optional[Any] = None,
+        out_offset: int = 0,
+        return_stats: bool = False
+    ) -> Union[AudioData, MetadataData]:
+        """Load a FLAC file exactly like flacpy.load, with pooled decoders and output memory."""
+        ...
+    @property
+    def idle_decoders(self) -> int: ...
+    @property
+    def idle_bytes(self) -> int: ...
+
+class Writer:
+    """
+    Incremental FLAC encoder for audio that arrives in blocks, writing to a path, into a
+    caller-supplied writable buffer, or to memory (target=None, read back with getvalue).
     """
-    ...
\ No newline at end of file
+    def __init__(
+        self,
+        target: Union[str, os.PathLike[str], bytearray, memoryview, None],
+        channels: int,
+        sample_rate: int,
+        bits_per_sample: int = 16,
+        compression_level: int = 5,
+        metadata: Optional[Mapping[str, Any]] = None,
+        metadata_pad_len: int = 0,
+        total_samples: int = 0,
+        seekpoint_interval: Optional[Union[int, float]] = None,
+        background: bool = False,
+        max_queued: int = 4
+    ) -> None:
+        """
+        Args:
+            target: Path to write, writable buffer to fill, or None to encode to memory
+            channels: Number of channels in every block
+            sample_rate: Sample rate in Hz
+            bits_per_sample: Bit depth of the encoded audio
+            compression_level: FLAC compression level (0-8)
+            metadata: Optional metadata mapping, a dict or a Metadata from load (picture data can be any buffer)
+            metadata_pad_len: Pad metadata blocks, seektable included, up to this length
+            total_samples: Expected length if known in advance, needed to write a seektable
+            seekpoint_interval: Seektable spacing as in save, only used when total_samples is given
+            background: Encode on a background thread so write only copies the block
+            max_queued: Blocks that may wait for the background thread before write blocks
+        """
+        ...
+    @property
+    def samples_written(self) -> int: ...
+    @property
+    def bytes_written(self) -> Optional[int]:
+        """Size of the finished stream when writing to memory, None for files."""
+        ...
+    @property
+    def closed(self) -> bool: ...
+    def write(self, block: NDArray[np.int32]) -> None:
+        """Encode a (frames × channels) block of audio."""
+        ...
+    def close(self) -> None:
+        """Finish the stream, waiting for queued blocks to be encoded."""
+        ...
+    def getvalue(self) -> bytes:
+        """The encoded stream of a closed writer created with target=None."""
+        ...
+    def __enter__(self) -> "Writer": ...
+    def __exit__(self, *args: Any) -> None: ...
@@ -9,11 +9,12 @@ extra_link_args = []
 
 # platform-specific compiler optimization flags
 if platform.system() == "Linux":
-    extra_compile_args.extend(["-O3", "-march=native"])
+    extra_compile_args.extend(["-O3", "-march=native", "-std=c++17", "-pthread"])
+    extra_link_args.extend(["-pthread"])
 elif platform.system() == "Darwin":
-    extra_compile_args.extend(["-O3", "-march=native"])
+    extra_compile_args.extend(["-O3", "-march=native", "-std=c++17"])
 elif platform.system() == "Windows":
-    extra_compile_args.extend(["/O2", "/GL", "/LTCG", "/arch:AVX2"])
+    extra_compile_args.extend(["/O2", "/GL", "/LTCG", "/arch:AVX2", "/std:c++17"])
 
 flac_include_dir = os.environ.get("FLAC_INCLUDE_DIR", "/usr/include")
 flac_lib_dir = os.environ.get("FLAC_LIB_DIR", "/usr/lib/x86_64-linux-gnu")
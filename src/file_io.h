@@ -0,0 +1,207 @@
+/*
+MIT License
+
+Copyright (c) 2025 Christopher Friesen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef FLACPY_FILE_IO_H
+#define FLACPY_FILE_IO_H
+
+// portable 64-bit file access and read-only memory mapping
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+inline std::wstring utf8_to_wide(const char* text) {
+    int length = MultiByteToWideChar(CP_UTF8, 0, text, -1, NULL, 0);
+    std::wstring wide(length > 0 ? length : 1, L'\0');
+    if (length > 0) {
+        MultiByteToWideChar(CP_UTF8, 0, text, -1, &wide[0], length);
+    }
+    return wide;
+}
+#endif
+
+// fopen for utf-8 paths on every platform
+inline FILE* fopen_utf8(const char* path, const char* mode) {
+#ifdef _WIN32
+    return _wfopen(utf8_to_wide(path).c_str(), utf8_to_wide(mode).c_str());
+#else
+    return std::fopen(path, mode);
+#endif
+}
+
+inline int fseek64(FILE* file, int64_t offset, int origin) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, origin);
+#else
+    return fseeko(file, static_cast<off_t>(offset), origin);
+#endif
+}
+
+inline int64_t ftell64(FILE* file) {
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return static_cast<int64_t>(ftello(file));
+#endif
+}
+
+inline bool file_size64(FILE* file, uint64_t* size) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_fstat64(_fileno(file), &info) != 0) {
+        return false;
+    }
+#else
+    struct stat info;
+    if (fstat(fileno(file), &info) != 0) {
+        return false;
+    }
+#endif
+    *size = static_cast<uint64_t>(info.st_size);
+    return true;
+}
+
+// read-only mapping of a byte range of a file, length 0 maps to the end of the file
+class MappedFile {
+public:
+    MappedFile() : base_(nullptr), map_size_(0), data_(nullptr), size_(0) {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path, uint64_t offset, uint64_t length, std::string& error) {
+        close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileW(utf8_to_wide(path).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            error = std::string("Failed to open ") + path;
+            return false;
+        }
+        LARGE_INTEGER file_size;
+        GetFileSizeEx(file, &file_size);
+        uint64_t total = static_cast<uint64_t>(file_size.QuadPart);
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            error = std::string("Failed to open ") + path;
+            return false;
+        }
+        struct stat info;
+        uint64_t total = fstat(fd, &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+#endif
+
+        if (length == 0 && offset < total) {
+            length = total - offset;
+        }
+        bool ok = offset + length <= total && length > 0;
+        if (!ok) {
+            error = std::string("Byte range is outside of ") + path;
+        }
+
+        if (ok) {
+            // mappings have to start on an allocation boundary
+#ifdef _WIN32
+            SYSTEM_INFO system_info;
+            GetSystemInfo(&system_info);
+            uint64_t granularity = system_info.dwAllocationGranularity;
+#else
+            uint64_t granularity = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+            uint64_t map_offset = offset - offset % granularity;
+            map_size_ = static_cast<size_t>(length + (offset - map_offset));
+
+#ifdef _WIN32
+            HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping) {
+                base_ = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(map_offset >> 32),
+                                      static_cast<DWORD>(map_offset & 0xFFFFFFFF), map_size_);
+                CloseHandle(mapping);
+            }
+#else
+            void* base = mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(map_offset));
+            base_ = base == MAP_FAILED ? nullptr : base;
+#endif
+            ok = base_ != nullptr;
+            if (ok) {
+                data_ = static_cast<const uint8_t*>(base_) + (offset - map_offset);
+                size_ = static_cast<size_t>(length);
+            } else {
+                map_size_ = 0;
+                error = std::string("Failed to map ") + path;
+            }
+        }
+
+#ifdef _WIN32
+        CloseHandle(file);
+#else
+        ::close(fd);
+#endif
+        return ok;
+    }
+
+    void close() {
+        if (base_) {
+#ifdef _WIN32
+            UnmapViewOfFile(base_);
+#else
+            munmap(base_, map_size_);
+#endif
+        }
+        base_ = nullptr;
+        map_size_ = 0;
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    void* base_;
+    size_t map_size_;
+    const uint8_t* data_;
+    size_t size_;
+};
+
+#endif // FLACPY_FILE_IO_H
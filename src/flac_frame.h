@@ -0,0 +1,308 @@
+/*
+MIT License
+
+Copyright (c) 2025 Christopher Friesen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef FLACPY_FLAC_FRAME_H
+#define FLACPY_FLAC_FRAME_H
+
+// byte-level helpers for FLAC frame headers, for the places where we handle
+// encoded frames directly instead of going through libFLAC
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// crc-8 over frame headers, polynomial x^8 + x^2 + x + 1
+inline uint8_t flac_crc8(const uint8_t* data, size_t size, uint8_t crc = 0) {
+    static const struct Table {
+        uint8_t values[256];
+        Table() {
+            for (unsigned i = 0; i < 256; i++) {
+                uint8_t crc = static_cast<uint8_t>(i);
+                for (int bit = 0; bit < 8; bit++) {
+                    crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+                }
+                values[i] = crc;
+            }
+        }
+    } table;
+
+    for (size_t i = 0; i < size; i++) {
+        crc = table.values[crc ^ data[i]];
+    }
+    return crc;
+}
+
+// crc-16 over whole frames, polynomial x^16 + x^15 + x^2 + 1
+inline uint16_t flac_crc16(const uint8_t* data, size_t size, uint16_t crc = 0) {
+    static const struct Table {
+        uint16_t values[256];
+        Table() {
+            for (unsigned i = 0; i < 256; i++) {
+                uint16_t crc = static_cast<uint16_t>(i << 8);
+                for (int bit = 0; bit < 8; bit++) {
+                    crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x8005) : static_cast<uint16_t>(crc << 1);
+                }
+                values[i] = crc;
+            }
+        }
+    } table;
+
+    for (size_t i = 0; i < size; i++) {
+        crc = static_cast<uint16_t>((crc << 8) ^ table.values[(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+// append a frame or sample number in FLAC's extended utf-8 coding
+inline void flac_write_utf8(uint64_t value, std::vector<uint8_t>& out) {
+    if (value < 0x80) {
+        out.push_back(static_cast<uint8_t>(value));
+        return;
+    }
+
+    int extra_bytes = 1;
+    while (extra_bytes < 6 && value >= (uint64_t(1) << (6 + 5 * extra_bytes))) {
+        extra_bytes++;
+    }
+
+    uint8_t lead_mask = static_cast<uint8_t>(0xFF00 >> (extra_bytes + 1));
+    out.push_back(static_cast<uint8_t>(lead_mask | (value >> (6 * extra_bytes))));
+    for (int i = extra_bytes - 1; i >= 0; i--) {
+        out.push_back(static_cast<uint8_t>(0x80 | ((value >> (6 * i)) & 0x3F)));
+    }
+}
+
+// read a utf-8 coded number, returns the number of bytes used or 0 if the coding is invalid
+inline size_t flac_read_utf8(const uint8_t* data, size_t size, uint64_t* value) {
+    if (size == 0) {
+        return 0;
+    }
+
+    uint8_t lead = data[0];
+    size_t extra_bytes;
+    if (!(lead & 0x80)) {
+        *value = lead;
+        return 1;
+    } else if ((lead & 0xE0) == 0xC0) {
+        extra_bytes = 1;
+    } else if ((lead & 0xF0) == 0xE0) {
+        extra_bytes = 2;
+    } else if ((lead & 0xF8) == 0xF0) {
+        extra_bytes = 3;
+    } else if ((lead & 0xFC) == 0xF8) {
+        extra_bytes = 4;
+    } else if ((lead & 0xFE) == 0xFC) {
+        extra_bytes = 5;
+    } else if (lead == 0xFE) {
+        extra_bytes = 6;
+    } else {
+        return 0;
+    }
+
+    if (size < extra_bytes + 1) {
+        return 0;
+    }
+
+    uint64_t result = lead & (0x7F >> (extra_bytes + 1));
+    for (size_t i = 1; i <= extra_bytes; i++) {
+        if ((data[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        result = (result << 6) | (data[i] & 0x3F);
+    }
+
+    *value = result;
+    return extra_bytes + 1;
+}
+
+// the parts of a frame header we need to find, index or renumber frames
+struct FLACFrameHeader {
+    bool variable_blocksize;    // number is a sample number rather than a frame number
+    uint64_t number;
+    unsigned blocksize;
+    size_t number_offset;       // where the utf-8 coded number starts
+    size_t number_length;
+    size_t length;              // whole header including the crc-8
+};
+
+// parse and validate (sync, reserved bits, crc-8) the frame header at data
+inline bool flac_parse_frame_header(const uint8_t* data, size_t size, FLACFrameHeader* header) {
+    if (size < 6 || data[0] != 0xFF || (data[1] & 0xFE) != 0xF8) {
+        return false;
+    }
+
+    unsigned blocksize_code = data[2] >> 4;
+    unsigned sample_rate_code = data[2] & 0x0F;
+    unsigned channel_code = data[3] >> 4;
+    unsigned sample_size_code = (data[3] >> 1) & 0x07;
+    if (blocksize_code == 0 || sample_rate_code == 15 || channel_code > 10 ||
+        sample_size_code == 3 || (data[3] & 0x01)) {
+        return false;
+    }
+
+    header->variable_blocksize = (data[1] & 0x01) != 0;
+    header->number_offset = 4;
+    header->number_length = flac_read_utf8(data + 4, size - 4, &header->number);
+    if (header->number_length == 0 || (!header->variable_blocksize && header->number_length > 6)) {
+        return false;
+    }
+
+    size_t pos = 4 + header->number_length;
+    size_t blocksize_bytes = blocksize_code == 6 ? 1 : (blocksize_code == 7 ? 2 : 0);
+    size_t sample_rate_bytes = sample_rate_code == 12 ? 1 : (sample_rate_code >= 13 ? 2 : 0);
+    if (size < pos + blocksize_bytes + sample_rate_bytes + 1) {
+        return false;
+    }
+
+    if (blocksize_code == 1) {
+        header->blocksize = 192;
+    } else if (blocksize_code <= 5) {
+        header->blocksize = 576u << (blocksize_code - 2);
+    } else if (blocksize_code == 6) {
+        header->blocksize = data[pos] + 1u;
+    } else if (blocksize_code == 7) {
+        header->blocksize = ((unsigned(data[pos]) << 8) | data[pos + 1]) + 1u;
+    } else {
+        header->blocksize = 256u << (blocksize_code - 8);
+    }
+    pos += blocksize_bytes + sample_rate_bytes;
+
+    if (flac_crc8(data, pos) != data[pos]) {
+        return false;
+    }
+
+    header->length = pos + 1;
+    return true;
+}
+
+// append a copy of a complete encoded frame with its frame number replaced, recomputing
+// both the header crc-8 and the frame crc-16
+inline bool flac_renumber_frame(const uint8_t* frame, size_t size, uint64_t number, std::vector<uint8_t>& out) {
+    FLACFrameHeader header;
+    if (!flac_parse_frame_header(frame, size, &header) || size < header.length + 2) {
+        return false;
+    }
+
+    size_t frame_start = out.size();
+    out.insert(out.end(), frame, frame + header.number_offset);
+    flac_write_utf8(number, out);
+    out.insert(out.end(), frame + header.number_offset + header.number_length, frame + header.length - 1);
+    out.push_back(flac_crc8(out.data() + frame_start, out.size() - frame_start));
+
+    out.insert(out.end(), frame + header.length, frame + size - 2);
+    uint16_t crc = flac_crc16(out.data() + frame_start, out.size() - frame_start);
+    out.push_back(static_cast<uint8_t>(crc >> 8));
+    out.push_back(static_cast<uint8_t>(crc & 0xFF));
+    return true;
+}
+
+// size of an ID3v2 tag at the start of data, 0 if there is none
+inline size_t flac_id3v2_size(const uint8_t* data, size_t size) {
+    if (size < 10 || std::memcmp(data, "ID3", 3) != 0) {
+        return 0;
+    }
+    size_t length = (size_t(data[6] & 0x7F) << 21) | (size_t(data[7] & 0x7F) << 14) |
+                    (size_t(data[8] & 0x7F) << 7) | size_t(data[9] & 0x7F);
+    return 10 + length + ((data[5] & 0x10) ? 10 : 0);
+}
+
+// offset of the first frame, past any ID3v2 tag, the "fLaC" marker and every metadata block
+inline bool flac_find_first_frame(const uint8_t* data, size_t size, size_t* offset) {
+    size_t pos = flac_id3v2_size(data, size);
+    if (size < pos + 4 || std::memcmp(data + pos, "fLaC", 4) != 0) {
+        return false;
+    }
+    pos += 4;
+
+    bool last = false;
+    while (!last) {
+        if (size < pos + 4) {
+            return false;
+        }
+        last = (data[pos] & 0x80) != 0;
+        pos += 4 + ((size_t(data[pos + 1]) << 16) | (size_t(data[pos + 2]) << 8) | data[pos + 3]);
+    }
+    if (pos > size) {
+        return false;
+    }
+
+    *offset = pos;
+    return true;
+}
+
+// append a (first sample, byte offset) pair for every frame of a complete stream. frames don't
+// store their length, so each frame is taken to end at the next header carrying the expected
+// frame or sample number whose preceding bytes pass the frame's crc-16, which rules out
+// sync codes that merely happen to appear inside the audio data
+inline bool flac_index_frames(const uint8_t* data, size_t size, std::vector<uint64_t>& entries) {
+    size_t pos;
+    if (!flac_find_first_frame(data, size, &pos)) {
+        return false;
+    }
+    if (pos == size) {
+        return true;
+    }
+
+    FLACFrameHeader header;
+    if (!flac_parse_frame_header(data + pos, size - pos, &header)) {
+        return false;
+    }
+
+    uint64_t first_sample = 0;
+    for (;;) {
+        entries.push_back(first_sample);
+        entries.push_back(pos);
+
+        const uint64_t next_number = header.variable_blocksize ? header.number + header.blocksize : header.number + 1;
+        FLACFrameHeader next_header;
+        size_t next = pos + header.length + 2;
+        bool found = false;
+        while (next + 1 < size) {
+            const void* hit = std::memchr(data + next, 0xFF, size - next - 1);
+            if (!hit) {
+                break;
+            }
+            next = static_cast<const uint8_t*>(hit) - data;
+            if (data[next + 1] == data[pos + 1] &&
+                flac_parse_frame_header(data + next, size - next, &next_header) &&
+                next_header.number == next_number &&
+                flac_crc16(data + pos, next - pos - 2) == ((uint16_t(data[next - 2]) << 8) | data[next - 1])) {
+                found = true;
+                break;
+            }
+            next++;
+        }
+        if (!found) {
+            return true;
+        }
+
+        first_sample += header.blocksize;
+        pos = next;
+        header = next_header;
+    }
+}
+
+#endif // FLACPY_FLAC_FRAME_H
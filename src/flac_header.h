@@ -0,0 +1,274 @@
+/*
+MIT License
+
+Copyright (c) 2025 Christopher Friesen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#ifndef FLACPY_FLAC_HEADER_H
+#define FLACPY_FLAC_HEADER_H
+
+// reads the metadata at the start of a FLAC stream straight from its bytes, without libFLAC.
+// blocks nobody asked for are skipped over rather than read, which is what makes scanning
+// large libraries cheap
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "flac_frame.h"
+
+struct FLACHeaderPicture {
+    uint32_t type = 0;
+    std::string mime_type;
+    std::string description;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t depth = 0;
+    uint32_t colors = 0;
+    std::vector<uint8_t> data;
+};
+
+struct FLACHeaderInfo {
+    unsigned sample_rate = 0;
+    unsigned channels = 0;
+    unsigned bits_per_sample = 0;
+    uint64_t total_samples = 0;
+    std::string vendor;
+    std::vector<std::pair<std::string, std::string>> tags;  // (field, value) in stream order
+    std::vector<FLACHeaderPicture> pictures;
+};
+
+// what to read besides STREAMINFO. fields are upper case, and an empty list with
+// all_tags unset skips the vorbis comment block entirely
+struct FLACHeaderRequest {
+    bool all_tags = true;
+    std::vector<std::string> fields;
+    bool pictures = false;
+
+    bool wants_tags() const { return all_tags || !fields.empty(); }
+
+    // vorbis comment field names are ascii and case-insensitive
+    static bool field_matches(const std::string& field, const char* name, size_t length) {
+        if (field.size() != length) {
+            return false;
+        }
+        for (size_t i = 0; i < length; i++) {
+            if (field[i] != ((name[i] >= 'a' && name[i] <= 'z') ? name[i] - 32 : name[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool wants_field(const char* name, size_t length) const {
+        if (all_tags) {
+            return true;
+        }
+        for (const std::string& field : fields) {
+            if (field_matches(field, name, length)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+inline uint32_t flac_read_be32(const uint8_t* data) {
+    return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+}
+
+inline uint32_t flac_read_le32(const uint8_t* data) {
+    return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+}
+
+inline bool flac_parse_vorbis_comment(const uint8_t* data, size_t size, const FLACHeaderRequest& request,
+                                      FLACHeaderInfo& info) {
+    size_t pos = 0;
+    auto read_string = [&](const uint8_t** text, size_t* length) {
+        if (size - pos < 4) {
+            return false;
+        }
+        *length = flac_read_le32(data + pos);
+        pos += 4;
+        if (size - pos < *length) {
+            return false;
+        }
+        *text = data + pos;
+        pos += *length;
+        return true;
+    };
+
+    const uint8_t* text;
+    size_t length;
+    if (!read_string(&text, &length)) {
+        return false;
+    }
+    info.vendor.assign(reinterpret_cast<const char*>(text), length);
+    if (size - pos < 4) {
+        return false;
+    }
+    uint32_t count = flac_read_le32(data + pos);
+    pos += 4;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!read_string(&text, &length)) {
+            return false;
+        }
+        const char* entry = reinterpret_cast<const char*>(text);
+        const void* equals = std::memchr(entry, '=', length);
+        if (!equals) {
+            continue;
+        }
+        size_t name_length = static_cast<const char*>(equals) - entry;
+        if (request.wants_field(entry, name_length)) {
+            info.tags.emplace_back(std::string(entry, name_length),
+                                   std::string(entry + name_length + 1, length - name_length - 1));
+        }
+    }
+    return true;
+}
+
+inline bool flac_parse_picture(const uint8_t* data, size_t size, FLACHeaderPicture& picture) {
+    size_t pos = 0;
+    auto read_u32 = [&](uint32_t* value) {
+        if (size - pos < 4) {
+            return false;
+        }
+        *value = flac_read_be32(data + pos);
+        pos += 4;
+        return true;
+    };
+    auto read_bytes = [&](uint32_t length, const uint8_t** bytes) {
+        if (size - pos < length) {
+            return false;
+        }
+        *bytes = data + pos;
+        pos += length;
+        return true;
+    };
+
+    uint32_t length;
+    const uint8_t* bytes;
+    if (!read_u32(&picture.type) || !read_u32(&length) || !read_bytes(length, &bytes)) {
+        return false;
+    }
+    picture.mime_type.assign(reinterpret_cast<const char*>(bytes), length);
+    if (!read_u32(&length) || !read_bytes(length, &bytes)) {
+        return false;
+    }
+    picture.description.assign(reinterpret_cast<const char*>(bytes), length);
+    if (!read_u32(&picture.width) || !read_u32(&picture.height) || !read_u32(&picture.depth) ||
+        !read_u32(&picture.colors) || !read_u32(&length) || !read_bytes(length, &bytes)) {
+        return false;
+    }
+    picture.data.assign(bytes, bytes + length);
+    return true;
+}
+
+// read STREAMINFO and any requested blocks. Input provides bool read(uint8_t*, size_t), which
+// fails on a short read, and bool skip(uint64_t), which moves forward without reading
+template <typename Input>
+inline bool flac_read_header(Input& input, const FLACHeaderRequest& request, FLACHeaderInfo& info, std::string& error) {
+    uint8_t head[10];
+    if (!input.read(head, 4)) {
+        error = "Not a FLAC stream";
+        return false;
+    }
+    if (std::memcmp(head, "ID3", 3) == 0) {
+        if (!input.read(head + 4, 6)) {
+            error = "Truncated ID3v2 tag";
+            return false;
+        }
+        size_t tag_size = flac_id3v2_size(head, sizeof(head));
+        if (!input.skip(tag_size - sizeof(head)) || !input.read(head, 4)) {
+            error = "Truncated ID3v2 tag";
+            return false;
+        }
+    }
+    if (std::memcmp(head, "fLaC", 4) != 0) {
+        error = "Not a FLAC stream";
+        return false;
+    }
+
+    std::vector<uint8_t> body;
+    bool have_streaminfo = false;
+    bool last = false;
+    while (!last) {
+        uint8_t block_header[4];
+        if (!input.read(block_header, sizeof(block_header))) {
+            error = "Truncated metadata";
+            return false;
+        }
+        last = (block_header[0] & 0x80) != 0;
+        const unsigned type = block_header[0] & 0x7F;
+        const uint32_t length = (uint32_t(block_header[1]) << 16) | (uint32_t(block_header[2]) << 8) | block_header[3];
+
+        const bool wanted = type == 0 || (type == 4 && request.wants_tags()) || (type == 6 && request.pictures);
+        if (!wanted) {
+            if (!input.skip(length)) {
+                error = "Truncated metadata";
+                return false;
+            }
+            continue;
+        }
+
+        body.resize(length);
+        if (!input.read(body.data(), length)) {
+            error = "Truncated metadata";
+            return false;
+        }
+        bool ok = true;
+        if (type == 0) {
+            // sample rate (20 bits), channels - 1 (3), bits per sample - 1 (5), total samples (36)
+            ok = length >= 18;
+            if (ok) {
+                const uint8_t* p = body.data() + 10;
+                info.sample_rate = (unsigned(p[0]) << 12) | (unsigned(p[1]) << 4) | (p[2] >> 4);
+                info.channels = ((p[2] >> 1) & 0x07) + 1;
+                info.bits_per_sample = (((p[2] & 0x01) << 4) | (p[3] >> 4)) + 1;
+                info.total_samples = (uint64_t(p[3] & 0x0F) << 32) | flac_read_be32(p + 4);
+                have_streaminfo = true;
+            }
+        } else if (type == 4) {
+            ok = flac_parse_vorbis_comment(body.data(), body.size(), request, info);
+        } else {
+            info.pictures.emplace_back();
+            ok = flac_parse_picture(body.data(), body.size(), info.pictures.back());
+        }
+        if (!ok) {
+            error = "Malformed metadata block";
+            return false;
+        }
+    }
+
+    if (!have_streaminfo) {
+        error = "No STREAMINFO found";
+        return false;
+    }
+    return true;
+}
+
+#endif // FLACPY_FLAC_HEADER_H
@@ -28,6 +28,12 @@ SOFTWARE.
 
 #include "flacpy.h"
 #include "metadata.h"
+#include "thread_pool.h"
+#include "flac_frame.h"
+#include "flac_header.h"
+#include "md5.h"
+#include "file_io.h"
+#include "stats.h"
 #include <numpy/arrayobject.h>
 #include <FLAC++/decoder.h>
 #include <FLAC++/encoder.h>
@@ -35,59 +41,413 @@ SOFTWARE.
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <deque>
+#include <map>
+#include <condition_variable>
 #include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <limits>
 
-// FLACAudio type definition
-static PyMethodDef FLACAudio_methods[] = {
-    {NULL, NULL, 0, NULL}
+// interleave a run of decoded samples into the output, specialized for the common channel counts
+static inline void interleave_samples(int32_t* out, const FLAC__int32* const buffer[],
+                                      unsigned channels, uint64_t offset, uint64_t count) {
+    switch (channels) {
+        case 1:
+            std::memcpy(out, buffer[0] + offset, count * sizeof(int32_t));
+            break;
+        case 2:
+        {
+            const FLAC__int32* left = buffer[0] + offset;
+            const FLAC__int32* right = buffer[1] + offset;
+            for (uint64_t s = 0; s < count; s++) {
+                out[2 * s] = left[s];
+                out[2 * s + 1] = right[s];
+            }
+            break;
+        }
+        default:
+            // one channel at a time keeps each source run sequential
+            for (unsigned c = 0; c < channels; c++) {
+                const FLAC__int32* src = buffer[c] + offset;
+                int32_t* dst = out + c;
+                for (uint64_t s = 0; s < count; s++) {
+                    dst[s * channels] = src[s];
+                }
+            }
+            break;
+    }
+}
+
+// how decoded audio is stored: its dtype, and which channels are kept. integer outputs are
+// shifted, normalized ones so full scale of the stream is full scale of the dtype, and floats
+// are scaled to [-1, 1) when normalized
+struct SampleFormat {
+    int type = NPY_INT32;     // NPY_INT16, NPY_INT32, NPY_FLOAT32 or NPY_FLOAT64
+    bool normalize = false;
+    int shift = 0;            // integer outputs, negative shifts right
+    double scale = 1.0;       // float outputs
+    std::vector<unsigned> channel_map;  // stream channels to keep in output order, empty keeps all
+    bool downmix = false;               // average the kept channels into one
+    bool strided = false;               // output frames aren't interleaved, as in a view of a larger array
+    ptrdiff_t frame_stride = 0;         // strided output layout, in elements
+    ptrdiff_t channel_stride = 0;
+
+    size_t itemsize() const {
+        return type == NPY_INT16 ? 2 : (type == NPY_FLOAT64 ? 8 : 4);
+    }
+
+    unsigned output_channels(unsigned channels) const {
+        return downmix ? 1 : (channel_map.empty() ? channels : static_cast<unsigned>(channel_map.size()));
+    }
+
+    // bytes from one output frame to the next
+    ptrdiff_t frame_step(unsigned channels) const {
+        return static_cast<ptrdiff_t>(itemsize()) * (strided ? frame_stride : static_cast<ptrdiff_t>(output_channels(channels)));
+    }
+
+    // work out the conversion once the stream's bit depth and channel count are known
+    bool configure(unsigned bits_per_sample, unsigned channels, std::string& error) {
+        for (unsigned channel : channel_map) {
+            if (channel >= channels) {
+                error = "Channel " + std::to_string(channel) + " requested from a stream with " +
+                        std::to_string(channels) + " channels";
+                return false;
+            }
+        }
+        shift = 0;
+        scale = 1.0;
+        if (type == NPY_FLOAT32 || type == NPY_FLOAT64) {
+            if (normalize) {
+                scale = 1.0 / static_cast<double>(uint64_t(1) << (bits_per_sample - 1));
+            }
+            return true;
+        }
+        const int bits = type == NPY_INT16 ? 16 : 32;
+        if (normalize) {
+            shift = bits - static_cast<int>(bits_per_sample);
+        } else if (static_cast<int>(bits_per_sample) > bits) {
+            error = std::to_string(bits_per_sample) + "-bit audio doesn't fit in int" + std::to_string(bits) +
+                    ", use normalize=True or a wider dtype";
+            return false;
+        }
+        return true;
+    }
 };
 
-PyTypeObject FLACAudioType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    "flacpy.FLACAudio",           /* tp_name */
-    sizeof(FLACAudioObject),      /* tp_basicsize */
-    0,                            /* tp_itemsize */
-    0,                            /* tp_dealloc */
-    0,                            /* tp_print */
-    0,                            /* tp_getattr */
-    0,                            /* tp_setattr */
-    0,                            /* tp_compare */
-    0,                            /* tp_repr */
-    0,                            /* tp_as_number */
-    0,                            /* tp_as_sequence */
-    0,                            /* tp_as_mapping */
-    0,                            /* tp_hash */
-    0,                            /* tp_call */
-    0,                            /* tp_str */
-    0,                            /* tp_getattro */
-    0,                            /* tp_setattro */
-    0,                            /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT,           /* tp_flags */
-    "FLACAudio object",           /* tp_doc */
-    0,                            /* tp_traverse */
-    0,                            /* tp_clear */
-    0,                            /* tp_richcompare */
-    0,                            /* tp_weaklistoffset */
-    0,                            /* tp_iter */
-    0,                            /* tp_iternext */
-    FLACAudio_methods,            /* tp_methods */
-    0,                            /* tp_members */
-    0,                            /* tp_getset */
-    0,                            /* tp_base */
-    0,                            /* tp_dict */
-    0,                            /* tp_descr_get */
-    0,                            /* tp_descr_set */
-    0,                            /* tp_dictoffset */
-    0,                            /* tp_init */
-    0,                            /* tp_alloc */
-    0,                            /* tp_new */
+// interleave a run of decoded samples, converting each one. the per-channel loops are plain
+// contiguous reads with a simple arithmetic conversion, which the compiler vectorizes
+template <typename T, typename Convert>
+static inline void interleave_converted(T* out, const FLAC__int32* const buffer[], unsigned channels,
+                                        uint64_t offset, uint64_t count, Convert convert) {
+    switch (channels) {
+        case 1:
+        {
+            const FLAC__int32* src = buffer[0] + offset;
+            for (uint64_t s = 0; s < count; s++) {
+                out[s] = convert(src[s]);
+            }
+            break;
+        }
+        case 2:
+        {
+            const FLAC__int32* left = buffer[0] + offset;
+            const FLAC__int32* right = buffer[1] + offset;
+            for (uint64_t s = 0; s < count; s++) {
+                out[2 * s] = convert(left[s]);
+                out[2 * s + 1] = convert(right[s]);
+            }
+            break;
+        }
+        default:
+            for (unsigned c = 0; c < channels; c++) {
+                const FLAC__int32* src = buffer[c] + offset;
+                T* dst = out + c;
+                for (uint64_t s = 0; s < count; s++) {
+                    dst[s * channels] = convert(src[s]);
+                }
+            }
+            break;
+    }
+}
+
+// the same for output laid out with arbitrary frame and channel strides, in elements
+template <typename T, typename Convert>
+static inline void scatter_converted(T* out, const FLAC__int32* const buffer[], unsigned channels,
+                                     uint64_t offset, uint64_t count, ptrdiff_t frame_stride,
+                                     ptrdiff_t channel_stride, Convert convert) {
+    for (unsigned c = 0; c < channels; c++) {
+        const FLAC__int32* src = buffer[c] + offset;
+        T* dst = out + c * channel_stride;
+        for (uint64_t s = 0; s < count; s++) {
+            dst[static_cast<ptrdiff_t>(s) * frame_stride] = convert(src[s]);
+        }
+    }
+}
+
+template <typename T, typename Convert>
+static inline void store_converted(T* out, const SampleFormat& format, const FLAC__int32* const buffer[],
+                                   unsigned channels, uint64_t offset, uint64_t count, Convert convert) {
+    if (format.strided) {
+        scatter_converted(out, buffer, channels, offset, count, format.frame_stride, format.channel_stride, convert);
+    } else {
+        interleave_converted(out, buffer, channels, offset, count, convert);
+    }
+}
+
+// average a run of decoded samples across channels into a single output channel, stride
+// elements apart
+template <typename T, typename Convert>
+static inline void downmix_converted(T* out, const FLAC__int32* const buffer[], unsigned channels,
+                                     uint64_t offset, uint64_t count, ptrdiff_t stride, Convert convert) {
+    const double weight = 1.0 / channels;
+    for (uint64_t s = 0; s < count; s++) {
+        double sum = 0.0;
+        for (unsigned c = 0; c < channels; c++) {
+            sum += buffer[c][offset + s];
+        }
+        out[static_cast<ptrdiff_t>(s) * stride] = convert(sum * weight);
+    }
+}
+
+// round a downmixed value to an integer dtype, applying the format's shift
+template <typename T>
+static void downmix_integer(T* out, const SampleFormat& format, const FLAC__int32* const buffer[],
+                            unsigned channels, uint64_t offset, uint64_t count) {
+    const double factor = std::ldexp(1.0, format.shift);
+    const double min_value = static_cast<double>(std::numeric_limits<T>::min());
+    const double max_value = static_cast<double>(std::numeric_limits<T>::max());
+    const ptrdiff_t stride = format.strided ? format.frame_stride : 1;
+    downmix_converted(out, buffer, channels, offset, count, stride, [=](double value) {
+        value = std::floor(value * factor + 0.5);
+        value = value > min_value ? value : min_value;
+        return static_cast<T>(value < max_value ? value : max_value);
+    });
+}
+
+static void downmix_samples(void* out, const SampleFormat& format, const FLAC__int32* const buffer[],
+                            unsigned channels, uint64_t offset, uint64_t count) {
+    const double scale = format.scale;
+    const ptrdiff_t stride = format.strided ? format.frame_stride : 1;
+    switch (format.type) {
+        case NPY_INT16:
+            downmix_integer(static_cast<int16_t*>(out), format, buffer, channels, offset, count);
+            break;
+        case NPY_FLOAT32:
+            downmix_converted(static_cast<float*>(out), buffer, channels, offset, count, stride,
+                              [scale](double value) { return static_cast<float>(value * scale); });
+            break;
+        case NPY_FLOAT64:
+            downmix_converted(static_cast<double*>(out), buffer, channels, offset, count, stride,
+                              [scale](double value) { return value * scale; });
+            break;
+        default:
+            downmix_integer(static_cast<int32_t*>(out), format, buffer, channels, offset, count);
+            break;
+    }
+}
+
+// interleave a run of decoded samples into output memory of the given format and layout
+static void convert_samples(void* out, const SampleFormat& format, const FLAC__int32* const buffer[],
+                            unsigned channels, uint64_t offset, uint64_t count) {
+    // only the selected channels are ever read
+    const FLAC__int32* selected[FLAC__MAX_CHANNELS];
+    if (!format.channel_map.empty()) {
+        for (size_t i = 0; i < format.channel_map.size(); i++) {
+            selected[i] = buffer[format.channel_map[i]];
+        }
+        buffer = selected;
+        channels = static_cast<unsigned>(format.channel_map.size());
+    }
+    if (format.downmix) {
+        downmix_samples(out, format, buffer, channels, offset, count);
+        return;
+    }
+    
+    const int shift = format.shift;
+    switch (format.type) {
+        case NPY_INT16:
+            if (shift >= 0) {
+                store_converted(static_cast<int16_t*>(out), format, buffer, channels, offset, count,
+                                [shift](FLAC__int32 s) { return static_cast<int16_t>(static_cast<uint32_t>(s) << shift); });
+            } else {
+                store_converted(static_cast<int16_t*>(out), format, buffer, channels, offset, count,
+                                [shift](FLAC__int32 s) { return static_cast<int16_t>(s >> -shift); });
+            }
+            break;
+        case NPY_FLOAT32:
+        {
+            const float scale = static_cast<float>(format.scale);
+            store_converted(static_cast<float*>(out), format, buffer, channels, offset, count,
+                            [scale](FLAC__int32 s) { return static_cast<float>(s) * scale; });
+            break;
+        }
+        case NPY_FLOAT64:
+        {
+            const double scale = format.scale;
+            store_converted(static_cast<double*>(out), format, buffer, channels, offset, count,
+                            [scale](FLAC__int32 s) { return static_cast<double>(s) * scale; });
+            break;
+        }
+        default:
+            if (shift == 0 && !format.strided) {
+                interleave_samples(static_cast<int32_t*>(out), buffer, channels, offset, count);
+            } else {
+                store_converted(static_cast<int32_t*>(out), format, buffer, channels, offset, count,
+                                [shift](FLAC__int32 s) { return static_cast<int32_t>(static_cast<uint32_t>(s) << shift); });
+            }
+            break;
+    }
+}
+
+// convert already interleaved int32 frames, as collected for streams of unknown length,
+// going through a block of per-channel scratch at a time
+static void convert_interleaved(void* out, const SampleFormat& format, const int32_t* in,
+                                uint64_t frames, unsigned channels) {
+    const uint64_t block_frames = 4096;
+    std::vector<int32_t> planar(block_frames * channels);
+    std::vector<const FLAC__int32*> buffer(channels);
+    for (unsigned c = 0; c < channels; c++) {
+        buffer[c] = planar.data() + c * block_frames;
+    }
+    const ptrdiff_t frame_step = format.frame_step(channels);
+    
+    for (uint64_t done = 0; done < frames; done += block_frames) {
+        uint64_t n = std::min(block_frames, frames - done);
+        for (unsigned c = 0; c < channels; c++) {
+            for (uint64_t s = 0; s < n; s++) {
+                planar[c * block_frames + s] = in[(done + s) * channels + c];
+            }
+        }
+        convert_samples(static_cast<uint8_t*>(out) + static_cast<ptrdiff_t>(done) * frame_step, format, buffer.data(), channels, 0, n);
+    }
+}
+
+// per-bin peak and RMS of decoded audio, accumulated by the write callback as frames arrive so
+// the samples themselves are never stored. bins are (bins x channels), growing as audio comes in
+struct Overview {
+    uint64_t block = 0;                // samples per bin
+    unsigned channels = 0;
+    uint64_t samples = 0;              // samples summarized so far
+    std::vector<int32_t> min;
+    std::vector<int32_t> max;
+    std::vector<double> sum_squares;
+
+    uint64_t bins() const { return block ? (samples + block - 1) / block : 0; }
+
+    void reserve(uint64_t num_bins) {
+        min.reserve(num_bins * channels);
+        max.reserve(num_bins * channels);
+        sum_squares.reserve(num_bins * channels);
+    }
+
+    void add(const FLAC__int32* const buffer[], uint64_t offset, uint64_t count) {
+        const uint64_t end = samples + count;
+        const size_t needed = static_cast<size_t>((end + block - 1) / block * channels);
+        if (min.size() < needed) {
+            min.resize(needed, std::numeric_limits<int32_t>::max());
+            max.resize(needed, std::numeric_limits<int32_t>::min());
+            sum_squares.resize(needed, 0.0);
+        }
+        
+        // one channel at a time, in runs that stay inside a bin
+        for (unsigned c = 0; c < channels; c++) {
+            const FLAC__int32* src = buffer[c] + offset;
+            uint64_t position = samples;
+            for (uint64_t i = 0; i < count;) {
+                const uint64_t bin = position / block;
+                const uint64_t run = std::min(count - i, (bin + 1) * block - position);
+                const size_t slot = static_cast<size_t>(bin * channels + c);
+                int32_t low = min[slot];
+                int32_t high = max[slot];
+                double squares = 0.0;
+                for (uint64_t s = 0; s < run; s++) {
+                    const int32_t value = src[i + s];
+                    low = std::min(low, value);
+                    high = std::max(high, value);
+                    squares += static_cast<double>(value) * value;
+                }
+                min[slot] = low;
+                max[slot] = high;
+                sum_squares[slot] += squares;
+                i += run;
+                position += run;
+            }
+        }
+        samples = end;
+    }
+};
+
+// a stream to decode: a file path, memory exported through the buffer protocol, or an
+// (offset, length) window of a file that gets memory-mapped. parsed by parse_source, and
+// must be destroyed with the GIL held since it can own a buffer view
+struct FLACSource {
+    std::string path;
+    bool window = false;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    Py_buffer view = {};
+
+    FLACSource() = default;
+    FLACSource(const FLACSource&) = delete;
+    FLACSource& operator=(const FLACSource&) = delete;
+    ~FLACSource() {
+        if (view.obj) {
+            PyBuffer_Release(&view);
+        }
+    }
+
+    bool is_memory() const { return view.obj != nullptr; }
+    std::string describe() const { return is_memory() ? std::string("<buffer>") : path; }
+};
+
+// lets another thread stop a decode between frames, optionally with a deadline after which it
+// stops by itself
+struct DecodeControl {
+    std::atomic<bool> cancelled{false};
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+    bool timed_out() const {
+        return deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline;
+    }
+    bool stopped() const { return cancelled.load(std::memory_order_relaxed) || timed_out(); }
+};
+
+// whether the 42 bytes at header are "fLaC" followed by the STREAMINFO block, as every stream starts
+static bool is_stream_header(const uint8_t* header) {
+    return std::memcmp(header, "fLaC", 4) == 0 && (header[4] & 0x7F) == FLAC__METADATA_TYPE_STREAMINFO &&
+           header[5] == 0 && header[6] == 0 && header[7] == FLAC__STREAM_METADATA_STREAMINFO_LENGTH;
+}
+
+// what a saved index was built from. an index used on a stream that has since been re-encoded
+// or retagged points at the wrong bytes, so it is refused unless both still match
+struct StreamFingerprint {
+    uint64_t length = 0;  // of the whole input, any ID3v2 tag included
+    uint8_t streaminfo[FLAC__STREAM_METADATA_STREAMINFO_LENGTH] = {};
 };
 
 // FLAC decoder class for partial decoding
-class PartialFLACDecoder : public FLAC::Decoder::File {
+class PartialFLACDecoder : public FLAC::Decoder::Stream {
 public:
     PartialFLACDecoder() : 
+        file_(nullptr),
+        data_(nullptr),
+        data_size_(0),
+        data_pos_(0),
+        prefix_pos_(0),
+        output_(nullptr),
+        output_capacity_(0),
+        samples_written_(0),
         buffer_(nullptr), 
+        carry_(nullptr),
+        overview_(nullptr),
+        control_(nullptr),
+        stats_(nullptr),
         channels_(0), 
         bits_per_sample_(0), 
         sample_rate_(0),
@@ -96,8 +456,133 @@ public:
         end_sample_(0),
         current_sample_(0),
         metadata_only_(false) {}
+    
+    virtual ~PartialFLACDecoder() {
+        // the base destructor finishes the decoder, make sure that happens before the input goes away
+        close();
+    }
 
-    void set_buffer(std::vector<int32_t>* buffer) { buffer_ = buffer; }
+    void close() {
+        finish();
+        close_input();
+    }
+
+    // finish and put every setting back to its default, so that a pooled decoder can be used
+    // again. the libFLAC decoder itself stays allocated
+    void recycle() {
+        close();
+        prefix_.clear();
+        prefix_pos_ = 0;
+        output_ = nullptr;
+        format_ = SampleFormat();
+        output_capacity_ = 0;
+        samples_written_ = 0;
+        buffer_ = nullptr;
+        carry_ = nullptr;
+        overview_ = nullptr;
+        control_ = nullptr;
+        stats_ = nullptr;
+        channels_ = 0;
+        bits_per_sample_ = 0;
+        sample_rate_ = 0;
+        total_samples_ = 0;
+        start_sample_ = 0;
+        end_sample_ = 0;
+        current_sample_ = 0;
+        metadata_only_ = false;
+    }
+
+    // open a source and initialize the decoder on it
+    FLAC__StreamDecoderInitStatus init(const FLACSource& source) {
+        close_input();
+        
+        if (source.is_memory()) {
+            data_ = static_cast<const uint8_t*>(source.view.buf);
+            data_size_ = static_cast<size_t>(source.view.len);
+        } else if (source.window) {
+            std::string error;
+            if (!mapping_.open(source.path.c_str(), source.offset, source.length, error)) {
+                return FLAC__STREAM_DECODER_INIT_STATUS_ERROR_OPENING_FILE;
+            }
+            data_ = mapping_.data();
+            data_size_ = mapping_.size();
+        } else {
+            file_ = fopen_utf8(source.path.c_str(), "rb");
+            if (!file_) {
+                return FLAC__STREAM_DECODER_INIT_STATUS_ERROR_OPENING_FILE;
+            }
+        }
+        data_pos_ = 0;
+        prefix_.clear();
+        prefix_pos_ = 0;
+        
+        return FLAC::Decoder::Stream::init();
+    }
+
+    // start decoding at the frame at byte_offset, found through a frame index. the decoder is
+    // shown "fLaC" and STREAMINFO read straight from the input, followed immediately by that
+    // frame, so no other metadata is parsed and no seek is needed. call right after init.
+    // false unless the frame there starts at first_sample and the stream matches fingerprint
+    // (when given), so that a stale index fails instead of decoding the wrong audio
+    bool start_at_frame(uint64_t byte_offset, uint64_t first_sample, const StreamFingerprint* fingerprint) {
+        uint8_t id3[10];
+        uint64_t header_offset = 0;
+        if (read_input_at(0, id3, sizeof(id3))) {
+            header_offset = flac_id3v2_size(id3, sizeof(id3));
+        }
+        
+        uint8_t header[42];
+        if (!read_input_at(header_offset, header, sizeof(header)) || !is_stream_header(header)) {
+            return false;
+        }
+        uint64_t input_length = data_size_;
+        if ((file_ && !file_size64(file_, &input_length)) || byte_offset >= input_length) {
+            return false;
+        }
+        if (fingerprint && (input_length != fingerprint->length ||
+                            std::memcmp(header + 8, fingerprint->streaminfo, sizeof(fingerprint->streaminfo)) != 0)) {
+            return false;
+        }
+        
+        // fixed-blocksize frames are numbered in blocks of STREAMINFO's maximum blocksize
+        uint8_t frame[16];  // the longest possible frame header
+        const size_t frame_size = static_cast<size_t>(std::min<uint64_t>(sizeof(frame), input_length - byte_offset));
+        FLACFrameHeader frame_header;
+        if (!read_input_at(byte_offset, frame, frame_size) || !flac_parse_frame_header(frame, frame_size, &frame_header)) {
+            return false;
+        }
+        const uint64_t blocksize = (uint64_t(header[10]) << 8) | header[11];
+        if ((frame_header.variable_blocksize ? frame_header.number : frame_header.number * blocksize) != first_sample) {
+            return false;
+        }
+        header[4] |= 0x80;  // STREAMINFO becomes the last metadata block
+        
+        prefix_.assign(header, header + sizeof(header));
+        prefix_pos_ = 0;
+        if (file_) {
+            return fseek64(file_, static_cast<int64_t>(byte_offset), SEEK_SET) == 0;
+        }
+        data_pos_ = static_cast<size_t>(byte_offset);
+        return true;
+    }
+
+    // decode directly into caller-owned interleaved memory with room for capacity samples,
+    // stored in the output format (int32 unless set_format says otherwise)
+    void set_output(void* output, uint64_t capacity) {
+        output_ = static_cast<uint8_t*>(output);
+        output_capacity_ = capacity;
+        samples_written_ = 0;
+    }
+
+    // growable fallback for streams that don't report their total length
+    void set_buffer(std::vector<int32_t>* buffer) {
+        buffer_ = buffer;
+        samples_written_ = 0;
+    }
+
+    // keep decoding past the end of the range instead of aborting, with the part of the frame
+    // beyond the range kept in carry. used by readers that pick up where they left off
+    void set_carry(std::vector<int32_t>* carry) { carry_ = carry; }
     
     void set_range(uint64_t start_sample, uint64_t length) {
         start_sample_ = start_sample;
@@ -109,24 +594,130 @@ public:
     }
     
     void set_metadata_only(bool metadata_only) { metadata_only_ = metadata_only; }
+    void set_format(const SampleFormat& format) { format_ = format; }
+    
+    // summarize the range into an overview instead of storing any samples
+    void set_overview(Overview* overview) { overview_ = overview; }
+
+    // abort as soon as control says so, checked on every read and every frame
+    void set_control(const DecodeControl* control) { control_ = control; }
+    void set_stats(LoadStats* stats) { stats_ = stats; }
     
     unsigned get_channels() const { return channels_; }
     unsigned get_bits_per_sample() const { return bits_per_sample_; }
     unsigned get_sample_rate() const { return sample_rate_; }
     uint64_t get_total_samples() const { return total_samples_; }
+    uint64_t get_samples_written() const { return samples_written_; }
+    uint64_t get_current_sample() const { return current_sample_; }  // first sample after the last decoded frame
+
+    // number of samples covered by the requested range, only known once STREAMINFO has been
+    // read and the stream reports its total length
+    bool get_range_length(uint64_t* length) const {
+        if (total_samples_ == 0) {
+            return false;
+        }
+        uint64_t end_sample = std::min(end_sample_, total_samples_);
+        *length = end_sample > start_sample_ ? end_sample - start_sample_ : 0;
+        return true;
+    }
     
     std::vector<FLAC__StreamMetadata*> metadata_blocks;
 
 protected:
+    // input callbacks, reading either from the open file or straight from memory
+    virtual ::FLAC__StreamDecoderReadStatus read_callback(FLAC__byte buffer[], size_t* bytes) override {
+        if (*bytes == 0 || (control_ && control_->stopped())) {
+            return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+        }
+        if (prefix_pos_ < prefix_.size()) {
+            *bytes = std::min(*bytes, prefix_.size() - prefix_pos_);
+            std::memcpy(buffer, prefix_.data() + prefix_pos_, *bytes);
+            prefix_pos_ += *bytes;
+            return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+        }
+        if (file_) {
+            *bytes = std::fread(buffer, 1, *bytes, file_);
+            if (*bytes == 0) {
+                return std::ferror(file_) ? FLAC__STREAM_DECODER_READ_STATUS_ABORT : FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+            }
+            count_bytes_read(*bytes);
+            return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+        }
+        *bytes = std::min(*bytes, data_size_ - data_pos_);
+        if (*bytes == 0) {
+            return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+        }
+        std::memcpy(buffer, data_ + data_pos_, *bytes);
+        data_pos_ += *bytes;
+        count_bytes_read(*bytes);
+        return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+    }
+    
+    // byte positions don't line up with the input once a prefix has been spliced in
+    virtual ::FLAC__StreamDecoderSeekStatus seek_callback(FLAC__uint64 absolute_byte_offset) override {
+        if (!prefix_.empty()) {
+            return FLAC__STREAM_DECODER_SEEK_STATUS_UNSUPPORTED;
+        }
+        if (file_) {
+            return fseek64(file_, static_cast<int64_t>(absolute_byte_offset), SEEK_SET) == 0 ?
+                FLAC__STREAM_DECODER_SEEK_STATUS_OK : FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+        }
+        if (absolute_byte_offset > data_size_) {
+            return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+        }
+        data_pos_ = static_cast<size_t>(absolute_byte_offset);
+        return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+    }
+    
+    virtual ::FLAC__StreamDecoderTellStatus tell_callback(FLAC__uint64* absolute_byte_offset) override {
+        if (!prefix_.empty()) {
+            return FLAC__STREAM_DECODER_TELL_STATUS_UNSUPPORTED;
+        }
+        if (file_) {
+            int64_t position = ftell64(file_);
+            if (position < 0) {
+                return FLAC__STREAM_DECODER_TELL_STATUS_ERROR;
+            }
+            *absolute_byte_offset = static_cast<FLAC__uint64>(position);
+            return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+        }
+        *absolute_byte_offset = data_pos_;
+        return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+    }
+    
+    virtual ::FLAC__StreamDecoderLengthStatus length_callback(FLAC__uint64* stream_length) override {
+        if (!prefix_.empty()) {
+            return FLAC__STREAM_DECODER_LENGTH_STATUS_UNSUPPORTED;
+        }
+        if (file_) {
+            uint64_t size;
+            if (!file_size64(file_, &size)) {
+                return FLAC__STREAM_DECODER_LENGTH_STATUS_ERROR;
+            }
+            *stream_length = size;
+            return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+        }
+        *stream_length = data_size_;
+        return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+    }
+    
+    virtual bool eof_callback() override {
+        return file_ ? std::feof(file_) != 0 : data_pos_ >= data_size_;
+    }
+    
     // metadata callback required by FLAC::Decoder
     virtual ::FLAC__StreamDecoderWriteStatus write_callback(
             const ::FLAC__Frame* frame, const FLAC__int32* const buffer[]) override {
         
+        if (control_ && control_->stopped()) {
+            return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+        }
+        
         if (metadata_only_) {
             return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
         }
         
-        if (!buffer_) {
+        if (!output_ && !buffer_ && !overview_) {
             return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
         }
         
@@ -134,9 +725,20 @@ protected:
         const unsigned frame_samples = frame->header.blocksize;
         const uint64_t frame_last_sample = frame_first_sample + frame_samples - 1;
         
+        if (stats_) {
+            stats_->frames_decoded.fetch_add(1, std::memory_order_relaxed);
+            if (frame_last_sample < start_sample_) {
+                stats_->frames_skipped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        
         // skip frames entirely outside our target range
         if (frame_last_sample < start_sample_ || frame_first_sample >= end_sample_) {
             current_sample_ = frame_last_sample + 1;
+            if (carry_) {
+                carry_->resize(frame_first_sample >= end_sample_ ? frame_samples * channels_ : 0);
+                interleave_samples(carry_->data(), buffer, channels_, 0, carry_->size() / channels_);
+            }
             return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
         }
         
@@ -153,17 +755,31 @@ protected:
             sample_count = end_sample_ - (frame_first_sample + start_offset);
         }
         
-        // append data to our buffer
-        for (unsigned s = 0; s < sample_count; s++) {
-            for (unsigned c = 0; c < channels_; c++) {
-                buffer_->push_back(buffer[c][start_offset + s]);
-            }
+        if (overview_) {
+            overview_->add(buffer, start_offset, sample_count);
+        } else if (output_) {
+            // never run past the preallocated output, even if the stream is longer than advertised
+            sample_count = std::min(sample_count, output_capacity_ - samples_written_);
+            convert_samples(output_ + static_cast<ptrdiff_t>(samples_written_) * format_.frame_step(channels_),
+                            format_, buffer, channels_, start_offset, sample_count);
+        } else {
+            size_t offset = buffer_->size();
+            buffer_->resize(offset + sample_count * channels_);
+            interleave_samples(buffer_->data() + offset, buffer, channels_, start_offset, sample_count);
         }
+        samples_written_ += sample_count;
         
         current_sample_ = frame_first_sample + frame_samples;
         
+        if (carry_) {
+            uint64_t used = start_offset + sample_count;
+            carry_->resize((frame_samples - used) * channels_);
+            interleave_samples(carry_->data(), buffer, channels_, used, frame_samples - used);
+            return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+        }
+        
         // if we've read all the samples we need, abort decoding
-        if (current_sample_ >= end_sample_) {
+        if (current_sample_ >= end_sample_ || (output_ && samples_written_ >= output_capacity_)) {
             return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
         }
         
@@ -177,16 +793,10 @@ protected:
             sample_rate_ = metadata->data.stream_info.sample_rate;
             total_samples_ = metadata->data.stream_info.total_samples;
             
-            // if end_sample wasn't specified, use total_samples
-            if (end_sample_ == UINT64_MAX) {
+            // if end_sample wasn't specified, use total_samples (0 means the length is unknown)
+            if (end_sample_ == UINT64_MAX && total_samples_ > 0) {
                 end_sample_ = total_samples_;
             }
-            
-            // allocate buffer with appropriate size (approximate)
-            if (buffer_ && !metadata_only_) {
-                uint64_t sample_count = end_sample_ - start_sample_;
-                buffer_->reserve(sample_count * channels_);
-            }
         }
         
         // make a copy of all metadata blocks
@@ -201,7 +811,55 @@ protected:
     }
     
 private:
+    bool read_input_at(uint64_t offset, uint8_t* out, size_t size) {
+        if (file_) {
+            if (fseek64(file_, static_cast<int64_t>(offset), SEEK_SET) != 0 || std::fread(out, 1, size, file_) != size) {
+                return false;
+            }
+            count_bytes_read(size);
+            return true;
+        }
+        if (offset > data_size_ || data_size_ - offset < size) {
+            return false;
+        }
+        std::memcpy(out, data_ + offset, size);
+        count_bytes_read(size);
+        return true;
+    }
+
+    void count_bytes_read(size_t bytes) {
+        if (stats_) {
+            stats_->bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+        }
+    }
+
+    void close_input() {
+        if (file_) {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+        mapping_.close();
+        data_ = nullptr;
+        data_size_ = 0;
+        data_pos_ = 0;
+    }
+    
+    FILE* file_;
+    MappedFile mapping_;
+    const uint8_t* data_;
+    size_t data_size_;
+    size_t data_pos_;
+    std::vector<uint8_t> prefix_;
+    size_t prefix_pos_;
+    uint8_t* output_;
+    SampleFormat format_;
+    uint64_t output_capacity_;
+    uint64_t samples_written_;
     std::vector<int32_t>* buffer_;
+    std::vector<int32_t>* carry_;
+    Overview* overview_;
+    const DecodeControl* control_;
+    LoadStats* stats_;
     unsigned channels_;
     unsigned bits_per_sample_;
     unsigned sample_rate_;
@@ -222,220 +880,3870 @@ void free_metadata_blocks(std::vector<FLAC__StreamMetadata*>& blocks) {
     blocks.clear();
 }
 
-// convert metadata blocks to Python dict
-PyObject* metadata_to_dict(const std::vector<FLAC__StreamMetadata*>& metadata_blocks) {
-    PyObject* dict = PyDict_New();
-    if (!dict) return NULL;
-    
-    for (const auto* metadata : metadata_blocks) {
-        switch (metadata->type) {
-            case FLAC__METADATA_TYPE_STREAMINFO:
-            {
-                const auto& info = metadata->data.stream_info;
-                PyDict_SetItemString(dict, "min_blocksize", PyLong_FromLong(info.min_blocksize));
-                PyDict_SetItemString(dict, "max_blocksize", PyLong_FromLong(info.max_blocksize));
-                PyDict_SetItemString(dict, "min_framesize", PyLong_FromLong(info.min_framesize));
-                PyDict_SetItemString(dict, "max_framesize", PyLong_FromLong(info.max_framesize));
-                PyDict_SetItemString(dict, "sample_rate", PyLong_FromLong(info.sample_rate));
-                PyDict_SetItemString(dict, "channels", PyLong_FromLong(info.channels));
-                PyDict_SetItemString(dict, "bits_per_sample", PyLong_FromLong(info.bits_per_sample));
-                PyDict_SetItemString(dict, "total_samples", PyLong_FromUnsignedLongLong(info.total_samples));
-                break;
-            }
-            case FLAC__METADATA_TYPE_VORBIS_COMMENT:
-            {
-                const auto& vc = metadata->data.vorbis_comment;
-                PyObject* comments = PyDict_New();
-                
-                // add vendor string
-                if (vc.vendor_string.entry) {
-                    PyDict_SetItemString(comments, "vendor", 
-                        PyUnicode_FromStringAndSize((const char*)vc.vendor_string.entry, vc.vendor_string.length));
-                }
-                
-                // add comments
-                for (unsigned i = 0; i < vc.num_comments; i++) {
-                    const FLAC__StreamMetadata_VorbisComment_Entry& entry = vc.comments[i];
-                    if (entry.entry) {
-                        std::string comment((const char*)entry.entry, entry.length);
-                        size_t eq_pos = comment.find('=');
-                        if (eq_pos != std::string::npos) {
-                            std::string field = comment.substr(0, eq_pos);
-                            std::string value = comment.substr(eq_pos + 1);
-                            PyDict_SetItemString(comments, field.c_str(), PyUnicode_FromString(value.c_str()));
-                        }
-                    }
-                }
-                
-                PyDict_SetItemString(dict, "vorbis_comment", comments);
-                break;
-            }
-            case FLAC__METADATA_TYPE_PICTURE:
-            {
-                const auto& pic = metadata->data.picture;
-                PyObject* picture = PyDict_New();
-                
-                PyDict_SetItemString(picture, "type", PyLong_FromLong(pic.type));
-                PyDict_SetItemString(picture, "mime_type", PyUnicode_FromString(pic.mime_type));
-                PyDict_SetItemString(picture, "description", 
-                    PyUnicode_FromStringAndSize((const char*)pic.description, strlen((const char*)pic.description)));
-                PyDict_SetItemString(picture, "width", PyLong_FromLong(pic.width));
-                PyDict_SetItemString(picture, "height", PyLong_FromLong(pic.height));
-                PyDict_SetItemString(picture, "depth", PyLong_FromLong(pic.depth));
-                PyDict_SetItemString(picture, "colors", PyLong_FromLong(pic.colors));
-                
-                PyObject* data = PyBytes_FromStringAndSize((const char*)pic.data, pic.data_length);
-                PyDict_SetItemString(picture, "data", data);
-                Py_DECREF(data);
-                
-                // add to pictures list
-                PyObject* pictures;
-                if (!PyDict_GetItemString(dict, "pictures")) {
-                    pictures = PyList_New(0);
-                    PyDict_SetItemString(dict, "pictures", pictures);
-                    Py_DECREF(pictures);
-                } else {
-                    pictures = PyDict_GetItemString(dict, "pictures");
-                }
-                
-                PyList_Append(pictures, picture);
-                Py_DECREF(picture);
-                break;
-            }
-            // tbd: handle other metadata types as needed...
-        }
+// set a dict item from a new reference, which is always released
+static int dict_set_new(PyObject* dict, const char* key, PyObject* value) {
+    if (!value) {
+        return -1;
     }
-    
-    return dict;
+    int status = PyDict_SetItemString(dict, key, value);
+    Py_DECREF(value);
+    return status;
 }
 
-// load a FLAC file with optional offset and length
-PyObject* flacpy_load(PyObject* self, PyObject* args, PyObject* kwargs) {
-    const char* filename;
-    uint64_t start_sample = 0;
-    uint64_t num_samples = 0;
-    int metadata_only = 0;
-    
-    static const char* kwlist[] = {"filename", "start_sample", "num_samples", "metadata_only", NULL};
-    
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|KKp", const_cast<char**>(kwlist),
-                                   &filename, &start_sample, &num_samples, &metadata_only)) {
-        return NULL;
-    }
-    
-    std::vector<int32_t> buffer;
-    PartialFLACDecoder decoder;
-    
-    // set up decoder
-    decoder.set_buffer(&buffer);
-    decoder.set_range(start_sample, num_samples);
-    decoder.set_metadata_only(metadata_only != 0);
+// metadata blocks cloned by a decoder, shared by the Metadata mapping built from them and
+// every picture buffer it hands out, so a memoryview of the cover art can outlive the mapping
+struct MetadataBlocks {
+    std::vector<FLAC__StreamMetadata*> blocks;
+    ~MetadataBlocks() { free_metadata_blocks(blocks); }
+};
 
-    // Tell the decoder to process all metadata types
-    decoder.set_metadata_respond_all();
-    //decoder.set_metadata_respond(FLAC__METADATA_TYPE_VORBIS_COMMENT);
+// read-only buffer over the data of one PICTURE block, only ever seen wrapped in a memoryview
+typedef struct {
+    PyObject_HEAD
+    std::shared_ptr<MetadataBlocks>* blocks;
+    const FLAC__StreamMetadata_Picture* picture;  // points into blocks
+} FLACPictureDataObject;
 
-    // initialize decoder
-    FLAC__StreamDecoderInitStatus init_status = decoder.init(filename);
-    if (init_status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
-        PyErr_Format(PyExc_RuntimeError, "Failed to initialize FLAC decoder: %s",
-                    FLAC__StreamDecoderInitStatusString[init_status]);
-        return NULL;
-    }
-    
-    // process metadata
-    decoder.process_until_end_of_metadata();
+static void FLACPictureData_dealloc(FLACPictureDataObject* self) {
+    delete self->blocks;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static int FLACPictureData_getbuffer(FLACPictureDataObject* self, Py_buffer* view, int flags) {
+    return PyBuffer_FillInfo(view, reinterpret_cast<PyObject*>(self), self->picture->data,
+                             static_cast<Py_ssize_t>(self->picture->data_length), 1, flags);
+}
+
+static PyBufferProcs FLACPictureData_as_buffer = {
+    (getbufferproc)FLACPictureData_getbuffer, /* bf_getbuffer */
+    0,                            /* bf_releasebuffer */
+};
+
+PyTypeObject FLACPictureDataType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "flacpy._PictureData",        /* tp_name */
+    sizeof(FLACPictureDataObject), /* tp_basicsize */
+    0,                            /* tp_itemsize */
+    (destructor)FLACPictureData_dealloc, /* tp_dealloc */
+    0,                            /* tp_print */
+    0,                            /* tp_getattr */
+    0,                            /* tp_setattr */
+    0,                            /* tp_compare */
+    0,                            /* tp_repr */
+    0,                            /* tp_as_number */
+    0,                            /* tp_as_sequence */
+    0,                            /* tp_as_mapping */
+    0,                            /* tp_hash */
+    0,                            /* tp_call */
+    0,                            /* tp_str */
+    0,                            /* tp_getattro */
+    0,                            /* tp_setattro */
+    &FLACPictureData_as_buffer,   /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,           /* tp_flags */
+    "Picture data held by a Metadata mapping", /* tp_doc */
+};
+
+// a zero-copy memoryview of a picture's data
+static PyObject* picture_data_view(const std::shared_ptr<MetadataBlocks>& blocks, const FLAC__StreamMetadata_Picture& picture) {
+    FLACPictureDataObject* owner = PyObject_New(FLACPictureDataObject, &FLACPictureDataType);
+    if (!owner) {
+        return NULL;
+    }
+    owner->blocks = new std::shared_ptr<MetadataBlocks>(blocks);
+    owner->picture = &picture;
+    PyObject* view = PyMemoryView_FromObject(reinterpret_cast<PyObject*>(owner));
+    Py_DECREF(owner);
+    return view;
+}
+
+// STREAMINFO fields, in the order the mapping lists them
+static const char* const streaminfo_keys[] = {
+    "min_blocksize", "max_blocksize", "min_framesize", "max_framesize",
+    "sample_rate", "channels", "bits_per_sample", "total_samples"
+};
+static const size_t num_streaminfo_keys = sizeof(streaminfo_keys) / sizeof(streaminfo_keys[0]);
+
+static PyObject* streaminfo_value(const FLAC__StreamMetadata_StreamInfo& info, size_t key) {
+    switch (key) {
+        case 0: return PyLong_FromUnsignedLong(info.min_blocksize);
+        case 1: return PyLong_FromUnsignedLong(info.max_blocksize);
+        case 2: return PyLong_FromUnsignedLong(info.min_framesize);
+        case 3: return PyLong_FromUnsignedLong(info.max_framesize);
+        case 4: return PyLong_FromUnsignedLong(info.sample_rate);
+        case 5: return PyLong_FromUnsignedLong(info.channels);
+        case 6: return PyLong_FromUnsignedLong(info.bits_per_sample);
+        default: return PyLong_FromUnsignedLongLong(info.total_samples);
+    }
+}
+
+static PyObject* vorbis_comment_to_dict(const FLAC__StreamMetadata_VorbisComment& vc) {
+    PyObject* comments = PyDict_New();
+    
+    // add vendor string
+    if (comments && vc.vendor_string.entry &&
+        dict_set_new(comments, "vendor", PyUnicode_DecodeUTF8(reinterpret_cast<const char*>(vc.vendor_string.entry),
+                                                              vc.vendor_string.length, "replace")) < 0) {
+        Py_CLEAR(comments);
+    }
+    
+    // add comments
+    for (unsigned i = 0; comments && i < vc.num_comments; i++) {
+        const FLAC__StreamMetadata_VorbisComment_Entry& entry = vc.comments[i];
+        const char* text = reinterpret_cast<const char*>(entry.entry);
+        const char* eq = text ? static_cast<const char*>(std::memchr(text, '=', entry.length)) : nullptr;
+        if (!eq) {
+            continue;
+        }
+        std::string field(text, eq - text);
+        if (dict_set_new(comments, field.c_str(), PyUnicode_DecodeUTF8(eq + 1, text + entry.length - eq - 1, "replace")) < 0) {
+            Py_CLEAR(comments);
+        }
+    }
+    return comments;
+}
+
+static PyObject* picture_to_dict(const std::shared_ptr<MetadataBlocks>& blocks, const FLAC__StreamMetadata_Picture& pic) {
+    PyObject* picture = PyDict_New();
+    const char* description = reinterpret_cast<const char*>(pic.description);
+    bool ok = picture &&
+              dict_set_new(picture, "type", PyLong_FromLong(pic.type)) == 0 &&
+              dict_set_new(picture, "mime_type", PyUnicode_FromString(pic.mime_type ? pic.mime_type : "")) == 0 &&
+              dict_set_new(picture, "description", PyUnicode_DecodeUTF8(description ? description : "",
+                                                                        description ? strlen(description) : 0, "replace")) == 0 &&
+              dict_set_new(picture, "width", PyLong_FromUnsignedLong(pic.width)) == 0 &&
+              dict_set_new(picture, "height", PyLong_FromUnsignedLong(pic.height)) == 0 &&
+              dict_set_new(picture, "depth", PyLong_FromUnsignedLong(pic.depth)) == 0 &&
+              dict_set_new(picture, "colors", PyLong_FromUnsignedLong(pic.colors)) == 0 &&
+              dict_set_new(picture, "data", picture_data_view(blocks, pic)) == 0;
+    if (!ok) {
+        Py_XDECREF(picture);
+        return NULL;
+    }
+    return picture;
+}
+
+// keys of a Metadata mapping, in the order the blocks introduce them
+static std::vector<const char*> metadata_keys(const MetadataBlocks& metadata) {
+    std::vector<const char*> keys;
+    bool has_streaminfo = false, has_vorbis_comment = false, has_pictures = false;
+    for (const auto* block : metadata.blocks) {
+        if (block->type == FLAC__METADATA_TYPE_STREAMINFO && !has_streaminfo) {
+            keys.insert(keys.end(), streaminfo_keys, streaminfo_keys + num_streaminfo_keys);
+            has_streaminfo = true;
+        } else if (block->type == FLAC__METADATA_TYPE_VORBIS_COMMENT && !has_vorbis_comment) {
+            keys.push_back("vorbis_comment");
+            has_vorbis_comment = true;
+        } else if (block->type == FLAC__METADATA_TYPE_PICTURE && !has_pictures) {
+            keys.push_back("pictures");
+            has_pictures = true;
+        }
+        // tbd: handle other metadata types as needed...
+    }
+    return keys;
+}
+
+// build the value of one key from the blocks, NULL without an exception set if there's no such key
+static PyObject* metadata_value(const std::shared_ptr<MetadataBlocks>& metadata, const char* key) {
+    const FLAC__StreamMetadata* streaminfo = nullptr;
+    const FLAC__StreamMetadata* vorbis_comment = nullptr;
+    for (const auto* block : metadata->blocks) {
+        if (block->type == FLAC__METADATA_TYPE_STREAMINFO && !streaminfo) {
+            streaminfo = block;
+        } else if (block->type == FLAC__METADATA_TYPE_VORBIS_COMMENT) {
+            vorbis_comment = block;  // the last one wins, as it always has
+        }
+    }
+    
+    for (size_t i = 0; streaminfo && i < num_streaminfo_keys; i++) {
+        if (std::strcmp(key, streaminfo_keys[i]) == 0) {
+            return streaminfo_value(streaminfo->data.stream_info, i);
+        }
+    }
+    if (vorbis_comment && std::strcmp(key, "vorbis_comment") == 0) {
+        return vorbis_comment_to_dict(vorbis_comment->data.vorbis_comment);
+    }
+    if (std::strcmp(key, "pictures") == 0) {
+        PyObject* pictures = nullptr;
+        for (const auto* block : metadata->blocks) {
+            if (block->type != FLAC__METADATA_TYPE_PICTURE) {
+                continue;
+            }
+            pictures = pictures ? pictures : PyList_New(0);
+            PyObject* picture = pictures ? picture_to_dict(metadata, block->data.picture) : NULL;
+            if (!picture || PyList_Append(pictures, picture) < 0) {
+                Py_XDECREF(picture);
+                Py_XDECREF(pictures);
+                return PyErr_Occurred() ? NULL : PyErr_NoMemory();
+            }
+            Py_DECREF(picture);
+        }
+        return pictures;
+    }
+    return NULL;
+}
+
+// take the blocks into a new Metadata mapping, leaving the vector empty. on failure the
+// blocks stay with the caller
+PyObject* metadata_new(std::vector<FLAC__StreamMetadata*>& metadata_blocks) {
+    FLACMetadataObject* self = PyObject_GC_New(FLACMetadataObject, &FLACMetadataType);
+    if (!self) {
+        return NULL;
+    }
+    self->blocks = new std::shared_ptr<MetadataBlocks>(std::make_shared<MetadataBlocks>());
+    self->values = NULL;
+    (*self->blocks)->blocks.swap(metadata_blocks);
+    PyObject_GC_Track(self);
+    return reinterpret_cast<PyObject*>(self);
+}
+
+// the cached values are plain dicts and lists the caller can modify, and so can point back here
+static int FLACMetadata_traverse(FLACMetadataObject* self, visitproc visit, void* arg) {
+    Py_VISIT(self->values);
+    return 0;
+}
+
+static int FLACMetadata_clear(FLACMetadataObject* self) {
+    Py_CLEAR(self->values);
+    return 0;
+}
+
+static void FLACMetadata_dealloc(FLACMetadataObject* self) {
+    PyObject_GC_UnTrack(self);
+    FLACMetadata_clear(self);
+    delete self->blocks;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+// the value for key, built on first access and kept so that later lookups return the same
+// object. NULL without an exception set if there's no such key
+static PyObject* FLACMetadata_lookup(FLACMetadataObject* self, PyObject* key) {
+    if (!PyUnicode_Check(key)) {
+        return NULL;
+    }
+    if (self->values) {
+        PyObject* value = PyDict_GetItemWithError(self->values, key);
+        if (value || PyErr_Occurred()) {
+            return Py_XNewRef(value);
+        }
+    }
+    
+    const char* key_str = PyUnicode_AsUTF8(key);
+    PyObject* value = key_str ? metadata_value(*self->blocks, key_str) : NULL;
+    if (!value) {
+        return NULL;
+    }
+    if (!self->values && !(self->values = PyDict_New())) {
+        Py_DECREF(value);
+        return NULL;
+    }
+    if (PyDict_SetItem(self->values, key, value) < 0) {
+        Py_DECREF(value);
+        return NULL;
+    }
+    return value;
+}
+
+static PyObject* FLACMetadata_subscript(FLACMetadataObject* self, PyObject* key) {
+    PyObject* value = FLACMetadata_lookup(self, key);
+    if (!value && !PyErr_Occurred()) {
+        PyErr_SetObject(PyExc_KeyError, key);
+    }
+    return value;
+}
+
+static Py_ssize_t FLACMetadata_length(FLACMetadataObject* self) {
+    return static_cast<Py_ssize_t>(metadata_keys(**self->blocks).size());
+}
+
+static int FLACMetadata_contains(FLACMetadataObject* self, PyObject* key) {
+    if (!PyUnicode_Check(key)) {
+        return 0;
+    }
+    const char* key_str = PyUnicode_AsUTF8(key);
+    if (!key_str) {
+        return -1;
+    }
+    for (const char* name : metadata_keys(**self->blocks)) {
+        if (std::strcmp(name, key_str) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static PyObject* FLACMetadata_keys(FLACMetadataObject* self, PyObject* Py_UNUSED(ignored)) {
+    std::vector<const char*> names = metadata_keys(**self->blocks);
+    PyObject* keys = PyList_New(static_cast<Py_ssize_t>(names.size()));
+    for (size_t i = 0; keys && i < names.size(); i++) {
+        PyObject* key = PyUnicode_FromString(names[i]);
+        if (!key) {
+            Py_CLEAR(keys);
+            break;
+        }
+        PyList_SET_ITEM(keys, i, key);
+    }
+    return keys;
+}
+
+// a plain dict of every key, building whatever hasn't been accessed yet
+static PyObject* FLACMetadata_to_dict(FLACMetadataObject* self, PyObject* Py_UNUSED(ignored)) {
+    PyObject* keys = FLACMetadata_keys(self, NULL);
+    PyObject* dict = keys ? PyDict_New() : NULL;
+    for (Py_ssize_t i = 0; dict && i < PyList_GET_SIZE(keys); i++) {
+        PyObject* key = PyList_GET_ITEM(keys, i);
+        PyObject* value = FLACMetadata_subscript(self, key);
+        if (!value || PyDict_SetItem(dict, key, value) < 0) {
+            Py_CLEAR(dict);
+        }
+        Py_XDECREF(value);
+    }
+    Py_XDECREF(keys);
+    return dict;
+}
+
+static PyObject* FLACMetadata_values(FLACMetadataObject* self, PyObject* Py_UNUSED(ignored)) {
+    PyObject* dict = FLACMetadata_to_dict(self, NULL);
+    PyObject* values = dict ? PyDict_Values(dict) : NULL;
+    Py_XDECREF(dict);
+    return values;
+}
+
+static PyObject* FLACMetadata_items(FLACMetadataObject* self, PyObject* Py_UNUSED(ignored)) {
+    PyObject* dict = FLACMetadata_to_dict(self, NULL);
+    PyObject* items = dict ? PyDict_Items(dict) : NULL;
+    Py_XDECREF(dict);
+    return items;
+}
+
+static PyObject* FLACMetadata_get(FLACMetadataObject* self, PyObject* args) {
+    PyObject* key;
+    PyObject* default_value = Py_None;
+    if (!PyArg_ParseTuple(args, "O|O", &key, &default_value)) {
+        return NULL;
+    }
+    PyObject* value = FLACMetadata_lookup(self, key);
+    if (!value && !PyErr_Occurred()) {
+        return Py_NewRef(default_value);
+    }
+    return value;
+}
+
+static PyObject* FLACMetadata_iter(FLACMetadataObject* self) {
+    PyObject* keys = FLACMetadata_keys(self, NULL);
+    PyObject* iter = keys ? PyObject_GetIter(keys) : NULL;
+    Py_XDECREF(keys);
+    return iter;
+}
+
+static PyObject* FLACMetadata_repr(FLACMetadataObject* self) {
+    PyObject* dict = FLACMetadata_to_dict(self, NULL);
+    PyObject* repr = dict ? PyUnicode_FromFormat("flacpy.Metadata(%R)", dict) : NULL;
+    Py_XDECREF(dict);
+    return repr;
+}
+
+// compares equal to a dict or Metadata with the same contents
+static PyObject* FLACMetadata_richcompare(FLACMetadataObject* self, PyObject* other, int op) {
+    if ((op != Py_EQ && op != Py_NE) ||
+        !(PyDict_Check(other) || PyObject_TypeCheck(other, &FLACMetadataType))) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+    PyObject* dict = FLACMetadata_to_dict(self, NULL);
+    PyObject* other_dict = !dict ? NULL : PyDict_Check(other)
+        ? Py_NewRef(other) : FLACMetadata_to_dict(reinterpret_cast<FLACMetadataObject*>(other), NULL);
+    PyObject* result = other_dict ? PyObject_RichCompare(dict, other_dict, op) : NULL;
+    Py_XDECREF(dict);
+    Py_XDECREF(other_dict);
+    return result;
+}
+
+static PyMethodDef FLACMetadata_methods[] = {
+    {"keys", (PyCFunction)FLACMetadata_keys, METH_NOARGS, "List of the keys present"},
+    {"values", (PyCFunction)FLACMetadata_values, METH_NOARGS, "List of every value, building any not yet accessed"},
+    {"items", (PyCFunction)FLACMetadata_items, METH_NOARGS, "List of (key, value) pairs, building any not yet accessed"},
+    {"get", (PyCFunction)FLACMetadata_get, METH_VARARGS, "Value for key if present, else default"},
+    {"to_dict", (PyCFunction)FLACMetadata_to_dict, METH_NOARGS, "Plain dict of every key"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyMappingMethods FLACMetadata_as_mapping = {
+    (lenfunc)FLACMetadata_length,       /* mp_length */
+    (binaryfunc)FLACMetadata_subscript, /* mp_subscript */
+    0,                                  /* mp_ass_subscript */
+};
+
+static PySequenceMethods FLACMetadata_as_sequence = {
+    0,                                  /* sq_length */
+    0,                                  /* sq_concat */
+    0,                                  /* sq_repeat */
+    0,                                  /* sq_item */
+    0,                                  /* was_sq_slice */
+    0,                                  /* sq_ass_item */
+    0,                                  /* was_sq_ass_slice */
+    (objobjproc)FLACMetadata_contains,  /* sq_contains */
+};
+
+PyTypeObject FLACMetadataType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "flacpy.Metadata",            /* tp_name */
+    sizeof(FLACMetadataObject),   /* tp_basicsize */
+    0,                            /* tp_itemsize */
+    (destructor)FLACMetadata_dealloc, /* tp_dealloc */
+    0,                            /* tp_print */
+    0,                            /* tp_getattr */
+    0,                            /* tp_setattr */
+    0,                            /* tp_compare */
+    (reprfunc)FLACMetadata_repr,  /* tp_repr */
+    0,                            /* tp_as_number */
+    &FLACMetadata_as_sequence,    /* tp_as_sequence */
+    &FLACMetadata_as_mapping,     /* tp_as_mapping */
+    0,                            /* tp_hash */
+    0,                            /* tp_call */
+    0,                            /* tp_str */
+    0,                            /* tp_getattro */
+    0,                            /* tp_setattro */
+    0,                            /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_MAPPING | Py_TPFLAGS_HAVE_GC, /* tp_flags */
+    "Read-only mapping of a stream's metadata, built lazily from its blocks", /* tp_doc */
+    (traverseproc)FLACMetadata_traverse, /* tp_traverse */
+    (inquiry)FLACMetadata_clear,  /* tp_clear */
+    (richcmpfunc)FLACMetadata_richcompare, /* tp_richcompare */
+    0,                            /* tp_weaklistoffset */
+    (getiterfunc)FLACMetadata_iter, /* tp_iter */
+    0,                            /* tp_iternext */
+    FLACMetadata_methods,         /* tp_methods */
+};
+
+// holds the GIL for the lifetime of the object, safe to use from any thread
+class ScopedGIL {
+public:
+    ScopedGIL() : state_(PyGILState_Ensure()) {}
+    ~ScopedGIL() { PyGILState_Release(state_); }
+private:
+    PyGILState_STATE state_;
+};
+
+// lock a mutex that its other holders may take the GIL under. called with the GIL, which is let
+// go of while waiting so that the mutex is always taken before the GIL and never the other way
+static std::unique_lock<std::mutex> lock_with_gil(std::mutex& mutex) {
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        Py_BEGIN_ALLOW_THREADS
+        lock.lock();
+        Py_END_ALLOW_THREADS
+    }
+    return lock;
+}
+
+// decoders and output memory kept between loads, so that a steady stream of loads stops
+// constructing libFLAC decoders and faulting in fresh pages for every output array. output
+// arrays are views of pooled buffers that come back to the pool when the array is freed, so
+// buffers can outlive the pool object itself
+class DecoderPool : public std::enable_shared_from_this<DecoderPool> {
+public:
+    DecoderPool(size_t max_decoders, size_t max_idle_bytes) :
+        max_decoders_(max_decoders), max_idle_bytes_(max_idle_bytes), idle_bytes_(0) {}
+
+    ~DecoderPool() {
+        for (auto& buffer : buffers_) {
+            std::free(buffer.second);
+        }
+    }
+
+    DecoderPool(const DecoderPool&) = delete;
+    DecoderPool& operator=(const DecoderPool&) = delete;
+
+    std::unique_ptr<PartialFLACDecoder> acquire_decoder() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!decoders_.empty()) {
+                std::unique_ptr<PartialFLACDecoder> decoder = std::move(decoders_.back());
+                decoders_.pop_back();
+                return decoder;
+            }
+        }
+        return std::unique_ptr<PartialFLACDecoder>(new PartialFLACDecoder());
+    }
+
+    void release_decoder(std::unique_ptr<PartialFLACDecoder> decoder) {
+        free_metadata_blocks(decoder->metadata_blocks);
+        decoder->recycle();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (decoders_.size() < max_decoders_) {
+            decoders_.push_back(std::move(decoder));
+        }
+    }
+
+    // a new (frames x channels) array in the given format over pooled memory, reusing the
+    // smallest idle buffer that fits and isn't more than twice the size needed. needs the GIL
+    PyObject* new_array(npy_intp* dims, const SampleFormat& format) {
+        const size_t bytes = std::max<size_t>(1, static_cast<size_t>(dims[0]) * static_cast<size_t>(dims[1]) * format.itemsize());
+        void* data = nullptr;
+        size_t capacity = bytes;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = buffers_.lower_bound(bytes);
+            if (it != buffers_.end() && it->first / 2 <= bytes) {
+                data = it->second;
+                capacity = it->first;
+                idle_bytes_ -= capacity;
+                buffers_.erase(it);
+            }
+        }
+        if (!data && !(data = std::malloc(capacity))) {
+            return PyErr_NoMemory();
+        }
+        
+        PooledBuffer* buffer = new PooledBuffer{shared_from_this(), data, capacity};
+        PyObject* base = PyCapsule_New(buffer, NULL, release_pooled_buffer);
+        if (!base) {
+            release_buffer(data, capacity);
+            delete buffer;
+            return NULL;
+        }
+        PyObject* array = PyArray_New(&PyArray_Type, 2, dims, format.type, NULL, data, 0, NPY_ARRAY_CARRAY, NULL);
+        if (!array) {
+            Py_DECREF(base);
+            return NULL;
+        }
+        // the base is taken over even if this fails
+        if (PyArray_SetBaseObject(reinterpret_cast<PyArrayObject*>(array), base) < 0) {
+            Py_DECREF(array);
+            return NULL;
+        }
+        return array;
+    }
+
+    size_t idle_decoders() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return decoders_.size();
+    }
+
+    size_t idle_bytes() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return idle_bytes_;
+    }
+
+private:
+    // base object of a pooled array
+    struct PooledBuffer {
+        std::shared_ptr<DecoderPool> pool;
+        void* data;
+        size_t capacity;
+    };
+
+    static void release_pooled_buffer(PyObject* capsule) {
+        PooledBuffer* buffer = static_cast<PooledBuffer*>(PyCapsule_GetPointer(capsule, NULL));
+        buffer->pool->release_buffer(buffer->data, buffer->capacity);
+        delete buffer;
+    }
+
+    // keep the buffer for the next array unless that would go over the idle limit
+    void release_buffer(void* data, size_t capacity) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (idle_bytes_ + capacity <= max_idle_bytes_) {
+                buffers_.emplace(capacity, data);
+                idle_bytes_ += capacity;
+                return;
+            }
+        }
+        std::free(data);
+    }
+
+    const size_t max_decoders_;
+    const size_t max_idle_bytes_;
+    std::vector<std::unique_ptr<PartialFLACDecoder>> decoders_;
+    std::multimap<size_t, void*> buffers_;  // idle buffers by capacity
+    size_t idle_bytes_;
+    std::mutex mutex_;
+};
+
+// a decoder for one decode, borrowed from a pool if there is one
+class DecoderLease {
+public:
+    explicit DecoderLease(DecoderPool* pool) :
+        pool_(pool), decoder_(pool ? pool->acquire_decoder() : std::unique_ptr<PartialFLACDecoder>(new PartialFLACDecoder())) {}
+    ~DecoderLease() {
+        if (pool_) {
+            pool_->release_decoder(std::move(decoder_));
+        }
+    }
+
+    DecoderLease(const DecoderLease&) = delete;
+    DecoderLease& operator=(const DecoderLease&) = delete;
+
+    PartialFLACDecoder& operator*() { return *decoder_; }
+
+private:
+    DecoderPool* pool_;
+    std::unique_ptr<PartialFLACDecoder> decoder_;
+};
+
+// everything produced by decoding one file, filled in without the GIL and
+// turned into Python objects afterwards by build_load_result
+struct DecodedAudio {
+    PyObject* audio = nullptr;          // new reference, unless decoding into caller memory
+    void* output = nullptr;             // optional caller memory to decode into instead, laid out as format says
+    uint64_t output_capacity = 0;       // in samples
+    unsigned output_channels = 0;
+    SampleFormat format;                // requested dtype of audio or of the caller memory
+    std::vector<FLAC__StreamMetadata*> metadata_blocks;
+    unsigned channels = 0;
+    unsigned sample_rate = 0;
+    unsigned bits_per_sample = 0;
+    uint64_t samples_written = 0;
+    const DecodeControl* control = nullptr;  // optional, lets load_async stop the decode
+    DecoderPool* pool = nullptr;             // optional source of decoders and output memory
+    bool collect_stats = false;              // fill stats even when flacpy.stats isn't enabled
+    LoadStats stats;
+    std::string error;
+};
+
+// (first sample, byte offset) of every frame of a stream, as produced by build_index. points
+// either into an index array we hold a reference to or into storage read from a sidecar file
+struct FrameIndex {
+    PyObject* array = nullptr;
+    std::vector<uint64_t> storage;
+    const uint64_t* entries = nullptr;  // count pairs
+    size_t count = 0;
+    StreamFingerprint fingerprint;      // only sidecar files carry one
+    bool has_fingerprint = false;
+
+    FrameIndex() = default;
+    FrameIndex(const FrameIndex&) = delete;
+    FrameIndex& operator=(const FrameIndex&) = delete;
+    ~FrameIndex() { Py_XDECREF(array); }
+
+    const StreamFingerprint* stream_fingerprint() const { return has_fingerprint ? &fingerprint : nullptr; }
+
+    // first sample and byte offset of the frame holding sample
+    bool find(uint64_t sample, uint64_t* first_sample, uint64_t* byte_offset) const {
+        if (count == 0 || entries[0] > sample) {
+            return false;
+        }
+        size_t low = 0, high = count;
+        while (high - low > 1) {
+            size_t mid = low + (high - low) / 2;
+            if (entries[mid * 2] <= sample) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        *first_sample = entries[low * 2];
+        *byte_offset = entries[low * 2 + 1];
+        return true;
+    }
+};
+
+// index sidecar layout: the magic, the stream's length, its STREAMINFO padded to 40 bytes, the
+// number of frames, then a (first sample, byte offset) pair per frame, every number a
+// little-endian uint64
+static const char index_magic[8] = {'f', 'l', 'a', 'c', 'p', 'y', 'i', '2'};
+static const size_t index_streaminfo_size = 40;
+static const size_t index_header_size = sizeof(index_magic) + 8 + index_streaminfo_size + 8;
+
+static bool write_index_file(const std::string& path, const std::vector<uint64_t>& entries,
+                             const StreamFingerprint& fingerprint, std::string& error) {
+    std::vector<uint8_t> bytes(index_header_size + 8 * entries.size());
+    auto write_u64 = [&](size_t offset, uint64_t value) {
+        for (int b = 0; b < 8; b++) {
+            bytes[offset + b] = static_cast<uint8_t>(value >> (8 * b));
+        }
+    };
+    std::memcpy(bytes.data(), index_magic, sizeof(index_magic));
+    write_u64(sizeof(index_magic), fingerprint.length);
+    std::memcpy(bytes.data() + sizeof(index_magic) + 8, fingerprint.streaminfo, sizeof(fingerprint.streaminfo));
+    write_u64(index_header_size - 8, entries.size() / 2);
+    for (size_t i = 0; i < entries.size(); i++) {
+        write_u64(index_header_size + 8 * i, entries[i]);
+    }
+    
+    FILE* file = fopen_utf8(path.c_str(), "wb");
+    if (!file) {
+        error = "Failed to open " + path + " for writing";
+        return false;
+    }
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok) {
+        error = "Failed to write " + path;
+    }
+    return ok;
+}
+
+static bool read_index_file(const std::string& path, std::vector<uint64_t>& entries,
+                            StreamFingerprint& fingerprint, std::string& error) {
+    FILE* file = fopen_utf8(path.c_str(), "rb");
+    if (!file) {
+        error = "Failed to open " + path;
+        return false;
+    }
+    uint64_t size = 0;
+    std::vector<uint8_t> bytes;
+    bool ok = file_size64(file, &size) && size >= index_header_size && (size - index_header_size) % 16 == 0;
+    if (ok) {
+        bytes.resize(static_cast<size_t>(size));
+        ok = std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size() &&
+             std::memcmp(bytes.data(), index_magic, sizeof(index_magic)) == 0;
+    }
+    std::fclose(file);
+    
+    if (ok) {
+        auto read_u64 = [&](size_t offset) {
+            uint64_t value = 0;
+            for (int b = 0; b < 8; b++) {
+                value |= uint64_t(bytes[offset + b]) << (8 * b);
+            }
+            return value;
+        };
+        fingerprint.length = read_u64(sizeof(index_magic));
+        std::memcpy(fingerprint.streaminfo, bytes.data() + sizeof(index_magic) + 8, sizeof(fingerprint.streaminfo));
+        entries.resize((bytes.size() - index_header_size) / 8);
+        for (size_t i = 0; i < entries.size(); i++) {
+            entries[i] = read_u64(index_header_size + 8 * i);
+        }
+        ok = read_u64(index_header_size - 8) * 2 == entries.size();
+    }
+    if (!ok) {
+        error = path + " is not a flacpy index";
+    }
+    return ok;
+}
+
+// ranges shorter than this per thread aren't worth a decoder of their own
+static const uint64_t parallel_decode_min_samples = 1 << 15;
+
+// decode [start, start + length) of a source into output with a decoder of its own, reading only
+// STREAMINFO from the metadata. false if the slice couldn't be decoded in full
+static bool decode_slice(const FLACSource& source, uint64_t start, uint64_t length, unsigned channels,
+                         const SampleFormat& format, void* output, const FrameIndex* index,
+                         const DecodeControl* control, DecoderPool* pool, LoadStats* stats) {
+    DecoderLease lease(pool);
+    PartialFLACDecoder& decoder = *lease;
+    decoder.set_range(start, length);
+    decoder.set_control(control);
+    decoder.set_stats(stats);
+    {
+        StatsTimer timer(stats_field(stats, &LoadStats::open_ns));
+        if (decoder.init(source) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+            return false;
+        }
+    }
+    uint64_t frame_start = 0, frame_offset = 0;
+    const bool indexed = index && index->find(start, &frame_start, &frame_offset);
+    bool ok = true;
+    if (indexed) {
+        StatsTimer timer(stats_field(stats, &LoadStats::seek_ns));
+        stats_count(stats_field(stats, &LoadStats::seeks));
+        ok = decoder.start_at_frame(frame_offset, frame_start, index->stream_fingerprint());
+    }
+    if (ok) {
+        StatsTimer timer(stats_field(stats, &LoadStats::metadata_ns));
+        ok = decoder.process_until_end_of_metadata() && decoder.get_channels() == channels;
+    }
+    if (ok) {
+        decoder.set_format(format);
+        decoder.set_output(output, length);
+    }
+    if (ok && !indexed && start > 0) {
+        // the seek itself decodes the first frame, which may already finish a short slice
+        StatsTimer timer(stats_field(stats, &LoadStats::seek_ns));
+        stats_count(stats_field(stats, &LoadStats::seeks));
+        ok = decoder.seek_absolute(start) || decoder.get_samples_written() == length;
+    }
+    if (ok) {
+        if (decoder.get_samples_written() < length) {
+            StatsTimer timer(stats_field(stats, &LoadStats::decode_ns));
+            decoder.process_until_end_of_stream();
+        }
+        ok = decoder.get_samples_written() == length;
+    }
+    decoder.finish();
+    free_metadata_blocks(decoder.metadata_blocks);
+    return ok;
+}
+
+// split a range into one slice per thread and decode the slices side by side, each into its own
+// part of output. slice boundaries snap to nearby seekpoints or indexed frames so that every
+// worker starts on a frame boundary and no frame is decoded twice, elsewhere the seek finds the
+// frame itself. false if any slice fell short, as happens with truncated streams
+static bool decode_parallel(const FLACSource& source, uint64_t start, uint64_t length, unsigned channels,
+                            const SampleFormat& format, void* output, const std::vector<FLAC__StreamMetadata*>& metadata_blocks,
+                            const FrameIndex* index, size_t num_threads, const DecodeControl* control, DecoderPool* pool,
+                            LoadStats* stats) {
+    const size_t num_slices = static_cast<size_t>(std::min<uint64_t>(num_threads, length / parallel_decode_min_samples));
+    if (num_slices < 2) {
+        return false;
+    }
+    const uint64_t end = start + length;
+    
+    // frame starts we know of inside the range
+    std::vector<uint64_t> frame_starts;
+    if (index) {
+        for (size_t i = 0; i < index->count; i++) {
+            frame_starts.push_back(index->entries[i * 2]);
+        }
+    } else {
+        for (const FLAC__StreamMetadata* block : metadata_blocks) {
+            if (block->type != FLAC__METADATA_TYPE_SEEKTABLE) {
+                continue;
+            }
+            for (unsigned i = 0; i < block->data.seek_table.num_points; i++) {
+                uint64_t sample = block->data.seek_table.points[i].sample_number;
+                if (sample != FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER) {
+                    frame_starts.push_back(sample);
+                }
+            }
+        }
+        std::sort(frame_starts.begin(), frame_starts.end());
+    }
+    
+    std::vector<uint64_t> bounds(1, start);
+    const uint64_t tolerance = length / num_slices / 4;
+    for (size_t i = 1; i < num_slices; i++) {
+        uint64_t target = start + length / num_slices * i;
+        auto next = std::lower_bound(frame_starts.begin(), frame_starts.end(), target);
+        uint64_t best = target;
+        uint64_t best_distance = tolerance + 1;
+        if (next != frame_starts.end() && *next - target < best_distance) {
+            best = *next;
+            best_distance = *next - target;
+        }
+        if (next != frame_starts.begin() && target - *(next - 1) < best_distance) {
+            best = *(next - 1);
+        }
+        if (best > bounds.back() && best < end) {
+            bounds.push_back(best);
+        }
+    }
+    bounds.push_back(end);
+    
+    const ptrdiff_t frame_step = format.frame_step(channels);
+    std::vector<char> ok(bounds.size() - 1, 0);
+    parallel_for(get_thread_pool(), ok.size(), num_threads, [&](size_t i) {
+        ok[i] = decode_slice(source, bounds[i], bounds[i + 1] - bounds[i], channels, format,
+                             static_cast<uint8_t*>(output) + static_cast<ptrdiff_t>(bounds[i] - start) * frame_step, index, control, pool, stats);
+    });
+    return std::all_of(ok.begin(), ok.end(), [](char slice_ok) { return slice_ok != 0; });
+}
+
+// a decode stopped through its DecodeControl fails as a whole, dropping whatever it produced
+static bool decode_stopped(DecodedAudio& decoded, std::vector<FLAC__StreamMetadata*>& metadata_blocks) {
+    if (!decoded.control || !decoded.control->stopped()) {
+        return false;
+    }
+    if (decoded.audio) {
+        ScopedGIL gil;
+        Py_CLEAR(decoded.audio);
+    }
+    free_metadata_blocks(metadata_blocks);
+    decoded.error = decoded.control->timed_out() ? "Load timed out" : "Load cancelled";
+    return true;
+}
+
+// decode the requested range of one source. must be called without the GIL, which is only
+// taken briefly to allocate and trim the output array. with an index, decoding starts at the
+// frame holding start_sample and only STREAMINFO is read from the metadata
+static bool decode_source(const FLACSource& source, uint64_t start_sample, uint64_t num_samples,
+                          bool metadata_only, DecodedAudio& decoded, const FrameIndex* index = nullptr,
+                          size_t num_threads = 1) {
+    std::vector<int32_t> buffer;
+    DecoderLease lease(decoded.pool);
+    PartialFLACDecoder& decoder = *lease;
+    LoadStats* stats = decoded.collect_stats || stats_enabled().load(std::memory_order_relaxed) ? &decoded.stats : nullptr;
+    StatsCall<LoadStats> call(stats, load_stats_totals());
+    
+    // set up decoder
+    decoder.set_range(start_sample, num_samples);
+    decoder.set_metadata_only(metadata_only);
+    decoder.set_control(decoded.control);
+    decoder.set_stats(stats);
+
+    // Tell the decoder to process all metadata types
+    decoder.set_metadata_respond_all();
+    //decoder.set_metadata_respond(FLAC__METADATA_TYPE_VORBIS_COMMENT);
+
+    // initialize decoder
+    FLAC__StreamDecoderInitStatus init_status;
+    {
+        StatsTimer timer(stats_field(stats, &LoadStats::open_ns));
+        init_status = decoder.init(source);
+    }
+    if (init_status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+        decoded.error = std::string("Failed to initialize FLAC decoder: ") +
+                        FLAC__StreamDecoderInitStatusString[init_status];
+        return false;
+    }
+    
+    uint64_t frame_start = 0, frame_offset = 0;
+    const bool indexed = index && !metadata_only && index->find(start_sample, &frame_start, &frame_offset);
+    if (indexed) {
+        StatsTimer timer(stats_field(stats, &LoadStats::seek_ns));
+        stats_count(stats_field(stats, &LoadStats::seeks));
+        if (!decoder.start_at_frame(frame_offset, frame_start, index->stream_fingerprint())) {
+            decoded.error = "The index doesn't match the stream";
+            return false;
+        }
+    }
+    
+    // process metadata
+    {
+        StatsTimer timer(stats_field(stats, &LoadStats::metadata_ns));
+        decoder.process_until_end_of_metadata();
+    }
+    if (decode_stopped(decoded, decoder.metadata_blocks)) {
+        return false;
+    }
+    if (decoder.get_channels() == 0) {
+        decoded.error = "Not a FLAC stream, no STREAMINFO found";
+        free_metadata_blocks(decoder.metadata_blocks);
+        return false;
+    }
+    
+    decoded.channels = decoder.get_channels();
+    decoded.bits_per_sample = decoder.get_bits_per_sample();
+    decoded.sample_rate = decoder.get_sample_rate();
+    
+    if (!metadata_only && !decoded.format.configure(decoded.bits_per_sample, decoded.channels, decoded.error)) {
+        free_metadata_blocks(decoder.metadata_blocks);
+        return false;
+    }
+    
+    if (!metadata_only) {
+        // size the output from STREAMINFO so the decoder can write straight into it,
+        // streams of unknown length fall back to a growable buffer
+        uint64_t range_length = 0;
+        bool known_length = decoder.get_range_length(&range_length);
+        const bool stream_length_known = known_length;
+        
+        npy_intp dims[2];
+        dims[0] = known_length ? range_length : 0;  // number of frames
+        dims[1] = decoded.format.output_channels(decoded.channels);  // number of channels kept
+        
+        if (decoded.output) {
+            if (decoded.output_channels != decoded.format.output_channels(decoded.channels)) {
+                decoded.error = "Loading " + std::to_string(decoded.format.output_channels(decoded.channels)) +
+                                " channels but the output has " + std::to_string(decoded.output_channels);
+                free_metadata_blocks(decoder.metadata_blocks);
+                return false;
+            }
+            range_length = known_length ? std::min<uint64_t>(range_length, decoded.output_capacity) : decoded.output_capacity;
+            known_length = true;
+            decoder.set_format(decoded.format);
+            decoder.set_output(decoded.output, range_length);
+        } else {
+            {
+                StatsTimer timer(stats_field(stats, &LoadStats::output_ns));
+                ScopedGIL gil;
+                decoded.audio = decoded.pool ? decoded.pool->new_array(dims, decoded.format) :
+                                PyArray_SimpleNew(2, dims, decoded.format.type);
+                if (!decoded.audio) {
+                    PyErr_Clear();
+                }
+            }
+            if (!decoded.audio) {
+                decoded.error = "Failed to allocate the output array";
+                free_metadata_blocks(decoder.metadata_blocks);
+                return false;
+            }
+            decoder.set_format(decoded.format);
+            if (known_length) {
+                decoder.set_output(PyArray_DATA(reinterpret_cast<PyArrayObject*>(decoded.audio)), range_length);
+            } else {
+                decoder.set_buffer(&buffer);
+            }
+        }
+        
+        // long ranges are split across threads when the stream's length is known, anything
+        // that goes wrong there is left to the sequential decode below to deal with or report.
+        // the slices time their own phases
+        void* output = decoded.output ? decoded.output :
+                       decoded.audio ? PyArray_DATA(reinterpret_cast<PyArrayObject*>(decoded.audio)) : nullptr;
+        if (num_threads > 1 && stream_length_known && output &&
+            decode_parallel(source, start_sample, range_length, decoded.channels, decoded.format, output,
+                            decoder.metadata_blocks, indexed ? index : nullptr, num_threads, decoded.control, decoded.pool, stats)) {
+            decoded.samples_written = range_length;
+        } else {
+            // use seek table if possible for faster positioning
+            if (start_sample > 0 && !indexed) {
+                StatsTimer timer(stats_field(stats, &LoadStats::seek_ns));
+                stats_count(stats_field(stats, &LoadStats::seeks));
+                decoder.seek_absolute(start_sample);
+            }
+            
+            // Decode audio data
+            {
+                StatsTimer timer(stats_field(stats, &LoadStats::decode_ns));
+                decoder.process_until_end_of_stream();
+            }
+            decoded.samples_written = decoder.get_samples_written();
+        }
+        if (decode_stopped(decoded, decoder.metadata_blocks)) {
+            return false;
+        }
+        
+        // a truncated stream can deliver fewer samples than STREAMINFO promised,
+        // and unknown-length streams only now know how big they are
+        StatsTimer timer(stats_field(stats, &LoadStats::output_ns));
+        if (decoded.audio && static_cast<npy_intp>(decoded.samples_written) != dims[0]) {
+            ScopedGIL gil;
+            const bool shrink = static_cast<npy_intp>(decoded.samples_written) < dims[0];
+            dims[0] = static_cast<npy_intp>(decoded.samples_written);
+            PyArray_Dims new_shape = {dims, 2};
+            PyObject* resized;
+            if (decoded.pool) {
+                // pooled arrays don't own their memory, so a short stream keeps a view of the
+                // first samples and an unknown-length one moves to an array of the final size
+                resized = shrink ? PySequence_GetSlice(decoded.audio, 0, dims[0]) : decoded.pool->new_array(dims, decoded.format);
+                if (resized) {
+                    Py_SETREF(decoded.audio, resized);
+                    resized = Py_None;
+                    Py_INCREF(resized);
+                }
+            } else {
+                resized = PyArray_Resize(reinterpret_cast<PyArrayObject*>(decoded.audio), &new_shape, 0, NPY_CORDER);
+            }
+            if (!resized) {
+                PyErr_Clear();
+                Py_CLEAR(decoded.audio);
+                decoded.error = "Failed to resize the output array";
+                free_metadata_blocks(decoder.metadata_blocks);
+                return false;
+            }
+            Py_DECREF(resized);
+        }
+        
+        if (decoded.audio && !known_length) {
+            convert_interleaved(PyArray_DATA(reinterpret_cast<PyArrayObject*>(decoded.audio)), decoded.format,
+                                buffer.data(), buffer.size() / decoded.channels, decoded.channels);
+        }
+    }
+    
+    decoder.finish();
+    decoded.metadata_blocks.swap(decoder.metadata_blocks);
+    return true;
+}
+
+// build the dict returned by load, consumes the decoded audio and metadata blocks
+static PyObject* build_load_result(DecodedAudio& decoded, bool metadata_only) {
+    // create return value
+    PyObject* result = PyDict_New();
+    if (!result) {
+        Py_CLEAR(decoded.audio);
+        free_metadata_blocks(decoded.metadata_blocks);
+        return NULL;
+    }
+    
+    // add audio data if we requested it
+    if (!metadata_only) {
+        // add audio data and parameters to result
+        if (decoded.audio) {
+            PyDict_SetItemString(result, "audio", decoded.audio);
+            Py_CLEAR(decoded.audio);
+        }
+        dict_set_new(result, "sample_rate", PyLong_FromLong(decoded.sample_rate));
+        dict_set_new(result, "bits_per_sample", PyLong_FromLong(decoded.bits_per_sample));
+    }
+    
+    // add metadata to result, the mapping takes over the blocks
+    int status = dict_set_new(result, "metadata", metadata_new(decoded.metadata_blocks));
+    free_metadata_blocks(decoded.metadata_blocks);
+    if (status < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    
+    return result;
+}
+
+// read a filesystem path from a str or os.PathLike
+static bool parse_path(PyObject* obj, std::string& path) {
+    PyObject* fspath = PyOS_FSPath(obj);
+    if (!fspath) {
+        return false;
+    }
+    PyObject* encoded = NULL;
+    if (PyUnicode_Check(fspath)) {
+        encoded = PyUnicode_EncodeFSDefault(fspath);
+    } else {
+        encoded = fspath;
+        Py_INCREF(encoded);
+    }
+    Py_DECREF(fspath);
+    if (!encoded) {
+        return false;
+    }
+    path.assign(PyBytes_AS_STRING(encoded), PyBytes_GET_SIZE(encoded));
+    Py_DECREF(encoded);
+    return true;
+}
+
+// accept a path, any buffer-protocol object holding a whole FLAC stream, or a
+// (path, offset, length) tuple addressing a stream inside a larger file
+static bool parse_source(PyObject* obj, FLACSource& source) {
+    if (PyTuple_Check(obj)) {
+        PyObject* path_obj;
+        unsigned long long offset, length;
+        if (!PyArg_ParseTuple(obj, "OKK", &path_obj, &offset, &length)) {
+            PyErr_SetString(PyExc_TypeError, "source tuples must be (path, offset, length)");
+            return false;
+        }
+        source.window = true;
+        source.offset = offset;
+        source.length = length;
+        return parse_path(path_obj, source.path);
+    }
+    
+    if (!PyUnicode_Check(obj) && PyObject_CheckBuffer(obj)) {
+        return PyObject_GetBuffer(obj, &source.view, PyBUF_SIMPLE) == 0;
+    }
+    
+    if (!parse_path(obj, source.path)) {
+        PyErr_SetString(PyExc_TypeError, "source must be a path, a bytes-like object or a (path, offset, length) tuple");
+        return false;
+    }
+    return true;
+}
+
+// accept an index array from build_index or the path of an index sidecar
+static bool parse_index(PyObject* obj, FrameIndex& index) {
+    if (PyUnicode_Check(obj) || PyBytes_Check(obj) || PyObject_HasAttrString(obj, "__fspath__")) {
+        std::string path;
+        if (!parse_path(obj, path)) {
+            return false;
+        }
+        std::string error;
+        bool ok;
+        Py_BEGIN_ALLOW_THREADS
+        ok = read_index_file(path, index.storage, index.fingerprint, error);
+        Py_END_ALLOW_THREADS
+        if (!ok) {
+            PyErr_SetString(PyExc_ValueError, error.c_str());
+            return false;
+        }
+        index.has_fingerprint = true;
+        index.entries = index.storage.data();
+        index.count = index.storage.size() / 2;
+        return true;
+    }
+    
+    index.array = PyArray_FROM_OTF(obj, NPY_UINT64, NPY_ARRAY_IN_ARRAY);
+    if (!index.array) {
+        return false;
+    }
+    PyArrayObject* array = reinterpret_cast<PyArrayObject*>(index.array);
+    if (PyArray_NDIM(array) != 2 || PyArray_DIM(array, 1) != 2) {
+        PyErr_SetString(PyExc_ValueError, "index must be an (N, 2) array of (first sample, byte offset) rows");
+        return false;
+    }
+    index.entries = static_cast<const uint64_t*>(PyArray_DATA(array));
+    index.count = static_cast<size_t>(PyArray_DIM(array, 0));
+    return true;
+}
+
+// accept int16, int32, float32 or float64 in any form np.dtype understands, None means int32
+static bool parse_dtype(PyObject* obj, SampleFormat& format) {
+    if (!obj || obj == Py_None) {
+        return true;
+    }
+    PyArray_Descr* descr = NULL;
+    if (!PyArray_DescrConverter2(obj, &descr)) {
+        return false;
+    }
+    int type = descr ? descr->type_num : NPY_INT32;
+    bool native = !descr || PyArray_ISNBO(descr->byteorder);
+    Py_XDECREF(descr);
+    if (!native || (type != NPY_INT16 && type != NPY_INT32 && type != NPY_FLOAT32 && type != NPY_FLOAT64)) {
+        PyErr_SetString(PyExc_ValueError, "dtype must be int16, int32, float32 or float64");
+        return false;
+    }
+    format.type = type;
+    return true;
+}
+
+// channels=None or a sequence of stream channel numbers, downmix=None or "mono"
+static bool parse_channel_selection(PyObject* channels_obj, PyObject* downmix_obj, SampleFormat& format) {
+    if (channels_obj && channels_obj != Py_None) {
+        PyObject* seq = PySequence_Fast(channels_obj, "channels must be a sequence of channel numbers");
+        if (!seq) {
+            return false;
+        }
+        Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+        if (count == 0 || count > FLAC__MAX_CHANNELS) {
+            Py_DECREF(seq);
+            PyErr_Format(PyExc_ValueError, "channels must select between 1 and %d channels", FLAC__MAX_CHANNELS);
+            return false;
+        }
+        for (Py_ssize_t i = 0; i < count; i++) {
+            long channel = PyLong_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+            if (channel == -1 && PyErr_Occurred()) {
+                Py_DECREF(seq);
+                return false;
+            }
+            if (channel < 0) {
+                Py_DECREF(seq);
+                PyErr_SetString(PyExc_ValueError, "channel numbers can't be negative");
+                return false;
+            }
+            format.channel_map.push_back(static_cast<unsigned>(channel));
+        }
+        Py_DECREF(seq);
+    }
+    
+    if (downmix_obj && downmix_obj != Py_None) {
+        if (!PyUnicode_Check(downmix_obj) || PyUnicode_CompareWithASCIIString(downmix_obj, "mono") != 0) {
+            PyErr_SetString(PyExc_ValueError, "downmix must be None or \"mono\"");
+            return false;
+        }
+        format.downmix = true;
+    }
+    return true;
+}
+
+// {name: count} for every counter of a set of stats, zeroing them on the way if asked to
+template <typename Stats>
+static PyObject* stats_to_dict(Stats& stats, bool reset = false) {
+    PyObject* dict = PyDict_New();
+    if (!dict) {
+        return NULL;
+    }
+    for (const StatsField<Stats>& field : Stats::fields) {
+        StatsCounter& counter = stats.*field.counter;
+        uint64_t value = reset ? counter.exchange(0, std::memory_order_relaxed) : counter.load(std::memory_order_relaxed);
+        if (dict_set_new(dict, field.name, PyLong_FromUnsignedLongLong(value)) < 0) {
+            Py_DECREF(dict);
+            return NULL;
+        }
+    }
+    return dict;
+}
+
+// load a FLAC file with optional offset and length
+// the arguments of one load, parsed with the GIL and decoded without it
+struct LoadRequest {
+    FLACSource source;
+    FrameIndex index;
+    bool has_index = false;
+    uint64_t start_sample = 0;
+    uint64_t num_samples = 0;
+    bool metadata_only = false;
+    size_t num_threads = 1;
+    DecodedAudio decoded;
+    Py_buffer out = {};             // caller memory decoded into, see parse_out
+    uint64_t out_offset = 0;
+
+    LoadRequest() = default;
+    LoadRequest(const LoadRequest&) = delete;
+    LoadRequest& operator=(const LoadRequest&) = delete;
+    ~LoadRequest() {
+        if (out.obj) {
+            PyBuffer_Release(&out);
+        }
+    }
+
+    // must be called without the GIL
+    bool decode() {
+        return decode_source(source, start_sample, num_samples, metadata_only, decoded, has_index ? &index : nullptr,
+                             num_threads);
+    }
+
+    // the dict load returns, where audio decoded into out is a view of the frames written
+    PyObject* build_result() {
+        if (out.obj && !metadata_only) {
+            PyObject* array = PyArray_FROM_O(out.obj);
+            decoded.audio = array ? PySequence_GetSlice(array, static_cast<Py_ssize_t>(out_offset),
+                                                        static_cast<Py_ssize_t>(out_offset + decoded.samples_written)) : NULL;
+            Py_XDECREF(array);
+            if (!decoded.audio) {
+                free_metadata_blocks(decoded.metadata_blocks);
+                return NULL;
+            }
+        }
+        PyObject* result = build_load_result(decoded, metadata_only);
+        if (result && decoded.collect_stats && dict_set_new(result, "stats", stats_to_dict(decoded.stats)) < 0) {
+            Py_CLEAR(result);
+        }
+        return result;
+    }
+};
+
+// NumPy type of a buffer's items, or -1 if they aren't samples we can decode to
+static int buffer_sample_type(const Py_buffer& view) {
+    const char* format = view.format ? view.format : "B";
+    if (*format == '@' || *format == '=' || (PY_LITTLE_ENDIAN && *format == '<')) {
+        format++;
+    }
+    if (format[0] == 0 || format[1] != 0) {
+        return -1;
+    }
+    switch (format[0]) {
+        case 'h':
+            return view.itemsize == 2 ? NPY_INT16 : -1;
+        case 'i':
+        case 'l':
+            return view.itemsize == 4 ? NPY_INT32 : -1;
+        case 'f':
+            return view.itemsize == 4 ? NPY_FLOAT32 : -1;
+        case 'd':
+            return view.itemsize == 8 ? NPY_FLOAT64 : -1;
+        default:
+            return -1;
+    }
+}
+
+// decode into a writable (frames x channels) buffer, or (frames,) for a single output channel,
+// starting at frame out_offset. the dtype comes from the buffer unless one was asked for, and
+// any strides are written in place, so a view into a larger batch array is filled directly
+static bool parse_out(PyObject* out_obj, uint64_t out_offset, bool dtype_given, LoadRequest& request) {
+    Py_buffer& view = request.out;
+    if (PyObject_GetBuffer(out_obj, &view, PyBUF_RECORDS) < 0) {
+        return false;
+    }
+    
+    SampleFormat& format = request.decoded.format;
+    const int type = buffer_sample_type(view);
+    if (type < 0) {
+        PyErr_SetString(PyExc_TypeError, "out must hold int16, int32, float32 or float64 samples");
+        return false;
+    }
+    if (dtype_given && type != format.type) {
+        PyErr_SetString(PyExc_TypeError, "out doesn't hold the requested dtype");
+        return false;
+    }
+    format.type = type;
+    
+    if (view.ndim != 1 && view.ndim != 2) {
+        PyErr_SetString(PyExc_ValueError, "out must have shape (frames, channels) or (frames,)");
+        return false;
+    }
+    const Py_ssize_t frames = view.shape[0];
+    const Py_ssize_t channels = view.ndim == 2 ? view.shape[1] : 1;
+    if (out_offset > static_cast<uint64_t>(frames)) {
+        PyErr_SetString(PyExc_ValueError, "out_offset is past the end of out");
+        return false;
+    }
+    
+    const Py_ssize_t itemsize = view.itemsize;
+    Py_ssize_t frame_stride = view.strides[0];
+    Py_ssize_t channel_stride = view.ndim == 2 ? view.strides[1] : itemsize;
+    if (frame_stride % itemsize != 0 || channel_stride % itemsize != 0 ||
+        reinterpret_cast<uintptr_t>(view.buf) % itemsize != 0) {
+        PyErr_SetString(PyExc_ValueError, "out must be aligned to its item size");
+        return false;
+    }
+    // the stride of a dimension of length 1 is meaningless, pick the one that keeps frames interleaved
+    if (channels == 1) {
+        channel_stride = itemsize;
+    }
+    if (frames == 1) {
+        frame_stride = channels * channel_stride;
+    }
+    // every sample needs its own element, so either each frame's channels fit between one frame
+    // and the next (interleaved) or each channel's frames fit between one channel and the next (planar)
+    const Py_ssize_t frame_step = frame_stride < 0 ? -frame_stride : frame_stride;
+    const Py_ssize_t channel_step = channel_stride < 0 ? -channel_stride : channel_stride;
+    if (frame_step == 0 || (channels > 1 && channel_step == 0) ||
+        (frame_step < channels * channel_step && channel_step < frames * frame_step)) {
+        PyErr_SetString(PyExc_ValueError, "out can't have overlapping frames or channels");
+        return false;
+    }
+    format.frame_stride = frame_stride / itemsize;
+    format.channel_stride = channel_stride / itemsize;
+    format.strided = format.channel_stride != 1 || format.frame_stride != channels;
+    
+    request.out_offset = out_offset;
+    request.decoded.output = static_cast<uint8_t*>(view.buf) + static_cast<Py_ssize_t>(out_offset) * frame_stride;
+    request.decoded.output_capacity = static_cast<uint64_t>(frames) - out_offset;
+    request.decoded.output_channels = static_cast<unsigned>(channels);
+    return true;
+}
+
+// parse the arguments shared by load and load_async, timeout_obj is only taken by the latter
+static bool parse_load_request(PyObject* args, PyObject* kwargs, LoadRequest& request, PyObject** timeout_obj) {
+    PyObject* source_obj;
+    int metadata_only = 0;
+    PyObject* index_obj = NULL;
+    PyObject* dtype_obj = NULL;
+    int normalize = 0;
+    int threads = 1;  // 0 means one per core
+    PyObject* channels_obj = NULL;
+    PyObject* downmix_obj = NULL;
+    PyObject* out_obj = NULL;
+    uint64_t out_offset = 0;
+    int return_stats = 0;
+    
+    // the keyword list can't be longer than the format, so load gets its own without timeout
+    static const char* kwlist[] = {"filename", "start_sample", "num_samples", "metadata_only", "index", "dtype", "normalize", "threads",
+                                   "channels", "downmix", "out", "out_offset", "return_stats", NULL};
+    static const char* async_kwlist[] = {"filename", "start_sample", "num_samples", "metadata_only", "index", "dtype", "normalize",
+                                         "threads", "channels", "downmix", "out", "out_offset", "return_stats", "timeout", NULL};
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, timeout_obj ? "O|KKpOOpiOOOKpO" : "O|KKpOOpiOOOKp",
+                                   const_cast<char**>(timeout_obj ? async_kwlist : kwlist),
+                                   &source_obj, &request.start_sample, &request.num_samples, &metadata_only, &index_obj,
+                                   &dtype_obj, &normalize, &threads, &channels_obj, &downmix_obj, &out_obj, &out_offset,
+                                   &return_stats, timeout_obj)) {
+        return false;
+    }
+    request.decoded.collect_stats = return_stats != 0;
+    
+    if (!parse_dtype(dtype_obj, request.decoded.format) ||
+        !parse_channel_selection(channels_obj, downmix_obj, request.decoded.format)) {
+        return false;
+    }
+    if (out_obj && out_obj != Py_None && !metadata_only &&
+        !parse_out(out_obj, out_offset, dtype_obj && dtype_obj != Py_None, request)) {
+        return false;
+    }
+    request.decoded.format.normalize = normalize != 0;
+    request.metadata_only = metadata_only != 0;
+    request.num_threads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    
+    if (!parse_source(source_obj, request.source)) {
+        return false;
+    }
+    
+    request.has_index = index_obj && index_obj != Py_None;
+    return !request.has_index || parse_index(index_obj, request.index);
+}
+
+// decode a parsed request and build the dict load returns
+static PyObject* run_load_request(LoadRequest& request) {
+    // file i/o, metadata parsing and decoding all run without the GIL
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = request.decode();
+    Py_END_ALLOW_THREADS
+    
+    if (!ok) {
+        PyErr_SetString(PyExc_RuntimeError, request.decoded.error.c_str());
+        return NULL;
+    }
+    
+    return request.build_result();
+}
+
+PyObject* flacpy_load(PyObject* self, PyObject* args, PyObject* kwargs) {
+    LoadRequest request;
+    if (!parse_load_request(args, kwargs, request, nullptr)) {
+        return NULL;
+    }
+    return run_load_request(request);
+}
+
+// module-wide load and save stats, optionally zeroing them or turning collection on or off.
+// loads with return_stats=True are always counted, everything else only while enabled
+PyObject* flacpy_stats(PyObject* self, PyObject* args, PyObject* kwargs) {
+    int reset = 0;
+    PyObject* enable_obj = NULL;
+    static const char* kwlist[] = {"reset", "enable", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|pO", const_cast<char**>(kwlist), &reset, &enable_obj)) {
+        return NULL;
+    }
+    
+    if (enable_obj && enable_obj != Py_None) {
+        int enable = PyObject_IsTrue(enable_obj);
+        if (enable < 0) {
+            return NULL;
+        }
+        stats_enabled().store(enable != 0, std::memory_order_relaxed);
+    }
+    
+    PyObject* result = PyDict_New();
+    if (!result) {
+        return NULL;
+    }
+    if (dict_set_new(result, "enabled", PyBool_FromLong(stats_enabled().load(std::memory_order_relaxed))) < 0 ||
+        dict_set_new(result, "load", stats_to_dict(load_stats_totals(), reset != 0)) < 0 ||
+        dict_set_new(result, "save", stats_to_dict(save_stats_totals(), reset != 0)) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+static PyObject* FLACDecoderPool_new(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+    int max_decoders = 0;  // 0 means one per core
+    Py_ssize_t max_idle_bytes = Py_ssize_t(256) << 20;
+    
+    static const char* kwlist[] = {"max_decoders", "max_idle_bytes", NULL};
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|in", const_cast<char**>(kwlist), &max_decoders, &max_idle_bytes)) {
+        return NULL;
+    }
+    if (max_decoders < 0 || max_idle_bytes < 0) {
+        PyErr_SetString(PyExc_ValueError, "max_decoders and max_idle_bytes must be non-negative");
+        return NULL;
+    }
+    
+    FLACDecoderPoolObject* self = reinterpret_cast<FLACDecoderPoolObject*>(type->tp_alloc(type, 0));
+    if (!self) {
+        return NULL;
+    }
+    self->pool = new std::shared_ptr<DecoderPool>(std::make_shared<DecoderPool>(
+        max_decoders > 0 ? max_decoders : std::max(1u, std::thread::hardware_concurrency()),
+        static_cast<size_t>(max_idle_bytes)));
+    return reinterpret_cast<PyObject*>(self);
+}
+
+static void FLACDecoderPool_dealloc(FLACDecoderPoolObject* self) {
+    // arrays still out keep the pool itself alive until they're freed
+    delete self->pool;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+// load(filename, ...), takes the same arguments as flacpy.load
+static PyObject* FLACDecoderPool_load(FLACDecoderPoolObject* self, PyObject* args, PyObject* kwargs) {
+    LoadRequest request;
+    if (!parse_load_request(args, kwargs, request, nullptr)) {
+        return NULL;
+    }
+    request.decoded.pool = self->pool->get();
+    return run_load_request(request);
+}
+
+static PyObject* FLACDecoderPool_get_idle_decoders(FLACDecoderPoolObject* self, void* closure) {
+    return PyLong_FromSize_t((*self->pool)->idle_decoders());
+}
+
+static PyObject* FLACDecoderPool_get_idle_bytes(FLACDecoderPoolObject* self, void* closure) {
+    return PyLong_FromSize_t((*self->pool)->idle_bytes());
+}
+
+static PyMethodDef FLACDecoderPool_methods[] = {
+    {"load", (PyCFunction)FLACDecoderPool_load, METH_VARARGS | METH_KEYWORDS,
+     "Load a FLAC file like flacpy.load, with a pooled decoder and output array"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef FLACDecoderPool_getset[] = {
+    {"idle_decoders", (getter)FLACDecoderPool_get_idle_decoders, NULL, "Decoders waiting to be reused", NULL},
+    {"idle_bytes", (getter)FLACDecoderPool_get_idle_bytes, NULL, "Output memory waiting to be reused", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+PyTypeObject FLACDecoderPoolType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "flacpy.DecoderPool",         /* tp_name */
+    sizeof(FLACDecoderPoolObject), /* tp_basicsize */
+    0,                            /* tp_itemsize */
+    (destructor)FLACDecoderPool_dealloc, /* tp_dealloc */
+    0,                            /* tp_print */
+    0,                            /* tp_getattr */
+    0,                            /* tp_setattr */
+    0,                            /* tp_compare */
+    0,                            /* tp_repr */
+    0,                            /* tp_as_number */
+    0,                            /* tp_as_sequence */
+    0,                            /* tp_as_mapping */
+    0,                            /* tp_hash */
+    0,                            /* tp_call */
+    0,                            /* tp_str */
+    0,                            /* tp_getattro */
+    0,                            /* tp_setattro */
+    0,                            /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,           /* tp_flags */
+    "Decoders and output memory reused across loads", /* tp_doc */
+    0,                            /* tp_traverse */
+    0,                            /* tp_clear */
+    0,                            /* tp_richcompare */
+    0,                            /* tp_weaklistoffset */
+    0,                            /* tp_iter */
+    0,                            /* tp_iternext */
+    FLACDecoderPool_methods,      /* tp_methods */
+    0,                            /* tp_members */
+    FLACDecoderPool_getset,       /* tp_getset */
+    0,                            /* tp_base */
+    0,                            /* tp_dict */
+    0,                            /* tp_descr_get */
+    0,                            /* tp_descr_set */
+    0,                            /* tp_dictoffset */
+    0,                            /* tp_init */
+    0,                            /* tp_alloc */
+    FLACDecoderPool_new,          /* tp_new */
+};
+
+// load_async calls beyond this many waiting for a worker are refused
+static const size_t async_load_max_waiting = 1024;
+
+// async loads decode on the shared pool, leaving one of its workers free so that a burst of them
+// never stalls parallel_for in threaded loads, load_many and threaded saves
+static BoundedTaskQueue& get_async_load_queue() {
+    static BoundedTaskQueue* queue = new BoundedTaskQueue(get_thread_pool(), std::max<size_t>(1, get_thread_pool().size() - 1),
+                                                          async_load_max_waiting);
+    return *queue;
+}
+
+// true once the interpreter is shutting down, after which pool workers must not take the GIL
+static bool interpreter_finalizing() {
+#if PY_VERSION_HEX >= 0x030D0000
+    return Py_IsFinalizing() != 0;
+#else
+    return _Py_IsFinalizing() != 0;
+#endif
+}
+
+// one load_async call. the worker fills in result or exception and then asks the event loop to
+// run deliver, which hands them to the future. every reference is dropped with the GIL held
+struct AsyncLoad {
+    LoadRequest request;
+    DecodeControl control;
+    PyObject* loop = nullptr;
+    PyObject* future = nullptr;
+    PyObject* timer = nullptr;      // loop handle that fails the future once the timeout is up
+    PyObject* result = nullptr;
+    PyObject* exception = nullptr;
+
+    void release() {
+        Py_CLEAR(loop);
+        Py_CLEAR(future);
+        Py_CLEAR(timer);
+        Py_CLEAR(result);
+        Py_CLEAR(exception);
+    }
+    ~AsyncLoad() { release(); }
+};
+
+// owner of an AsyncLoad, its methods are the callbacks given to the event loop and the future
+typedef struct {
+    PyObject_HEAD
+    AsyncLoad* load;
+} FLACAsyncLoadObject;
+
+static void FLACAsyncLoad_dealloc(FLACAsyncLoadObject* self) {
+    delete self->load;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+// done callback of the future, a cancelled future stops the decode at the next frame
+static PyObject* FLACAsyncLoad_on_done(FLACAsyncLoadObject* self, PyObject* future) {
+    PyObject* cancelled = PyObject_CallMethod(future, "cancelled", NULL);
+    if (!cancelled) {
+        return NULL;
+    }
+    int is_cancelled = PyObject_IsTrue(cancelled);
+    Py_DECREF(cancelled);
+    if (is_cancelled < 0) {
+        return NULL;
+    }
+    if (is_cancelled) {
+        self->load->control.cancelled = true;
+    }
+    Py_RETURN_NONE;
+}
+
+// timer callback, fails the future with TimeoutError even while the load is still waiting for a
+// worker. the decode itself stops at its deadline
+static PyObject* FLACAsyncLoad_expire(FLACAsyncLoadObject* self, PyObject* Py_UNUSED(ignored)) {
+    AsyncLoad& load = *self->load;
+    if (!load.future) {
+        Py_RETURN_NONE;
+    }
+    load.control.cancelled = true;
+    PyObject* done = PyObject_CallMethod(load.future, "done", NULL);
+    int is_done = done ? PyObject_IsTrue(done) : -1;
+    Py_XDECREF(done);
+    if (is_done < 0) {
+        return NULL;
+    }
+    if (!is_done) {
+        PyObject* error = PyObject_CallFunction(PyExc_TimeoutError, "s", "Load timed out");
+        PyObject* status = error ? PyObject_CallMethod(load.future, "set_exception", "O", error) : NULL;
+        Py_XDECREF(error);
+        if (!status) {
+            return NULL;
+        }
+        Py_DECREF(status);
+    }
+    Py_RETURN_NONE;
+}
+
+// runs on the event loop once the worker is done, a future that was cancelled meanwhile is left alone
+static PyObject* FLACAsyncLoad_deliver(FLACAsyncLoadObject* self, PyObject* Py_UNUSED(ignored)) {
+    AsyncLoad& load = *self->load;
+    if (load.timer) {
+        PyObject* cancelled = PyObject_CallMethod(load.timer, "cancel", NULL);
+        if (!cancelled) {
+            PyErr_Clear();
+        }
+        Py_XDECREF(cancelled);
+    }
+    PyObject* done = PyObject_CallMethod(load.future, "done", NULL);
+    int is_done = done ? PyObject_IsTrue(done) : -1;
+    Py_XDECREF(done);
+    
+    PyObject* status = NULL;
+    if (is_done == 0 && load.result) {
+        status = PyObject_CallMethod(load.future, "set_result", "O", load.result);
+    } else if (is_done == 0 && load.exception) {
+        status = PyObject_CallMethod(load.future, "set_exception", "O", load.exception);
+    } else if (is_done == 0) {
+        status = PyObject_CallMethod(load.future, "cancel", NULL);
+    } else if (is_done > 0) {
+        status = Py_None;
+        Py_INCREF(status);
+    }
+    load.release();
+    
+    if (!status) {
+        return NULL;
+    }
+    Py_DECREF(status);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef FLACAsyncLoad_methods[] = {
+    {"_on_done", (PyCFunction)FLACAsyncLoad_on_done, METH_O, "Stop the decode if the future was cancelled"},
+    {"_expire", (PyCFunction)FLACAsyncLoad_expire, METH_NOARGS, "Fail the future once the timeout is up"},
+    {"_deliver", (PyCFunction)FLACAsyncLoad_deliver, METH_NOARGS, "Hand the result to the future"},
+    {NULL}
+};
+
+PyTypeObject FLACAsyncLoadType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "flacpy._AsyncLoad",          /* tp_name */
+    sizeof(FLACAsyncLoadObject),  /* tp_basicsize */
+    0,                            /* tp_itemsize */
+    (destructor)FLACAsyncLoad_dealloc, /* tp_dealloc */
+    0,                            /* tp_print */
+    0,                            /* tp_getattr */
+    0,                            /* tp_setattr */
+    0,                            /* tp_compare */
+    0,                            /* tp_repr */
+    0,                            /* tp_as_number */
+    0,                            /* tp_as_sequence */
+    0,                            /* tp_as_mapping */
+    0,                            /* tp_hash */
+    0,                            /* tp_call */
+    0,                            /* tp_str */
+    0,                            /* tp_getattro */
+    0,                            /* tp_setattro */
+    0,                            /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,           /* tp_flags */
+    "Pending load_async call",    /* tp_doc */
+    0,                            /* tp_traverse */
+    0,                            /* tp_clear */
+    0,                            /* tp_richcompare */
+    0,                            /* tp_weaklistoffset */
+    0,                            /* tp_iter */
+    0,                            /* tp_iternext */
+    FLACAsyncLoad_methods,        /* tp_methods */
+};
+
+// the exception being raised, taken out of the error indicator
+static PyObject* take_exception() {
+#if PY_VERSION_HEX >= 0x030C0000
+    return PyErr_GetRaisedException();
+#else
+    PyObject *type, *value, *traceback;
+    PyErr_Fetch(&type, &value, &traceback);
+    PyErr_NormalizeException(&type, &value, &traceback);
+    if (traceback && value) {
+        PyException_SetTraceback(value, traceback);
+    }
+    Py_XDECREF(type);
+    Py_XDECREF(traceback);
+    return value;
+#endif
+}
+
+// body of a pool task, decodes without the GIL and then schedules delivery on the event loop.
+// consumes the reference to handle taken when the task was submitted
+static void run_async_load(FLACAsyncLoadObject* handle) {
+    // during shutdown the loop is gone and taking the GIL would hang the worker, so the load
+    // is abandoned along with its references
+    if (interpreter_finalizing()) {
+        return;
+    }
+    AsyncLoad& load = *handle->load;
+    const bool ok = !load.control.stopped() && load.request.decode();
+    if (interpreter_finalizing()) {
+        return;
+    }
+    
+    ScopedGIL gil;
+    if (ok) {
+        load.result = load.request.build_result();
+        if (!load.result) {
+            load.exception = take_exception();
+        }
+    } else if (load.control.timed_out()) {
+        load.exception = PyObject_CallFunction(PyExc_TimeoutError, "s", "Load timed out");
+    } else if (!load.control.cancelled) {
+        load.exception = PyObject_CallFunction(PyExc_RuntimeError, "s", load.request.decoded.error.c_str());
+    }
+    
+    // the loop may be closed by now, in which case nobody is waiting for the result
+    PyObject* deliver = PyObject_GetAttrString(reinterpret_cast<PyObject*>(handle), "_deliver");
+    PyObject* scheduled = deliver ? PyObject_CallMethod(load.loop, "call_soon_threadsafe", "O", deliver) : NULL;
+    Py_XDECREF(deliver);
+    if (!scheduled) {
+        PyErr_Clear();
+        load.release();
+    }
+    Py_XDECREF(scheduled);
+    Py_DECREF(handle);
+}
+
+PyObject* flacpy_load_async(PyObject* self, PyObject* args, PyObject* kwargs) {
+    FLACAsyncLoadObject* handle = PyObject_New(FLACAsyncLoadObject, &FLACAsyncLoadType);
+    if (!handle) {
+        return NULL;
+    }
+    handle->load = new AsyncLoad();
+    AsyncLoad& load = *handle->load;
+    PyObject* handle_obj = reinterpret_cast<PyObject*>(handle);
+    
+    PyObject* timeout_obj = NULL;
+    if (!parse_load_request(args, kwargs, load.request, &timeout_obj)) {
+        Py_DECREF(handle);
+        return NULL;
+    }
+    double timeout = -1.0;
+    if (timeout_obj && timeout_obj != Py_None) {
+        timeout = PyFloat_AsDouble(timeout_obj);
+        if (timeout == -1.0 && PyErr_Occurred()) {
+            Py_DECREF(handle);
+            return NULL;
+        }
+        if (!(timeout >= 0.0)) {
+            PyErr_SetString(PyExc_ValueError, "timeout must be non-negative");
+            Py_DECREF(handle);
+            return NULL;
+        }
+        // counted from now, so time spent waiting for a worker is included
+        load.control.deadline = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(std::min(timeout, 1e9)));
+    }
+    load.request.decoded.control = &load.control;
+    
+    PyObject* asyncio = PyImport_ImportModule("asyncio");
+    if (asyncio) {
+        load.loop = PyObject_CallMethod(asyncio, "get_running_loop", NULL);
+        Py_DECREF(asyncio);
+    }
+    if (load.loop) {
+        load.future = PyObject_CallMethod(load.loop, "create_future", NULL);
+    }
+    PyObject* on_done = load.future ? PyObject_GetAttrString(handle_obj, "_on_done") : NULL;
+    PyObject* added = on_done ? PyObject_CallMethod(load.future, "add_done_callback", "O", on_done) : NULL;
+    Py_XDECREF(on_done);
+    if (added && timeout >= 0.0) {
+        PyObject* expire = PyObject_GetAttrString(handle_obj, "_expire");
+        load.timer = expire ? PyObject_CallMethod(load.loop, "call_later", "dO", timeout, expire) : NULL;
+        Py_XDECREF(expire);
+        if (!load.timer) {
+            Py_CLEAR(added);
+        }
+    }
+    if (!added) {
+        load.release();
+        Py_DECREF(handle);
+        return NULL;
+    }
+    Py_DECREF(added);
+    
+    // the pool task keeps the handle, and with it the request, alive until it is done
+    Py_INCREF(handle);
+    if (!get_async_load_queue().submit([handle] { run_async_load(handle); })) {
+        Py_DECREF(handle);
+        load.release();
+        Py_DECREF(handle);
+        PyErr_SetString(PyExc_RuntimeError, "Too many load_async calls are already waiting");
+        return NULL;
+    }
+    
+    PyObject* future = load.future;
+    Py_INCREF(future);
+    Py_DECREF(handle);
+    return future;
+}
+
+// an open stream for repeated reads, owned by a FLACAudio object. the decoder, the parsed
+// metadata and the rest of the last decoded frame all stay alive between reads, so reading on
+// from where the previous read stopped never seeks, aborts or re-parses anything
+class FLACReader {
+public:
+    FLACSource source;  // declared first so the decoder is torn down before its input
+    PartialFLACDecoder decoder;
+    std::vector<FLAC__StreamMetadata*> metadata_blocks;
+    std::vector<int32_t> carry;  // interleaved samples that end at decoder.get_current_sample()
+    uint64_t position = 0;       // where read continues when no start is given
+    unsigned channels = 0;
+    unsigned sample_rate = 0;
+    unsigned bits_per_sample = 0;
+    uint64_t total_samples = 0;
+    bool closed = false;
+    std::mutex mutex;            // guards the decoder, carry, position and closed. reads run without the GIL, one at a time
+
+    ~FLACReader() { free_metadata_blocks(metadata_blocks); }
+
+    // initialize the decoder and read every metadata block, called without the GIL
+    bool open(std::string& error) {
+        decoder.set_metadata_respond_all();
+        decoder.set_carry(&carry);
+        FLAC__StreamDecoderInitStatus init_status = decoder.init(source);
+        if (init_status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+            error = std::string("Failed to initialize FLAC decoder: ") + FLAC__StreamDecoderInitStatusString[init_status];
+            return false;
+        }
+        decoder.process_until_end_of_metadata();
+        metadata_blocks.swap(decoder.metadata_blocks);
+        channels = decoder.get_channels();
+        sample_rate = decoder.get_sample_rate();
+        bits_per_sample = decoder.get_bits_per_sample();
+        total_samples = decoder.get_total_samples();
+        if (channels == 0) {
+            error = "Not a FLAC stream, no STREAMINFO found";
+            return false;
+        }
+        return true;
+    }
+
+    // read count samples from start, or from position without one (0 = to the end) into a new
+    // array, called without the GIL
+    bool read(const uint64_t* start_sample, uint64_t count, DecodedAudio& decoded) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed) {
+            decoded.error = "I/O operation on a closed FLACAudio";
+            return false;
+        }
+        const uint64_t start = start_sample ? *start_sample : position;
+        
+        // streams of unknown length read to the end go through a growable buffer
+        uint64_t length = count;
+        const bool known_length = total_samples > 0 || count > 0;
+        if (total_samples > 0) {
+            uint64_t remaining = start < total_samples ? total_samples - start : 0;
+            length = count == 0 ? remaining : std::min(count, remaining);
+        }
+        
+        npy_intp dims[2] = {static_cast<npy_intp>(known_length ? length : 0), static_cast<npy_intp>(channels)};
+        // a chunk iterator's decoder thread can outlive the interpreter, and taking the GIL
+        // during shutdown would hang it
+        if (interpreter_finalizing()) {
+            decoded.error = "Interpreter is shutting down";
+            return false;
+        }
+        {
+            ScopedGIL gil;
+            decoded.audio = PyArray_SimpleNew(2, dims, NPY_INT32);
+            if (!decoded.audio) {
+                PyErr_Clear();
+            }
+        }
+        if (!decoded.audio) {
+            decoded.error = "Failed to allocate the output array";
+            return false;
+        }
+        int32_t* output = static_cast<int32_t*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(decoded.audio)));
+        std::vector<int32_t> buffer;
+        uint64_t written = 0;
+        
+        // start with whatever the previous read left over of its last frame
+        const uint64_t carry_samples = carry.size() / channels;
+        const uint64_t carry_start = decoder.get_current_sample() - carry_samples;
+        if (start >= carry_start && start < carry_start + carry_samples) {
+            uint64_t skip = start - carry_start;
+            written = carry_samples - skip;
+            if (known_length) {
+                written = std::min(written, length);
+                std::copy(carry.begin() + skip * channels, carry.begin() + (skip + written) * channels, output);
+            } else {
+                buffer.assign(carry.begin() + skip * channels, carry.end());
+            }
+        }
+        
+        bool ok = true;
+        if (!known_length || written < length) {
+            const uint64_t next = start + written;
+            decoder.set_range(next, known_length ? length - written : 0);
+            if (known_length) {
+                decoder.set_buffer(nullptr);
+                decoder.set_output(output + written * channels, length - written);
+            } else {
+                decoder.set_output(nullptr, 0);
+                decoder.set_buffer(&buffer);
+            }
+            
+            // only jump when the read doesn't continue from the last decoded frame, seeking
+            // delivers the frame holding the target sample straight to the write callback
+            if (next != decoder.get_current_sample()) {
+                carry.clear();
+                if (!decoder.seek_absolute(next)) {
+                    decoder.flush();
+                    decoded.error = "Failed to seek to sample " + std::to_string(next);
+                    ok = false;
+                }
+            }
+            
+            while (ok && (!known_length || decoder.get_samples_written() < length - written)) {
+                if (decoder.get_state() == FLAC__STREAM_DECODER_END_OF_STREAM) {
+                    break;
+                }
+                if (!decoder.process_single()) {
+                    decoded.error = std::string("Failed to decode: ") + decoder.get_state().as_cstring();
+                    ok = false;
+                }
+            }
+            written += decoder.get_samples_written();
+            decoder.set_output(nullptr, 0);
+            decoder.set_buffer(nullptr);
+        }
+        if (interpreter_finalizing()) {
+            // the array is abandoned along with the interpreter
+            decoded.audio = nullptr;
+            decoded.error = "Interpreter is shutting down";
+            return false;
+        }
+        
+        if (ok && static_cast<npy_intp>(written) != dims[0]) {
+            ScopedGIL gil;
+            dims[0] = static_cast<npy_intp>(written);
+            PyArray_Dims new_shape = {dims, 2};
+            PyObject* resized = PyArray_Resize(reinterpret_cast<PyArrayObject*>(decoded.audio), &new_shape, 0, NPY_CORDER);
+            if (resized) {
+                Py_DECREF(resized);
+            } else {
+                PyErr_Clear();
+                decoded.error = "Failed to resize the output array";
+                ok = false;
+            }
+        }
+        if (ok && !known_length) {
+            std::copy(buffer.begin(), buffer.end(),
+                      static_cast<int32_t*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(decoded.audio))));
+        }
+        if (!ok) {
+            ScopedGIL gil;
+            Py_CLEAR(decoded.audio);
+            return false;
+        }
+        
+        position = start + written;
+        decoded.samples_written = written;
+        return true;
+    }
+
+    // stop decoding and release the input, called without the GIL
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!closed) {
+            decoder.close();
+            carry.clear();
+            closed = true;
+        }
+    }
+};
+
+static PyObject* FLACAudio_new(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+    PyObject* source_obj;
+    static const char* kwlist[] = {"filename", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", const_cast<char**>(kwlist), &source_obj)) {
+        return NULL;
+    }
+    
+    FLACAudioObject* self = reinterpret_cast<FLACAudioObject*>(type->tp_alloc(type, 0));
+    if (!self) {
+        return NULL;
+    }
+    self->reader = new FLACReader();
+    self->metadata = NULL;
+    if (!parse_source(source_obj, self->reader->source)) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    
+    std::string error;
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = self->reader->open(error);
+    Py_END_ALLOW_THREADS
+    if (!ok) {
+        PyErr_SetString(PyExc_RuntimeError, (self->reader->source.describe() + ": " + error).c_str());
+        Py_DECREF(self);
+        return NULL;
+    }
+    return reinterpret_cast<PyObject*>(self);
+}
+
+static void FLACAudio_dealloc(FLACAudioObject* self) {
+    delete self->reader;
+    Py_XDECREF(self->metadata);
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+// read(start_sample=None, num_samples=0), continuing from the current position when no start is given
+static PyObject* FLACAudio_read(FLACAudioObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* start_obj = Py_None;
+    uint64_t num_samples = 0;
+    static const char* kwlist[] = {"start_sample", "num_samples", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OK", const_cast<char**>(kwlist), &start_obj, &num_samples)) {
+        return NULL;
+    }
+    
+    FLACReader* reader = self->reader;
+    uint64_t start_sample = 0;
+    if (start_obj != Py_None) {
+        start_sample = PyLong_AsUnsignedLongLong(start_obj);
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+    
+    DecodedAudio decoded;
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = reader->read(start_obj != Py_None ? &start_sample : nullptr, num_samples, decoded);
+    Py_END_ALLOW_THREADS
+    if (!ok) {
+        bool closed;
+        {
+            std::unique_lock<std::mutex> lock = lock_with_gil(reader->mutex);
+            closed = reader->closed;
+        }
+        PyErr_SetString(closed ? PyExc_ValueError : PyExc_RuntimeError, decoded.error.c_str());
+        return NULL;
+    }
+    return decoded.audio;
+}
+
+static PyObject* FLACAudio_seek(FLACAudioObject* self, PyObject* args) {
+    unsigned long long sample;
+    if (!PyArg_ParseTuple(args, "K", &sample)) {
+        return NULL;
+    }
+    std::unique_lock<std::mutex> lock = lock_with_gil(self->reader->mutex);
+    self->reader->position = sample;
+    return PyLong_FromUnsignedLongLong(sample);
+}
+
+static PyObject* FLACAudio_close(FLACAudioObject* self, PyObject* Py_UNUSED(ignored)) {
+    FLACReader* reader = self->reader;
+    Py_BEGIN_ALLOW_THREADS
+    reader->close();
+    Py_END_ALLOW_THREADS
+    if (reader->source.view.obj) {
+        PyBuffer_Release(&reader->source.view);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* FLACAudio_enter(FLACAudioObject* self, PyObject* Py_UNUSED(ignored)) {
+    Py_INCREF(self);
+    return reinterpret_cast<PyObject*>(self);
+}
+
+static PyObject* FLACAudio_exit(FLACAudioObject* self, PyObject* Py_UNUSED(args)) {
+    return FLACAudio_close(self, NULL);
+}
+
+static PyObject* FLACAudio_get_metadata(FLACAudioObject* self, void* closure) {
+    if (!self->metadata) {
+        self->metadata = metadata_new(self->reader->metadata_blocks);
+        if (!self->metadata) {
+            return NULL;
+        }
+    }
+    Py_INCREF(self->metadata);
+    return self->metadata;
+}
+
+static PyObject* FLACAudio_get_channels(FLACAudioObject* self, void* closure) {
+    return PyLong_FromUnsignedLong(self->reader->channels);
+}
+
+static PyObject* FLACAudio_get_sample_rate(FLACAudioObject* self, void* closure) {
+    return PyLong_FromUnsignedLong(self->reader->sample_rate);
+}
+
+static PyObject* FLACAudio_get_bits_per_sample(FLACAudioObject* self, void* closure) {
+    return PyLong_FromUnsignedLong(self->reader->bits_per_sample);
+}
+
+static PyObject* FLACAudio_get_total_samples(FLACAudioObject* self, void* closure) {
+    return PyLong_FromUnsignedLongLong(self->reader->total_samples);
+}
+
+static PyObject* FLACAudio_get_position(FLACAudioObject* self, void* closure) {
+    std::unique_lock<std::mutex> lock = lock_with_gil(self->reader->mutex);
+    return PyLong_FromUnsignedLongLong(self->reader->position);
+}
+
+static PyObject* FLACAudio_get_closed(FLACAudioObject* self, void* closure) {
+    std::unique_lock<std::mutex> lock = lock_with_gil(self->reader->mutex);
+    return PyBool_FromLong(self->reader->closed);
+}
+
+// FLACAudio type definition
+static PyMethodDef FLACAudio_methods[] = {
+    {"read", (PyCFunction)FLACAudio_read, METH_VARARGS | METH_KEYWORDS,
+     "Read samples from start_sample (default: the current position), num_samples=0 reads to the end"},
+    {"seek", (PyCFunction)FLACAudio_seek, METH_VARARGS,
+     "Set the position the next read starts from"},
+    {"close", (PyCFunction)FLACAudio_close, METH_NOARGS,
+     "Release the decoder and the underlying file"},
+    {"__enter__", (PyCFunction)FLACAudio_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)FLACAudio_exit, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef FLACAudio_getset[] = {
+    {"metadata", (getter)FLACAudio_get_metadata, NULL, "Metadata mapping, as returned by load", NULL},
+    {"channels", (getter)FLACAudio_get_channels, NULL, "Number of channels", NULL},
+    {"sample_rate", (getter)FLACAudio_get_sample_rate, NULL, "Sample rate in Hz", NULL},
+    {"bits_per_sample", (getter)FLACAudio_get_bits_per_sample, NULL, "Bit depth", NULL},
+    {"total_samples", (getter)FLACAudio_get_total_samples, NULL, "Length in samples, 0 if unknown", NULL},
+    {"position", (getter)FLACAudio_get_position, NULL, "Sample the next read starts from", NULL},
+    {"closed", (getter)FLACAudio_get_closed, NULL, "True once close has been called", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+PyTypeObject FLACAudioType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "flacpy.FLACAudio",           /* tp_name */
+    sizeof(FLACAudioObject),      /* tp_basicsize */
+    0,                            /* tp_itemsize */
+    (destructor)FLACAudio_dealloc, /* tp_dealloc */
+    0,                            /* tp_print */
+    0,                            /* tp_getattr */
+    0,                            /* tp_setattr */
+    0,                            /* tp_compare */
+    0,                            /* tp_repr */
+    0,                            /* tp_as_number */
+    0,                            /* tp_as_sequence */
+    0,                            /* tp_as_mapping */
+    0,                            /* tp_hash */
+    0,                            /* tp_call */
+    0,                            /* tp_str */
+    0,                            /* tp_getattro */
+    0,                            /* tp_setattro */
+    0,                            /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,           /* tp_flags */
+    "Open FLAC stream for repeated reads, see flacpy.open", /* tp_doc */
+    0,                            /* tp_traverse */
+    0,                            /* tp_clear */
+    0,                            /* tp_richcompare */
+    0,                            /* tp_weaklistoffset */
+    0,                            /* tp_iter */
+    0,                            /* tp_iternext */
+    FLACAudio_methods,            /* tp_methods */
+    0,                            /* tp_members */
+    FLACAudio_getset,             /* tp_getset */
+    0,                            /* tp_base */
+    0,                            /* tp_dict */
+    0,                            /* tp_descr_get */
+    0,                            /* tp_descr_set */
+    0,                            /* tp_dictoffset */
+    0,                            /* tp_init */
+    0,                            /* tp_alloc */
+    FLACAudio_new,                /* tp_new */
+};
+
+// open a FLAC stream for repeated reads
+PyObject* flacpy_open(PyObject* self, PyObject* args, PyObject* kwargs) {
+    return PyObject_Call(reinterpret_cast<PyObject*>(&FLACAudioType), args, kwargs);
+}
+
+// consecutive chunk_samples-long reads of a range of one stream. with prefetch > 0 a background
+// thread decodes up to prefetch chunks ahead of the consumer, so at most prefetch + 1 chunks
+// are ever held here at once
+class ChunkStream {
+public:
+    FLACReader reader;
+    uint64_t position = 0;
+    uint64_t end = UINT64_MAX;
+    uint64_t chunk_samples = 0;
+    size_t prefetch = 0;
+
+    // the result of reading one chunk, audio is null once the range is exhausted
+    struct Chunk {
+        PyObject* audio = nullptr;
+        std::string error;
+    };
+
+    ~ChunkStream() { stop(); }
+
+    // start the background decoder, called with the GIL held
+    void start() {
+        if (prefetch > 0) {
+            worker_ = std::thread([this] { run(); });
+        }
+    }
+
+    // wait for the background decoder to exit and drop any chunks it left behind. called with
+    // the GIL held, which is released while waiting since the decoder takes it to allocate
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        if (worker_.joinable()) {
+            Py_BEGIN_ALLOW_THREADS
+            worker_.join();
+            Py_END_ALLOW_THREADS
+        }
+        for (auto& chunk : ready_) {
+            Py_XDECREF(chunk.audio);
+        }
+        ready_.clear();
+    }
+
+    // the next chunk, called without the GIL. a stopped stream just ends
+    Chunk next() {
+        if (prefetch == 0) {
+            // read_chunk takes the GIL, which stop holds while it waits for mutex_, so only
+            // read_mutex_ is held while reading
+            std::lock_guard<std::mutex> read_lock(read_mutex_);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_) {
+                    return Chunk();
+                }
+            }
+            return read_chunk();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !ready_.empty() || stopping_; });
+        if (ready_.empty()) {
+            return Chunk();
+        }
+        Chunk chunk = std::move(ready_.front());
+        ready_.pop_front();
+        // the end of the range and errors stay queued for any further calls
+        if (!chunk.audio) {
+            ready_.push_front(chunk);
+        }
+        lock.unlock();
+        cv_.notify_all();
+        return chunk;
+    }
+
+private:
+    Chunk read_chunk() {
+        Chunk chunk;
+        uint64_t count = std::min(chunk_samples, end - position);
+        if (count == 0 || done_) {
+            return chunk;
+        }
+        DecodedAudio decoded;
+        if (!reader.read(&position, count, decoded)) {
+            chunk.error = decoded.error;
+            return chunk;
+        }
+        if (decoded.samples_written == 0) {
+            if (!interpreter_finalizing()) {
+                ScopedGIL gil;
+                Py_CLEAR(decoded.audio);
+            }
+            done_ = true;
+            return chunk;
+        }
+        position += decoded.samples_written;
+        done_ = decoded.samples_written < count;
+        chunk.audio = decoded.audio;
+        return chunk;
+    }
+
+    // the decoder thread is not a Python thread, so it checks for shutdown before every read
+    // (each takes the GIL) and leaves rather than hang on a GIL that will never come back
+    void run() {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || ready_.size() < prefetch; });
+                if (stopping_) {
+                    return;
+                }
+            }
+            if (interpreter_finalizing()) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stopping_ = true;  // ends the stream for anyone waiting in next
+                }
+                cv_.notify_all();
+                return;
+            }
+            Chunk chunk = read_chunk();
+            bool last = !chunk.audio;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ready_.push_back(std::move(chunk));
+            }
+            cv_.notify_all();
+            if (last) {
+                return;
+            }
+        }
+    }
+
+    std::thread worker_;
+    std::deque<Chunk> ready_;
+    std::mutex mutex_;       // never held while taking the GIL
+    std::mutex read_mutex_;  // serializes reads without a background decoder
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    bool done_ = false;
+};
+
+static void FLACChunkIterator_dealloc(FLACChunkIteratorObject* self) {
+    if (self->stream) {
+        self->stream->stop();
+        delete self->stream;
+    }
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static PyObject* FLACChunkIterator_next(FLACChunkIteratorObject* self) {
+    ChunkStream::Chunk chunk;
+    Py_BEGIN_ALLOW_THREADS
+    chunk = self->stream->next();
+    Py_END_ALLOW_THREADS
+    if (!chunk.error.empty()) {
+        PyErr_SetString(PyExc_RuntimeError, chunk.error.c_str());
+    }
+    return chunk.audio;  // null without an error set ends the iteration
+}
+
+// stop decoding ahead and release the file before the iterator is garbage collected
+static PyObject* FLACChunkIterator_close(FLACChunkIteratorObject* self, PyObject* Py_UNUSED(ignored)) {
+    ChunkStream* stream = self->stream;
+    stream->stop();
+    Py_BEGIN_ALLOW_THREADS
+    stream->reader.close();
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef FLACChunkIterator_methods[] = {
+    {"close", (PyCFunction)FLACChunkIterator_close, METH_NOARGS,
+     "Stop decoding and release the underlying file"},
+    {NULL, NULL, 0, NULL}
+};
+
+PyTypeObject FLACChunkIteratorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "flacpy.FLACChunkIterator",   /* tp_name */
+    sizeof(FLACChunkIteratorObject), /* tp_basicsize */
+    0,                            /* tp_itemsize */
+    (destructor)FLACChunkIterator_dealloc, /* tp_dealloc */
+    0,                            /* tp_print */
+    0,                            /* tp_getattr */
+    0,                            /* tp_setattr */
+    0,                            /* tp_compare */
+    0,                            /* tp_repr */
+    0,                            /* tp_as_number */
+    0,                            /* tp_as_sequence */
+    0,                            /* tp_as_mapping */
+    0,                            /* tp_hash */
+    0,                            /* tp_call */
+    0,                            /* tp_str */
+    0,                            /* tp_getattro */
+    0,                            /* tp_setattro */
+    0,                            /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,           /* tp_flags */
+    "Iterator over fixed-size chunks of a FLAC stream, see flacpy.iter_chunks", /* tp_doc */
+    0,                            /* tp_traverse */
+    0,                            /* tp_clear */
+    0,                            /* tp_richcompare */
+    0,                            /* tp_weaklistoffset */
+    PyObject_SelfIter,            /* tp_iter */
+    (iternextfunc)FLACChunkIterator_next, /* tp_iternext */
+    FLACChunkIterator_methods,    /* tp_methods */
+};
+
+// iterate over a range of a FLAC stream in chunks of chunk_samples
+PyObject* flacpy_iter_chunks(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* source_obj;
+    uint64_t chunk_samples;
+    uint64_t start_sample = 0;
+    uint64_t num_samples = 0;
+    int prefetch = 1;
+    
+    static const char* kwlist[] = {"filename", "chunk_samples", "start_sample", "num_samples", "prefetch", NULL};
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OK|KKi", const_cast<char**>(kwlist),
+                                   &source_obj, &chunk_samples, &start_sample, &num_samples, &prefetch)) {
+        return NULL;
+    }
+    if (chunk_samples == 0) {
+        PyErr_SetString(PyExc_ValueError, "chunk_samples must be positive");
+        return NULL;
+    }
+    
+    FLACChunkIteratorObject* iterator = PyObject_New(FLACChunkIteratorObject, &FLACChunkIteratorType);
+    if (!iterator) {
+        return NULL;
+    }
+    ChunkStream* stream = new ChunkStream();
+    iterator->stream = stream;
+    if (!parse_source(source_obj, stream->reader.source)) {
+        Py_DECREF(iterator);
+        return NULL;
+    }
+    
+    std::string error;
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = stream->reader.open(error);
+    Py_END_ALLOW_THREADS
+    if (!ok) {
+        PyErr_SetString(PyExc_RuntimeError, (stream->reader.source.describe() + ": " + error).c_str());
+        Py_DECREF(iterator);
+        return NULL;
+    }
+    
+    stream->position = start_sample;
+    stream->end = num_samples > 0 ? start_sample + num_samples : UINT64_MAX;
+    stream->chunk_samples = chunk_samples;
+    stream->prefetch = prefetch > 0 ? prefetch : 0;
+    stream->start();
+    return reinterpret_cast<PyObject*>(iterator);
+}
+
+// find every frame of a source, see flac_index_frames
+static bool index_source(const FLACSource& source, std::vector<uint64_t>& entries, StreamFingerprint& fingerprint,
+                         std::string& error) {
+    MappedFile mapping;
+    const uint8_t* data;
+    size_t size;
+    if (source.is_memory()) {
+        data = static_cast<const uint8_t*>(source.view.buf);
+        size = static_cast<size_t>(source.view.len);
+    } else {
+        if (!mapping.open(source.path.c_str(), source.window ? source.offset : 0,
+                          source.window ? source.length : 0, error)) {
+            return false;
+        }
+        data = mapping.data();
+        size = mapping.size();
+    }
+    
+    if (!flac_index_frames(data, size, entries)) {
+        error = "Not a FLAC stream, no frames found";
+        return false;
+    }
+    const size_t header_offset = flac_id3v2_size(data, size);
+    if (header_offset > size || size - header_offset < 42 || !is_stream_header(data + header_offset)) {
+        error = "Not a FLAC stream, no STREAMINFO found";
+        return false;
+    }
+    fingerprint.length = size;
+    std::memcpy(fingerprint.streaminfo, data + header_offset + 8, sizeof(fingerprint.streaminfo));
+    return true;
+}
+
+// index the frames of a FLAC stream for load(index=...), optionally saving a sidecar file
+PyObject* flacpy_build_index(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* source_obj;
+    PyObject* save_path_obj = NULL;
+    
+    static const char* kwlist[] = {"filename", "save_path", NULL};
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", const_cast<char**>(kwlist),
+                                   &source_obj, &save_path_obj)) {
+        return NULL;
+    }
+    
+    FLACSource source;
+    if (!parse_source(source_obj, source)) {
+        return NULL;
+    }
+    std::string save_path;
+    if (save_path_obj && save_path_obj != Py_None && !parse_path(save_path_obj, save_path)) {
+        return NULL;
+    }
+    
+    std::vector<uint64_t> entries;
+    StreamFingerprint fingerprint;
+    std::string error;
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = index_source(source, entries, fingerprint, error) &&
+         (save_path.empty() || write_index_file(save_path, entries, fingerprint, error));
+    Py_END_ALLOW_THREADS
+    
+    if (!ok) {
+        PyErr_SetString(PyExc_RuntimeError, (source.describe() + ": " + error).c_str());
+        return NULL;
+    }
+    
+    npy_intp dims[2] = {static_cast<npy_intp>(entries.size() / 2), 2};
+    PyObject* index = PyArray_SimpleNew(2, dims, NPY_UINT64);
+    if (index && !entries.empty()) {
+        std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(index)), entries.data(), entries.size() * sizeof(uint64_t));
+    }
+    return index;
+}
+
+// summarize the requested range of a source into an overview, called without the GIL. bins
+// splits a range of known length into that many bins, block fixes the samples per bin instead
+static bool overview_source(const FLACSource& source, uint64_t start_sample, uint64_t num_samples, uint64_t bins,
+                            uint64_t block, Overview& overview, unsigned* sample_rate, unsigned* bits_per_sample,
+                            std::string& error) {
+    PartialFLACDecoder decoder;
+    decoder.set_range(start_sample, num_samples);
+    FLAC__StreamDecoderInitStatus init_status = decoder.init(source);
+    if (init_status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+        error = std::string("Failed to initialize FLAC decoder: ") + FLAC__StreamDecoderInitStatusString[init_status];
+        return false;
+    }
+    decoder.process_until_end_of_metadata();
+    free_metadata_blocks(decoder.metadata_blocks);
+    if (decoder.get_channels() == 0) {
+        error = "Not a FLAC stream, no STREAMINFO found";
+        return false;
+    }
+    *sample_rate = decoder.get_sample_rate();
+    *bits_per_sample = decoder.get_bits_per_sample();
+    
+    uint64_t range_length = 0;
+    const bool known_length = decoder.get_range_length(&range_length) || num_samples > 0;
+    if (num_samples > 0 && range_length == 0) {
+        range_length = num_samples;
+    }
+    if (block == 0) {
+        if (!known_length) {
+            error = "The stream doesn't report its length, pass block instead of bins";
+            return false;
+        }
+        block = std::max<uint64_t>(1, (range_length + bins - 1) / bins);
+    }
+    overview.block = block;
+    overview.channels = decoder.get_channels();
+    if (known_length) {
+        overview.reserve((range_length + block - 1) / block);
+    }
+    
+    decoder.set_overview(&overview);
+    if (start_sample > 0) {
+        decoder.seek_absolute(start_sample);
+    }
+    decoder.process_until_end_of_stream();
+    decoder.finish();
+    free_metadata_blocks(decoder.metadata_blocks);
+    return true;
+}
+
+// per-bin min, max and rms of a file, computed while decoding without ever holding its samples
+PyObject* flacpy_overview(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* source_obj;
+    unsigned long long bins = 1000;
+    unsigned long long block = 0;
+    uint64_t start_sample = 0;
+    uint64_t num_samples = 0;
+    
+    static const char* kwlist[] = {"filename", "bins", "block", "start_sample", "num_samples", NULL};
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|KKKK", const_cast<char**>(kwlist),
+                                   &source_obj, &bins, &block, &start_sample, &num_samples)) {
+        return NULL;
+    }
+    if (bins == 0 && block == 0) {
+        PyErr_SetString(PyExc_ValueError, "bins or block must be positive");
+        return NULL;
+    }
+    
+    FLACSource source;
+    if (!parse_source(source_obj, source)) {
+        return NULL;
+    }
+    
+    Overview overview;
+    unsigned sample_rate = 0, bits_per_sample = 0;
+    std::string error;
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = overview_source(source, start_sample, num_samples, bins, block, overview, &sample_rate, &bits_per_sample, error);
+    Py_END_ALLOW_THREADS
+    if (!ok) {
+        PyErr_SetString(PyExc_RuntimeError, (source.describe() + ": " + error).c_str());
+        return NULL;
+    }
+    
+    // only the bins that received audio, the last of which may be partial
+    const uint64_t num_bins = overview.bins();
+    npy_intp dims[2] = {static_cast<npy_intp>(num_bins), static_cast<npy_intp>(overview.channels)};
+    PyObject* min_array = PyArray_SimpleNew(2, dims, NPY_INT32);
+    PyObject* max_array = PyArray_SimpleNew(2, dims, NPY_INT32);
+    PyObject* rms_array = PyArray_SimpleNew(2, dims, NPY_FLOAT64);
+    PyObject* result = PyDict_New();
+    if (!min_array || !max_array || !rms_array || !result) {
+        Py_XDECREF(min_array);
+        Py_XDECREF(max_array);
+        Py_XDECREF(rms_array);
+        Py_XDECREF(result);
+        return NULL;
+    }
+    
+    const size_t count = static_cast<size_t>(num_bins * overview.channels);
+    if (count > 0) {
+        std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(min_array)), overview.min.data(), count * sizeof(int32_t));
+        std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(max_array)), overview.max.data(), count * sizeof(int32_t));
+    }
+    double* rms = static_cast<double*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(rms_array)));
+    for (uint64_t bin = 0; bin < num_bins; bin++) {
+        const uint64_t bin_samples = std::min(overview.block, overview.samples - bin * overview.block);
+        for (unsigned c = 0; c < overview.channels; c++) {
+            const size_t slot = static_cast<size_t>(bin * overview.channels + c);
+            rms[slot] = std::sqrt(overview.sum_squares[slot] / static_cast<double>(bin_samples));
+        }
+    }
+    
+    PyDict_SetItemString(result, "min", min_array);
+    PyDict_SetItemString(result, "max", max_array);
+    PyDict_SetItemString(result, "rms", rms_array);
+    Py_DECREF(min_array);
+    Py_DECREF(max_array);
+    Py_DECREF(rms_array);
+    dict_set_new(result, "block", PyLong_FromUnsignedLongLong(overview.block));
+    dict_set_new(result, "num_samples", PyLong_FromUnsignedLongLong(overview.samples));
+    dict_set_new(result, "sample_rate", PyLong_FromLong(sample_rate));
+    dict_set_new(result, "bits_per_sample", PyLong_FromLong(bits_per_sample));
+    return result;
+}
+
+// byte input over a source for flac_read_header. files go through stdio so a header is a single
+// buffered read and skipping a block is a seek, windows are read through the file the same way
+class SourceInput {
+public:
+    explicit SourceInput(const FLACSource& source) : source_(source) {}
+    ~SourceInput() {
+        if (file_) {
+            std::fclose(file_);
+        }
+    }
+
+    SourceInput(const SourceInput&) = delete;
+    SourceInput& operator=(const SourceInput&) = delete;
+
+    bool open(std::string& error) {
+        if (source_.is_memory()) {
+            data_ = static_cast<const uint8_t*>(source_.view.buf);
+            limit_ = static_cast<uint64_t>(source_.view.len);
+            return true;
+        }
+        file_ = fopen_utf8(source_.path.c_str(), "rb");
+        if (!file_) {
+            error = "Failed to open " + source_.path;
+            return false;
+        }
+        limit_ = UINT64_MAX;
+        if (source_.window) {
+            if (fseek64(file_, static_cast<int64_t>(source_.offset), SEEK_SET) != 0) {
+                error = "Byte range is outside of " + source_.path;
+                return false;
+            }
+            limit_ = source_.length ? source_.length : UINT64_MAX;
+        }
+        return true;
+    }
+
+    bool read(uint8_t* out, size_t size) {
+        if (limit_ - pos_ < size) {
+            return false;
+        }
+        if (file_) {
+            if (std::fread(out, 1, size, file_) != size) {
+                return false;
+            }
+        } else {
+            std::memcpy(out, data_ + pos_, size);
+        }
+        pos_ += size;
+        return true;
+    }
+
+    bool skip(uint64_t size) {
+        if (limit_ - pos_ < size) {
+            return false;
+        }
+        if (file_ && fseek64(file_, static_cast<int64_t>(size), SEEK_CUR) != 0) {
+            return false;
+        }
+        pos_ += size;
+        return true;
+    }
+
+private:
+    const FLACSource& source_;
+    FILE* file_ = nullptr;
+    const uint8_t* data_ = nullptr;
+    uint64_t pos_ = 0;
+    uint64_t limit_ = 0;
+};
+
+// a picture read by scan, in the same form load returns pictures in
+static PyObject* header_picture_to_dict(const FLACHeaderPicture& pic) {
+    PyObject* picture = PyDict_New();
+    if (!picture) {
+        return NULL;
+    }
+    dict_set_new(picture, "type", PyLong_FromUnsignedLong(pic.type));
+    dict_set_new(picture, "mime_type", PyUnicode_FromStringAndSize(pic.mime_type.data(), pic.mime_type.size()));
+    dict_set_new(picture, "description", PyUnicode_DecodeUTF8(pic.description.data(), pic.description.size(), "replace"));
+    dict_set_new(picture, "width", PyLong_FromUnsignedLong(pic.width));
+    dict_set_new(picture, "height", PyLong_FromUnsignedLong(pic.height));
+    dict_set_new(picture, "depth", PyLong_FromUnsignedLong(pic.depth));
+    dict_set_new(picture, "colors", PyLong_FromUnsignedLong(pic.colors));
+    dict_set_new(picture, "data", PyBytes_FromStringAndSize(reinterpret_cast<const char*>(pic.data.data()), pic.data.size()));
+    return picture;
+}
+
+// a one-dimensional array filled from a per-file field
+template <typename T, typename Get>
+static PyObject* scan_column(int type, const std::vector<FLACHeaderInfo>& infos, Get get) {
+    npy_intp dims[1] = {static_cast<npy_intp>(infos.size())};
+    PyObject* array = PyArray_SimpleNew(1, dims, type);
+    if (array) {
+        T* data = static_cast<T*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)));
+        for (size_t i = 0; i < infos.size(); i++) {
+            data[i] = static_cast<T>(get(infos[i]));
+        }
+    }
+    return array;
+}
+
+// tags read by scan. requested fields come back as one list per field, None where a file doesn't
+// have it, otherwise every file gets a dict of its tags. like load, a repeated field keeps its last value
+static PyObject* scan_tags(const FLACHeaderRequest& request, const std::vector<std::string>& field_names,
+                           const std::vector<FLACHeaderInfo>& infos) {
+    const Py_ssize_t count = static_cast<Py_ssize_t>(infos.size());
+    if (request.all_tags) {
+        PyObject* tags = PyList_New(count);
+        for (Py_ssize_t i = 0; tags && i < count; i++) {
+            // same layout as load's vorbis_comment, vendor string included
+            PyObject* file_tags = PyDict_New();
+            if (file_tags && !infos[i].vendor.empty() &&
+                dict_set_new(file_tags, "vendor", PyUnicode_DecodeUTF8(infos[i].vendor.data(), infos[i].vendor.size(), "replace")) < 0) {
+                Py_CLEAR(file_tags);
+            }
+            for (const auto& tag : infos[i].tags) {
+                if (file_tags && dict_set_new(file_tags, tag.first.c_str(),
+                                              PyUnicode_DecodeUTF8(tag.second.data(), tag.second.size(), "replace")) < 0) {
+                    Py_CLEAR(file_tags);
+                }
+            }
+            if (!file_tags) {
+                Py_CLEAR(tags);
+                break;
+            }
+            PyList_SET_ITEM(tags, i, file_tags);
+        }
+        return tags;
+    }
+    
+    PyObject* tags = PyDict_New();
+    std::vector<PyObject*> columns;  // borrowed from tags
+    for (size_t f = 0; tags && f < field_names.size(); f++) {
+        PyObject* column = PyList_New(count);
+        for (Py_ssize_t i = 0; column && i < count; i++) {
+            PyList_SET_ITEM(column, i, Py_NewRef(Py_None));
+        }
+        if (dict_set_new(tags, field_names[f].c_str(), column) < 0) {
+            Py_CLEAR(tags);
+            break;
+        }
+        columns.push_back(column);
+    }
+    for (Py_ssize_t i = 0; tags && i < count; i++) {
+        for (const auto& tag : infos[i].tags) {
+            for (size_t f = 0; f < request.fields.size(); f++) {
+                if (!FLACHeaderRequest::field_matches(request.fields[f], tag.first.c_str(), tag.first.size())) {
+                    continue;
+                }
+                PyObject* value = PyUnicode_DecodeUTF8(tag.second.data(), tag.second.size(), "replace");
+                if (!value) {
+                    Py_CLEAR(tags);
+                    return NULL;
+                }
+                PyList_SetItem(columns[f], i, value);
+            }
+        }
+    }
+    return tags;
+}
+
+// pictures read by scan, a list per file
+static PyObject* scan_pictures(const std::vector<FLACHeaderInfo>& infos) {
+    PyObject* pictures = PyList_New(static_cast<Py_ssize_t>(infos.size()));
+    for (size_t i = 0; pictures && i < infos.size(); i++) {
+        PyObject* file_pictures = PyList_New(0);
+        for (const FLACHeaderPicture& pic : infos[i].pictures) {
+            PyObject* picture = file_pictures ? header_picture_to_dict(pic) : NULL;
+            if (!picture || PyList_Append(file_pictures, picture) < 0) {
+                Py_CLEAR(file_pictures);
+            }
+            Py_XDECREF(picture);
+        }
+        if (!file_pictures) {
+            Py_CLEAR(pictures);
+            break;
+        }
+        PyList_SET_ITEM(pictures, static_cast<Py_ssize_t>(i), file_pictures);
+    }
+    return pictures;
+}
+
+// read the metadata headers of many files in parallel, without libFLAC and without touching
+// blocks that weren't asked for. results are columnar, and files that can't be read are
+// reported per file instead of failing the scan
+PyObject* flacpy_scan(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* filenames_obj;
+    PyObject* fields_obj = NULL;
+    int include_pictures = 0;
+    int threads = 0;
+    
+    static const char* kwlist[] = {"filenames", "fields", "include_pictures", "threads", NULL};
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|Opi", const_cast<char**>(kwlist),
+                                   &filenames_obj, &fields_obj, &include_pictures, &threads)) {
+        return NULL;
+    }
+    
+    FLACHeaderRequest request;
+    request.pictures = include_pictures != 0;
+    std::vector<std::string> field_names;
+    if (fields_obj && fields_obj != Py_None) {
+        PyObject* seq = PySequence_Fast(fields_obj, "fields must be a sequence of tag names");
+        if (!seq) {
+            return NULL;
+        }
+        for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+            const char* name = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, i));
+            if (!name) {
+                Py_DECREF(seq);
+                return NULL;
+            }
+            field_names.push_back(name);
+            std::string upper = name;
+            for (char& ch : upper) {
+                ch = (ch >= 'a' && ch <= 'z') ? static_cast<char>(ch - 32) : ch;
+            }
+            request.fields.push_back(upper);
+        }
+        Py_DECREF(seq);
+        request.all_tags = false;
+    }
+    
+    PyObject* filenames_seq = PySequence_Fast(filenames_obj, "filenames must be a sequence of sources");
+    if (!filenames_seq) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(filenames_seq);
+    std::vector<FLACSource> sources(count);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        if (!parse_source(PySequence_Fast_GET_ITEM(filenames_seq, i), sources[i])) {
+            Py_DECREF(filenames_seq);
+            return NULL;
+        }
+    }
+    Py_DECREF(filenames_seq);
+    
+    std::vector<FLACHeaderInfo> infos(count);
+    std::vector<std::string> errors(count);
+    std::vector<char> valid(count, 0);
+    size_t num_threads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    
+    Py_BEGIN_ALLOW_THREADS
+    parallel_for(get_thread_pool(), count, num_threads, [&](size_t i) {
+        SourceInput input(sources[i]);
+        valid[i] = input.open(errors[i]) && flac_read_header(input, request, infos[i], errors[i]);
+    });
+    Py_END_ALLOW_THREADS
+    
+    PyObject* result = PyDict_New();
+    if (!result) {
+        return NULL;
+    }
+    bool ok = dict_set_new(result, "sample_rate", scan_column<uint32_t>(NPY_UINT32, infos, [](const FLACHeaderInfo& info) { return info.sample_rate; })) == 0 &&
+              dict_set_new(result, "channels", scan_column<int32_t>(NPY_INT32, infos, [](const FLACHeaderInfo& info) { return info.channels; })) == 0 &&
+              dict_set_new(result, "bits_per_sample", scan_column<int32_t>(NPY_INT32, infos, [](const FLACHeaderInfo& info) { return info.bits_per_sample; })) == 0 &&
+              dict_set_new(result, "total_samples", scan_column<uint64_t>(NPY_UINT64, infos, [](const FLACHeaderInfo& info) { return info.total_samples; })) == 0;
+    
+    npy_intp dims[1] = {static_cast<npy_intp>(count)};
+    PyObject* valid_array = ok ? PyArray_SimpleNew(1, dims, NPY_BOOL) : NULL;
+    ok = valid_array != NULL;
+    if (ok) {
+        npy_bool* data = static_cast<npy_bool*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(valid_array)));
+        for (Py_ssize_t i = 0; i < count; i++) {
+            data[i] = valid[i] ? NPY_TRUE : NPY_FALSE;
+        }
+        ok = dict_set_new(result, "valid", valid_array) == 0;
+    }
+    
+    PyObject* error_list = ok ? PyList_New(count) : NULL;
+    ok = error_list != NULL;
+    for (Py_ssize_t i = 0; ok && i < count; i++) {
+        PyObject* item = valid[i] ? Py_NewRef(Py_None) : PyUnicode_FromString((sources[i].describe() + ": " + errors[i]).c_str());
+        ok = item != NULL;
+        if (ok) {
+            PyList_SET_ITEM(error_list, i, item);
+        }
+    }
+    if (!ok) {
+        Py_XDECREF(error_list);
+    }
+    ok = ok && dict_set_new(result, "errors", error_list) == 0;
+    
+    if (ok && request.wants_tags()) {
+        ok = dict_set_new(result, "tags", scan_tags(request, field_names, infos)) == 0;
+    }
+    if (ok && request.pictures) {
+        ok = dict_set_new(result, "pictures", scan_pictures(infos)) == 0;
+    }
+    
+    if (!ok) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// read an optional per-file sample offset/count argument, either one int for every file or a sequence
+static bool parse_per_file_samples(PyObject* obj, Py_ssize_t count, const char* name, std::vector<uint64_t>& values) {
+    values.assign(count, 0);
+    if (!obj || obj == Py_None) {
+        return true;
+    }
+    
+    if (PyLong_Check(obj)) {
+        uint64_t value = PyLong_AsUnsignedLongLong(obj);
+        if (PyErr_Occurred()) {
+            return false;
+        }
+        std::fill(values.begin(), values.end(), value);
+        return true;
+    }
+    
+    PyObject* seq = PySequence_Fast(obj, "");
+    if (!seq || PySequence_Fast_GET_SIZE(seq) != count) {
+        Py_XDECREF(seq);
+        PyErr_Format(PyExc_ValueError, "%s must be an int or a sequence with one entry per file", name);
+        return false;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        values[i] = PyLong_AsUnsignedLongLong(PySequence_Fast_GET_ITEM(seq, i));
+        if (PyErr_Occurred()) {
+            Py_DECREF(seq);
+            return false;
+        }
+    }
+    Py_DECREF(seq);
+    return true;
+}
+
+// load many FLAC files in parallel on the native thread pool
+PyObject* flacpy_load_many(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* filenames_obj;
+    PyObject* start_samples_obj = NULL;
+    PyObject* num_samples_obj = NULL;
+    int threads = 0;
+    PyObject* out_obj = NULL;
+    
+    static const char* kwlist[] = {"filenames", "start_samples", "num_samples", "threads", "out", NULL};
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOiO", const_cast<char**>(kwlist),
+                                   &filenames_obj, &start_samples_obj, &num_samples_obj, &threads, &out_obj)) {
+        return NULL;
+    }
+    
+    PyObject* filenames_seq = PySequence_Fast(filenames_obj, "filenames must be a sequence of sources");
+    if (!filenames_seq) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(filenames_seq);
+    
+    // resolve every source up front so the workers never touch Python objects
+    std::vector<FLACSource> sources(count);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        if (!parse_source(PySequence_Fast_GET_ITEM(filenames_seq, i), sources[i])) {
+            Py_DECREF(filenames_seq);
+            return NULL;
+        }
+    }
+    Py_DECREF(filenames_seq);
+    
+    std::vector<uint64_t> start_samples, num_samples;
+    if (!parse_per_file_samples(start_samples_obj, count, "start_samples", start_samples) ||
+        !parse_per_file_samples(num_samples_obj, count, "num_samples", num_samples)) {
+        return NULL;
+    }
+    
+    // optional preallocated (batch x frames x channels) output, shorter clips are zero padded
+    PyArrayObject* out_array = NULL;
+    if (out_obj && out_obj != Py_None) {
+        if (!PyArray_Check(out_obj)) {
+            PyErr_SetString(PyExc_TypeError, "out must be a NumPy array");
+            return NULL;
+        }
+        out_array = reinterpret_cast<PyArrayObject*>(out_obj);
+        if (PyArray_NDIM(out_array) != 3 || PyArray_TYPE(out_array) != NPY_INT32 ||
+            !PyArray_IS_C_CONTIGUOUS(out_array) || !PyArray_ISWRITEABLE(out_array)) {
+            PyErr_SetString(PyExc_ValueError, "out must be a writeable C-contiguous int32 array of shape (files, frames, channels)");
+            return NULL;
+        }
+        if (PyArray_DIM(out_array, 0) != count) {
+            PyErr_SetString(PyExc_ValueError, "out must have one row per file");
+            return NULL;
+        }
+    }
+    
+    std::vector<DecodedAudio> decoded(count);
+    if (out_array) {
+        npy_intp frames = PyArray_DIM(out_array, 1);
+        npy_intp channels = PyArray_DIM(out_array, 2);
+        int32_t* out_data = static_cast<int32_t*>(PyArray_DATA(out_array));
+        for (Py_ssize_t i = 0; i < count; i++) {
+            decoded[i].output = out_data + i * frames * channels;
+            decoded[i].output_capacity = frames;
+            decoded[i].output_channels = channels;
+        }
+    }
+    
+    size_t num_threads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    
+    Py_BEGIN_ALLOW_THREADS
+    parallel_for(get_thread_pool(), count, num_threads, [&](size_t i) {
+        DecodedAudio& item = decoded[i];
+        decode_source(sources[i], start_samples[i], num_samples[i], false, item);
+        
+        // zero the padding after a clip that didn't fill its row
+        if (item.output && item.samples_written < item.output_capacity) {
+            std::memset(static_cast<int32_t*>(item.output) + item.samples_written * item.output_channels, 0,
+                        (item.output_capacity - item.samples_written) * item.output_channels * sizeof(int32_t));
+        }
+    });
+    Py_END_ALLOW_THREADS
+    
+    // report the first failure, in file order
+    for (Py_ssize_t i = 0; i < count; i++) {
+        if (!decoded[i].error.empty()) {
+            PyErr_Format(PyExc_RuntimeError, "%s: %s", sources[i].describe().c_str(), decoded[i].error.c_str());
+            for (auto& item : decoded) {
+                Py_CLEAR(item.audio);
+                free_metadata_blocks(item.metadata_blocks);
+            }
+            return NULL;
+        }
+    }
+    
+    PyObject* results = PyList_New(count);
+    if (!results) {
+        for (auto& item : decoded) {
+            Py_CLEAR(item.audio);
+            free_metadata_blocks(item.metadata_blocks);
+        }
+        return NULL;
+    }
+    
+    for (Py_ssize_t i = 0; i < count; i++) {
+        // results decoded into out get a view of their unpadded rows
+        if (out_array) {
+            PyObject* row = PySequence_GetItem(out_obj, i);
+            decoded[i].audio = row ? PySequence_GetSlice(row, 0, decoded[i].samples_written) : NULL;
+            Py_XDECREF(row);
+            if (!decoded[i].audio) {
+                PyErr_Clear();
+            }
+        }
+        PyObject* result = build_load_result(decoded[i], false);
+        if (result && out_array) {
+            dict_set_new(result, "num_samples", PyLong_FromUnsignedLongLong(decoded[i].samples_written));
+        }
+        if (!result) {
+            for (Py_ssize_t j = i + 1; j < count; j++) {
+                Py_CLEAR(decoded[j].audio);
+                free_metadata_blocks(decoded[j].metadata_blocks);
+            }
+            Py_DECREF(results);
+            return NULL;
+        }
+        PyList_SET_ITEM(results, i, result);
+    }
+    
+    return results;
+}
+
+// not part of the public libFLAC headers but exported by every release, the flac command
+// line tool declares it the same way for --no-md5-sum
+extern "C" FLAC__bool FLAC__stream_encoder_set_do_md5(FLAC__StreamEncoder* encoder, FLAC__bool value);
+
+// the libFLAC handle behind any FLAC++ encoder, for the calls FLAC++ doesn't wrap
+struct EncoderHandle : FLAC::Encoder::Stream {
+    static ::FLAC__StreamEncoder* get(FLAC::Encoder::Stream& encoder) {
+        return encoder.*(&EncoderHandle::encoder_);
+    }
+};
+
+// hand num_threads to libFLAC 1.5+, which then encodes frames on its own worker threads. false
+// when it won't: older headers, a library built without threading, or more threads than it allows
+static bool set_encoder_threads(FLAC::Encoder::Stream& encoder, unsigned num_threads) {
+#if FLAC_API_VERSION_CURRENT >= 14
+    return FLAC__stream_encoder_set_num_threads(EncoderHandle::get(encoder), num_threads) ==
+           FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK;
+#else
+    return false;
+#endif
+}
+
+// encoder parameters shared by every encoding path
+struct EncoderSettings {
+    unsigned channels = 2;
+    unsigned bits_per_sample = 16;
+    unsigned sample_rate = 44100;
+    unsigned compression_level = 5;
+    bool verify = true;             // decode every frame again inside libFLAC and compare, roughly 2x the cpu
+    bool do_md5 = true;             // store the md5 of the audio in STREAMINFO
+    
+    // overrides of what compression_level picks, the defaults leave its choice alone
+    unsigned blocksize = 0;
+    int max_lpc_order = -1;
+    int qlp_coeff_precision = -1;   // 0 lets libFLAC choose
+    int max_residual_partition_order = -1;
+    int exhaustive_model_search = -1;
+    std::string apodization;
+};
+
+static void apply_encoder_settings(FLAC::Encoder::Stream& encoder, const EncoderSettings& settings) {
+    encoder.set_verify(settings.verify);
+    FLAC__stream_encoder_set_do_md5(EncoderHandle::get(encoder), settings.do_md5);
+    encoder.set_compression_level(settings.compression_level);
+    encoder.set_channels(settings.channels);
+    encoder.set_bits_per_sample(settings.bits_per_sample);
+    encoder.set_sample_rate(settings.sample_rate);
+    
+    // these must come after set_compression_level, which resets all of them
+    if (settings.blocksize > 0) {
+        encoder.set_blocksize(settings.blocksize);
+    }
+    if (settings.max_lpc_order >= 0) {
+        encoder.set_max_lpc_order(settings.max_lpc_order);
+    }
+    if (settings.qlp_coeff_precision >= 0) {
+        encoder.set_qlp_coeff_precision(settings.qlp_coeff_precision);
+    }
+    if (settings.max_residual_partition_order >= 0) {
+        encoder.set_max_residual_partition_order(settings.max_residual_partition_order);
+    }
+    if (settings.exhaustive_model_search >= 0) {
+        encoder.set_do_exhaustive_model_search(settings.exhaustive_model_search != 0);
+    }
+    if (!settings.apodization.empty()) {
+        encoder.set_apodization(settings.apodization.c_str());
+    }
+}
+
+// named starting points for the settings above, explicit arguments override them
+struct EncoderPreset {
+    const char* name;
+    unsigned compression_level;
+    bool verify;
+    bool do_md5;
+    bool exhaustive_model_search;
+};
+
+static const EncoderPreset encoder_presets[] = {
+    {"fast",     0, false, false, false},  // scratch and cache files, as cheap as FLAC gets
+    {"balanced", 5, false, true,  false},  // the default level without the verify pass
+    {"small",    8, false, true,  false},  // best ratio at normal speed
+    {"archive",  8, true,  true,  true},   // best ratio, every frame checked as it is written
+};
+
+// FLAC encoder class
+class FLACEncoder : public FLAC::Encoder::File {
+protected:
+    // progress callback
+    virtual void progress_callback(FLAC__uint64 bytes_written, FLAC__uint64 samples_written, 
+                                 unsigned frames_written, unsigned total_frames_estimate) override {
+        // could be used to report encoding progress
+    }
+};
+
+// encoder that keeps its output in memory, split into the stream header and the
+// encoded frames, one write callback per frame
+class MemoryFLACEncoder : public FLAC::Encoder::Stream {
+public:
+    std::vector<uint8_t> header;
+    std::vector<uint8_t> frames;
+    std::vector<uint32_t> frame_sizes;
+
+protected:
+    virtual ::FLAC__StreamEncoderWriteStatus write_callback(const FLAC__byte buffer[], size_t bytes,
+                                                            uint32_t samples, uint32_t current_frame) override {
+        if (samples == 0 && frame_sizes.empty()) {
+            header.insert(header.end(), buffer, buffer + bytes);
+        } else {
+            frames.insert(frames.end(), buffer, buffer + bytes);
+            frame_sizes.push_back(static_cast<uint32_t>(bytes));
+        }
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+    }
+};
+
+// encoder that writes a complete stream to memory, either into a fixed caller buffer or a
+// growable arena. it is seekable, so libFLAC goes back and rewrites STREAMINFO and the
+// seektable in place when the stream is finished, exactly as it does for files
+class BufferFLACEncoder : public FLAC::Encoder::Stream {
+public:
+    BufferFLACEncoder() : output_(nullptr), capacity_(0), size_(0), pos_(0), overflowed_(false) {}
+
+    // finish while the write callbacks still belong to this class
+    virtual ~BufferFLACEncoder() { finish(); }
+
+    // write into caller memory instead of the arena, running out of room fails the encode
+    void set_output(uint8_t* output, size_t capacity) {
+        output_ = output;
+        capacity_ = capacity;
+    }
+
+    void reserve(size_t bytes) { arena_.reserve(bytes); }
+
+    const uint8_t* data() const { return output_ ? output_ : arena_.data(); }
+    size_t size() const { return size_; }
+    bool overflowed() const { return overflowed_; }
+
+protected:
+    virtual ::FLAC__StreamEncoderWriteStatus write_callback(const FLAC__byte buffer[], size_t bytes,
+                                                            uint32_t samples, uint32_t current_frame) override {
+        size_t end = pos_ + bytes;
+        if (output_) {
+            if (end > capacity_) {
+                overflowed_ = true;
+                return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+            }
+            std::memcpy(output_ + pos_, buffer, bytes);
+        } else {
+            if (end > arena_.size()) {
+                arena_.resize(end);
+            }
+            std::memcpy(arena_.data() + pos_, buffer, bytes);
+        }
+        pos_ = end;
+        size_ = std::max(size_, end);
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+    }
+
+    virtual ::FLAC__StreamEncoderSeekStatus seek_callback(FLAC__uint64 absolute_byte_offset) override {
+        if (absolute_byte_offset > size_) {
+            return FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+        }
+        pos_ = static_cast<size_t>(absolute_byte_offset);
+        return FLAC__STREAM_ENCODER_SEEK_STATUS_OK;
+    }
+
+    virtual ::FLAC__StreamEncoderTellStatus tell_callback(FLAC__uint64* absolute_byte_offset) override {
+        *absolute_byte_offset = pos_;
+        return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+    }
+
+private:
+    uint8_t* output_;
+    size_t capacity_;
+    std::vector<uint8_t> arena_;
+    size_t size_;
+    size_t pos_;
+    bool overflowed_;
+};
+
+// frames handed to libFLAC per call, small enough that a block is still in cache while
+// libFLAC copies it into its own per-channel frame buffers
+static const uint64_t encode_block_samples = 1 << 14;
+
+// a counter-based hash, so dither noise depends only on the sample's position and not on how
+// the stream was split into blocks or chunks
+static inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// triangular noise over (-1, 1) LSB, the difference of two uniform values
+static inline double tpdf_dither(uint64_t index) {
+    uint64_t z = splitmix64(index);
+    return (static_cast<double>(static_cast<uint32_t>(z)) - static_cast<double>(static_cast<uint32_t>(z >> 32))) *
+           (1.0 / 4294967296.0);
+}
+
+// (frames x channels) int16, int32, float32 or float64 audio in any memory layout, addressed
+// through byte strides, along with how its samples become bits_per_sample integers
+struct AudioView {
+    const char* data = nullptr;
+    uint64_t num_samples = 0;
+    unsigned channels = 0;
+    npy_intp sample_stride = 0;   // bytes from one frame to the next
+    npy_intp channel_stride = 0;  // bytes from one channel to the next within a frame
+    int type = NPY_INT32;
+    int shift = 0;                // integer input, negative shifts right
+    double scale = 1.0;           // float input
+    bool dither = false;          // float input, TPDF dither before rounding
+    double min_value = 0;         // float input is clipped to the sample range
+    double max_value = 0;
+
+    // set up the conversion for a bit depth. normalized input has its dtype's full scale (or
+    // [-1, 1) for floats) mapped to the stream's full scale, otherwise values are taken as is
+    void set_quantization(unsigned bits_per_sample, bool normalize, bool use_dither) {
+        bits_per_sample = std::max(1u, std::min(32u, bits_per_sample));  // libFLAC rejects the rest at init
+        const double full_scale = static_cast<double>(uint64_t(1) << (bits_per_sample - 1));
+        min_value = -full_scale;
+        max_value = full_scale - 1;
+        shift = 0;
+        scale = 1.0;
+        dither = false;
+        if (type == NPY_FLOAT32 || type == NPY_FLOAT64) {
+            scale = normalize ? full_scale : 1.0;
+            dither = use_dither;
+        } else if (normalize) {
+            shift = static_cast<int>(bits_per_sample) - (type == NPY_INT16 ? 16 : 32);
+        }
+    }
+
+    size_t itemsize() const {
+        return type == NPY_INT16 ? 2 : (type == NPY_FLOAT64 ? 8 : 4);
+    }
+
+    const char* ptr(uint64_t frame, unsigned channel) const {
+        return data + static_cast<npy_intp>(frame) * sample_stride + static_cast<npy_intp>(channel) * channel_stride;
+    }
+
+    // int32 samples libFLAC can take straight from the array
+    bool is_native() const { return type == NPY_INT32 && shift == 0; }
+    const int32_t* at(uint64_t frame, unsigned channel) const { return reinterpret_cast<const int32_t*>(ptr(frame, channel)); }
+
+    bool is_interleaved() const {
+        return sample_stride == static_cast<npy_intp>(itemsize() * channels) &&
+               (channels == 1 || channel_stride == static_cast<npy_intp>(itemsize()));
+    }
+
+    // every channel contiguous, as in Fortran-ordered or transposed channel-major arrays
+    bool is_planar() const { return sample_stride == static_cast<npy_intp>(itemsize()); }
+
+    // convert frames [offset, offset + count) into interleaved int32 samples
+    void copy_interleaved(uint64_t offset, uint64_t count, int32_t* out) const {
+        switch (type) {
+            case NPY_INT16:
+                gather<int16_t>(offset, count, out, integer_converter());
+                break;
+            case NPY_FLOAT32:
+                gather<float>(offset, count, out, float_converter());
+                break;
+            case NPY_FLOAT64:
+                gather<double>(offset, count, out, float_converter());
+                break;
+            default:
+                gather<int32_t>(offset, count, out, integer_converter());
+                break;
+        }
+    }
+
+private:
+    // the int32 samples a generic integer is converted to, shifts of negative values
+    // go through unsigned to stay well defined
+    struct IntegerConverter {
+        int shift;
+        int32_t operator()(int32_t value, uint64_t) const {
+            return shift >= 0 ? static_cast<int32_t>(static_cast<uint32_t>(value) << shift) : value >> -shift;
+        }
+    };
+    IntegerConverter integer_converter() const { return IntegerConverter{shift}; }
+
+    // scale, dither, clip and round. NaN clips to the minimum
+    struct FloatConverter {
+        double scale, min_value, max_value;
+        bool dither;
+        int32_t operator()(double value, uint64_t index) const {
+            value = value * scale + (dither ? tpdf_dither(index) : 0.0);
+            value = value > min_value ? value : min_value;
+            value = value < max_value ? value : max_value;
+            return static_cast<int32_t>(std::floor(value + 0.5));
+        }
+    };
+    FloatConverter float_converter() const { return FloatConverter{scale, min_value, max_value, dither}; }
+
+    // interleaved input is converted as one flat run, which the compiler vectorizes
+    template <typename T, typename Convert>
+    void gather(uint64_t offset, uint64_t count, int32_t* out, Convert convert) const {
+        uint64_t first = offset * channels;
+        if (is_interleaved()) {
+            const T* in = reinterpret_cast<const T*>(ptr(offset, 0));
+            const uint64_t n = count * channels;
+            for (uint64_t i = 0; i < n; i++) {
+                out[i] = convert(in[i], first + i);
+            }
+            return;
+        }
+        for (uint64_t i = 0; i < count; i++) {
+            for (unsigned c = 0; c < channels; c++, first++) {
+                *out++ = convert(*reinterpret_cast<const T*>(ptr(offset + i, c)), first);
+            }
+        }
+    }
+};
+
+// view of an aligned, native byte order int16, int32, float32 or float64 array
+static AudioView audio_view(PyArrayObject* array) {
+    AudioView view;
+    view.data = PyArray_BYTES(array);
+    view.num_samples = static_cast<uint64_t>(PyArray_DIM(array, 0));
+    view.channels = static_cast<unsigned>(PyArray_DIM(array, 1));
+    view.sample_stride = PyArray_STRIDE(array, 0);
+    view.channel_stride = PyArray_STRIDE(array, 1);
+    view.type = PyArray_TYPE(array);
+    return view;
+}
+
+// feed interleaved int32 audio to an encoder in cache-sized blocks
+static bool encode_interleaved(FLAC::Encoder::Stream& encoder, const int32_t* audio_data,
+                               unsigned channels, uint64_t num_samples) {
+    for (uint64_t offset = 0; offset < num_samples; offset += encode_block_samples) {
+        uint64_t count = std::min(encode_block_samples, num_samples - offset);
+        if (!encoder.process_interleaved(audio_data + offset * channels, static_cast<uint32_t>(count))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// feed frames [offset, offset + count) of a view to an encoder. interleaved int32 audio goes
+// straight through process_interleaved and planar int32 audio is passed as per-channel pointers,
+// so neither is copied. other strides and every other dtype are converted, a block at a time,
+// into a small scratch buffer, so memory use doesn't depend on the length of the audio
+static bool encode_view(FLAC::Encoder::Stream& encoder, const AudioView& audio, uint64_t offset, uint64_t count,
+                        SaveStats* stats = nullptr) {
+    if (audio.is_native() && audio.is_interleaved()) {
+        StatsTimer timer(stats_field(stats, &SaveStats::encode_ns));
+        return encode_interleaved(encoder, audio.at(offset, 0), audio.channels, count);
+    }
     
-    // process audio if needed
-    if (!metadata_only) {
-        // use seek table if possible for faster positioning
-        if (start_sample > 0) {
-            decoder.seek_absolute(start_sample);
+    std::vector<const FLAC__int32*> channel_data(audio.channels);
+    std::vector<int32_t> scratch;
+    if (!audio.is_native() || !audio.is_planar()) {
+        scratch.resize(encode_block_samples * audio.channels);
+    }
+    
+    for (uint64_t done = 0; done < count; done += encode_block_samples) {
+        uint64_t n = std::min(encode_block_samples, count - done);
+        bool ok;
+        if (scratch.empty()) {
+            for (unsigned c = 0; c < audio.channels; c++) {
+                channel_data[c] = audio.at(offset + done, c);
+            }
+            StatsTimer timer(stats_field(stats, &SaveStats::encode_ns));
+            ok = encoder.process(channel_data.data(), static_cast<uint32_t>(n));
+        } else {
+            {
+                StatsTimer timer(stats_field(stats, &SaveStats::convert_ns));
+                audio.copy_interleaved(offset + done, n, scratch.data());
+            }
+            StatsTimer timer(stats_field(stats, &SaveStats::encode_ns));
+            ok = encoder.process_interleaved(scratch.data(), static_cast<uint32_t>(n));
+        }
+        if (!ok) {
+            return false;
         }
-        
-        // Decode audio data
-        decoder.process_until_end_of_stream();
     }
+    return true;
+}
+
+// MD5 of the samples in the layout libFLAC hashes them: interleaved, little-endian
+// at the smallest whole number of bytes that holds bits_per_sample
+static void md5_samples(const AudioView& audio, unsigned bits_per_sample, uint8_t digest[16]) {
+    MD5 md5;
+    const unsigned bytes_per_sample = (bits_per_sample + 7) / 8;
+    uint8_t block[16384];
+    const uint64_t block_frames = sizeof(block) / (bytes_per_sample * std::max(1u, audio.channels));
+    std::vector<int32_t> samples(block_frames * audio.channels);
     
-    // create return value
-    PyObject* result = PyDict_New();
-    if (!result) {
-        free_metadata_blocks(decoder.metadata_blocks);
-        return NULL;
+    for (uint64_t offset = 0; offset < audio.num_samples; offset += block_frames) {
+        uint64_t n = std::min(block_frames, audio.num_samples - offset);
+        audio.copy_interleaved(offset, n, samples.data());
+        uint8_t* out = block;
+        for (uint64_t i = 0; i < n * audio.channels; i++) {
+            uint32_t sample = static_cast<uint32_t>(samples[i]);
+            for (unsigned b = 0; b < bytes_per_sample; b++) {
+                *out++ = static_cast<uint8_t>(sample >> (8 * b));
+            }
+        }
+        md5.update(block, out - block);
+    }
+    md5.final(digest);
+}
+
+static void write_be(uint8_t* out, uint64_t value, unsigned bytes) {
+    for (unsigned i = 0; i < bytes; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * (bytes - 1 - i)));
+    }
+}
+
+static uint64_t read_be(const uint8_t* in, unsigned bytes) {
+    uint64_t value = 0;
+    for (unsigned i = 0; i < bytes; i++) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+// fill in the STREAMINFO fields of an encoded stream header that are only known once every
+// frame has been written. header must start with "fLaC" and the STREAMINFO block
+static bool patch_streaminfo(std::vector<uint8_t>& header, uint32_t min_framesize, uint32_t max_framesize,
+                             uint64_t total_samples, const uint8_t md5sum[16]) {
+    if (header.size() < 42 || std::memcmp(header.data(), "fLaC", 4) != 0 ||
+        (header[4] & 0x7F) != FLAC__METADATA_TYPE_STREAMINFO) {
+        return false;
     }
     
-    // add audio data if we requested it
-    if (!metadata_only) {
-        // get audio parameters
-        unsigned channels = decoder.get_channels();
-        unsigned bits_per_sample = decoder.get_bits_per_sample();
-        unsigned sample_rate = decoder.get_sample_rate();
+    uint8_t* info = header.data() + 8;
+    write_be(info + 4, min_framesize, 3);
+    write_be(info + 7, max_framesize, 3);
+    info[13] = static_cast<uint8_t>((info[13] & 0xF0) | ((total_samples >> 32) & 0x0F));
+    write_be(info + 14, total_samples & 0xFFFFFFFF, 4);
+    std::memcpy(info + 18, md5sum, 16);
+    return true;
+}
+
+// resolve the seektable template in an encoded stream header against the final frame layout,
+// the same way libFLAC does when it finishes a stream: each point moves to the start of the
+// frame holding its target sample, and duplicates or points past the end become placeholders
+static void fill_seektable(std::vector<uint8_t>& header, const std::vector<uint64_t>& frame_offsets,
+                           uint64_t blocksize, uint64_t total_samples) {
+    size_t pos = 4;
+    while (pos + 4 <= header.size()) {
+        bool is_last = (header[pos] & 0x80) != 0;
+        unsigned type = header[pos] & 0x7F;
+        size_t length = read_be(&header[pos + 1], 3);
         
-        npy_intp dims[2];
-        dims[0] = buffer.size() / channels;  // number of frames
-        dims[1] = channels;                  // number of channels
+        if (type == FLAC__METADATA_TYPE_SEEKTABLE && pos + 4 + length <= header.size()) {
+            uint8_t* points = &header[pos + 4];
+            size_t num_points = length / FLAC__STREAM_METADATA_SEEKPOINT_LENGTH;
+            
+            std::vector<FLAC__StreamMetadata_SeekPoint> resolved;
+            for (size_t i = 0; i < num_points; i++) {
+                uint64_t target = read_be(points + i * FLAC__STREAM_METADATA_SEEKPOINT_LENGTH, 8);
+                if (target == FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER) {
+                    continue;
+                }
+                uint64_t frame = target / blocksize;
+                if (frame >= frame_offsets.size()) {
+                    continue;
+                }
+                uint64_t sample_number = frame * blocksize;
+                if (!resolved.empty() && resolved.back().sample_number == sample_number) {
+                    continue;
+                }
+                FLAC__StreamMetadata_SeekPoint point;
+                point.sample_number = sample_number;
+                point.stream_offset = frame_offsets[frame];
+                point.frame_samples = static_cast<uint32_t>(std::min(blocksize, total_samples - sample_number));
+                resolved.push_back(point);
+            }
+            
+            for (size_t i = 0; i < num_points; i++) {
+                uint8_t* out = points + i * FLAC__STREAM_METADATA_SEEKPOINT_LENGTH;
+                if (i < resolved.size()) {
+                    write_be(out, resolved[i].sample_number, 8);
+                    write_be(out + 8, resolved[i].stream_offset, 8);
+                    write_be(out + 16, resolved[i].frame_samples, 2);
+                } else {
+                    write_be(out, FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER, 8);
+                    write_be(out + 8, 0, 8);
+                    write_be(out + 16, 0, 2);
+                }
+            }
+        }
         
-        PyObject* audio_array = PyArray_SimpleNew(2, dims, NPY_INT32);
-        if (!audio_array) {
-            Py_DECREF(result);
-            free_metadata_blocks(decoder.metadata_blocks);
-            return NULL;
+        if (is_last) {
+            break;
+        }
+        pos += 4 + length;
+    }
+}
+
+// encode interleaved int32 audio as independently encoded, block-aligned chunks on the thread pool
+// and stitch them into a single stream. every chunk numbers its frames from zero, so frames are
+// renumbered (with both crcs redone) as each chunk completes, and STREAMINFO and the seektable are
+// patched from the final frame layout. output receives the stream header followed by each chunk
+static bool encode_threaded(const AudioView& audio, const EncoderSettings& settings,
+                            std::vector<FLAC__StreamMetadata*>& metadata_blocks, size_t num_threads,
+                            std::vector<std::vector<uint8_t>>& output, std::string& error, SaveStats* stats) {
+    const uint64_t num_samples = audio.num_samples;
+    
+    // the md5 is taken over the whole signal below, none of the partial encoders can compute it
+    EncoderSettings chunk_settings = settings;
+    chunk_settings.do_md5 = false;
+    
+    // the stream header comes from an encoder that is given the metadata but no audio
+    MemoryFLACEncoder header_encoder;
+    apply_encoder_settings(header_encoder, chunk_settings);
+    header_encoder.set_verify(false);
+    if (!metadata_blocks.empty()) {
+        header_encoder.set_metadata(metadata_blocks.data(), metadata_blocks.size());
+    }
+    FLAC__StreamEncoderInitStatus init_status = header_encoder.init();
+    if (init_status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+        error = std::string("Failed to initialize FLAC encoder: ") + FLAC__StreamEncoderInitStatusString[init_status];
+        return false;
+    }
+    const uint64_t blocksize = header_encoder.get_blocksize();
+    header_encoder.finish();
+    
+    // a few chunks per thread keeps the workers busy when some chunks compress slower than others
+    const uint64_t total_blocks = (num_samples + blocksize - 1) / blocksize;
+    uint64_t num_chunks = std::max<uint64_t>(1, std::min<uint64_t>(total_blocks, num_threads * 4));
+    const uint64_t blocks_per_chunk = (total_blocks + num_chunks - 1) / num_chunks;
+    num_chunks = (total_blocks + blocks_per_chunk - 1) / blocks_per_chunk;
+    const uint64_t chunk_samples = blocks_per_chunk * blocksize;
+    
+    output.assign(num_chunks + 1, std::vector<uint8_t>());
+    std::vector<std::vector<uint32_t>> frame_sizes(num_chunks);
+    std::vector<std::string> errors(num_chunks);
+    uint8_t md5sum[16] = {};  // all zero means no md5 was computed
+    
+    // item 0 hashes the whole signal while the others encode
+    parallel_for(get_thread_pool(), num_chunks + 1, num_threads, [&](size_t item) {
+        if (item == 0) {
+            if (settings.do_md5) {
+                StatsTimer timer(stats_field(stats, &SaveStats::md5_ns));
+                md5_samples(audio, settings.bits_per_sample, md5sum);
+            }
+            return;
         }
         
-        // copy audio data to numpy array
-        int32_t* data_ptr = static_cast<int32_t*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(audio_array)));
-        std::copy(buffer.begin(), buffer.end(), data_ptr);
+        size_t chunk = item - 1;
+        uint64_t chunk_start = chunk * chunk_samples;
+        uint64_t chunk_length = std::min(chunk_samples, num_samples - chunk_start);
         
-        // add audio data and parameters to result
-        PyDict_SetItemString(result, "audio", audio_array);
-        PyDict_SetItemString(result, "sample_rate", PyLong_FromLong(sample_rate));
-        PyDict_SetItemString(result, "bits_per_sample", PyLong_FromLong(bits_per_sample));
+        MemoryFLACEncoder encoder;
+        apply_encoder_settings(encoder, chunk_settings);
+        if (encoder.init() != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+            errors[chunk] = "Failed to initialize FLAC encoder";
+            return;
+        }
+        bool ok = encode_view(encoder, audio, chunk_start, chunk_length, stats);
+        {
+            StatsTimer timer(stats_field(stats, &SaveStats::finish_ns));
+            ok = encoder.finish() && ok;
+        }
+        if (!ok) {
+            errors[chunk] = std::string("Failed to encode audio data: ") + encoder.get_state().as_cstring();
+            return;
+        }
         
-        Py_DECREF(audio_array);
-    }
+        std::vector<uint8_t>& frames = output[item];
+        frames.reserve(encoder.frames.size() + encoder.frame_sizes.size() * 8);
+        const uint64_t first_frame = chunk * blocks_per_chunk;
+        const uint8_t* frame = encoder.frames.data();
+        for (size_t i = 0; i < encoder.frame_sizes.size(); i++) {
+            size_t before = frames.size();
+            if (!flac_renumber_frame(frame, encoder.frame_sizes[i], first_frame + i, frames)) {
+                errors[chunk] = "Failed to parse an encoded frame";
+                return;
+            }
+            frame_sizes[chunk].push_back(static_cast<uint32_t>(frames.size() - before));
+            frame += encoder.frame_sizes[i];
+        }
+    });
     
-    // add metadata to result
-    PyObject* metadata = metadata_to_dict(decoder.metadata_blocks);
-    PyDict_SetItemString(result, "metadata", metadata);
-    Py_DECREF(metadata);
+    for (const auto& chunk_error : errors) {
+        if (!chunk_error.empty()) {
+            error = chunk_error;
+            return false;
+        }
+    }
     
-    // clean up metadata blocks
-    free_metadata_blocks(decoder.metadata_blocks);
+    // frame offsets are relative to the first frame, as seekpoints store them
+    std::vector<uint64_t> frame_offsets;
+    frame_offsets.reserve(total_blocks);
+    uint64_t offset = 0;
+    uint32_t min_framesize = UINT32_MAX, max_framesize = 0;
+    for (const auto& sizes : frame_sizes) {
+        for (uint32_t size : sizes) {
+            frame_offsets.push_back(offset);
+            offset += size;
+            min_framesize = std::min(min_framesize, size);
+            max_framesize = std::max(max_framesize, size);
+        }
+    }
+    if (frame_offsets.empty()) {
+        min_framesize = 0;
+    }
     
-    return result;
+    output[0].swap(header_encoder.header);
+    if (!patch_streaminfo(output[0], min_framesize, max_framesize, num_samples, md5sum)) {
+        error = "Failed to parse the encoded stream header";
+        return false;
+    }
+    fill_seektable(output[0], frame_offsets, blocksize, num_samples);
+    return true;
 }
 
-// FLAC encoder class
-class FLACEncoder : public FLAC::Encoder::File {
-protected:
-    // progress callback
-    virtual void progress_callback(FLAC__uint64 bytes_written, FLAC__uint64 samples_written, 
-                                 unsigned frames_written, unsigned total_frames_estimate) override {
-        // could be used to report encoding progress
+// write a stream held as a list of buffers to a file
+static bool write_file(const char* filename, const std::vector<std::vector<uint8_t>>& parts, std::string& error) {
+    FILE* file = fopen_utf8(filename, "wb");
+    if (!file) {
+        error = std::string("Failed to open ") + filename + " for writing";
+        return false;
     }
-};
+    bool ok = true;
+    for (const auto& part : parts) {
+        if (!part.empty() && std::fwrite(part.data(), 1, part.size(), file) != part.size()) {
+            ok = false;
+            break;
+        }
+    }
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok) {
+        error = std::string("Failed to write ") + filename;
+    }
+    return ok;
+}
+
+// look up key in any mapping, a new reference or NULL without an exception set if it's missing
+static PyObject* mapping_get(PyObject* mapping, const char* key) {
+    PyObject* value = PyMapping_GetItemString(mapping, key);
+    if (!value && PyErr_ExceptionMatches(PyExc_KeyError)) {
+        PyErr_Clear();
+    }
+    return value;
+}
+
+// dicts, load's Metadata and any other mapping, but not lists and strings
+static bool is_metadata_mapping(PyObject* obj) {
+    return PyDict_Check(obj) || (PyMapping_Check(obj) && !PySequence_Check(obj));
+}
 
-// extract Vorbis comments from Python dict
+// extract Vorbis comments from a Python mapping, NULL with an exception set on failure
 FLAC__StreamMetadata* create_vorbis_comment_from_dict(PyObject* comments_dict) {
-    if (!PyDict_Check(comments_dict)) {
+    PyObject* items = PyMapping_Items(comments_dict);
+    if (!items) {
         return nullptr;
     }
     
     FLAC__StreamMetadata* vorbis_comment = FLAC__metadata_object_new(FLAC__METADATA_TYPE_VORBIS_COMMENT);
     if (!vorbis_comment) {
+        Py_DECREF(items);
+        PyErr_NoMemory();
         return nullptr;
     }
     
-    PyObject* key, *value;
-    Py_ssize_t pos = 0;
-    
-    while (PyDict_Next(comments_dict, &pos, &key, &value)) {
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(items); i++) {
+        PyObject* key = PyTuple_GET_ITEM(PyList_GET_ITEM(items, i), 0);
+        PyObject* value = PyTuple_GET_ITEM(PyList_GET_ITEM(items, i), 1);
         if (!PyUnicode_Check(key) || !PyUnicode_Check(value)) {
             continue;
         }
         
         const char* key_str = PyUnicode_AsUTF8(key);
         const char* value_str = PyUnicode_AsUTF8(value);
+        if (!key_str || !value_str) {
+            Py_DECREF(items);
+            FLAC__metadata_object_delete(vorbis_comment);
+            return nullptr;
+        }
         
         if (strcmp(key_str, "vendor") == 0) {
             // set vendor string using the correct structure
@@ -463,256 +4771,1192 @@ FLAC__StreamMetadata* create_vorbis_comment_from_dict(PyObject* comments_dict) {
         }
     }
     
-    return vorbis_comment;
+    Py_DECREF(items);
+    return vorbis_comment;
+}
+
+// create picture metadata from a Python mapping, the data can be any contiguous buffer (bytes,
+// or the memoryview load returns). NULL with an exception set on failure, or without one when
+// picture_dict isn't a mapping
+FLAC__StreamMetadata* create_picture_from_dict(PyObject* picture_dict) {
+    if (!is_metadata_mapping(picture_dict)) {
+        return nullptr;
+    }
+    
+    FLAC__StreamMetadata* picture = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PICTURE);
+    if (!picture) {
+        PyErr_NoMemory();
+        return nullptr;
+    }
+    
+    // extract picture type and dimensions
+    auto& pic = picture->data.picture;
+    FLAC__uint32 type = pic.type;
+    const std::pair<const char*, FLAC__uint32*> numbers[] = {
+        {"type", &type}, {"width", &pic.width}, {"height", &pic.height}, {"depth", &pic.depth}, {"colors", &pic.colors}
+    };
+    for (const auto& number : numbers) {
+        PyObject* obj = mapping_get(picture_dict, number.first);
+        if (obj && PyLong_Check(obj)) {
+            *number.second = static_cast<FLAC__uint32>(PyLong_AsLong(obj));
+        }
+        Py_XDECREF(obj);
+        if (PyErr_Occurred()) {
+            FLAC__metadata_object_delete(picture);
+            return nullptr;
+        }
+    }
+    pic.type = (FLAC__StreamMetadata_Picture_Type)type;
+    
+    // MIME type and description, set through libFLAC so the block length stays right
+    PyObject* mime_obj = mapping_get(picture_dict, "mime_type");
+    if (mime_obj && PyUnicode_Check(mime_obj)) {
+        const char* mime_str = PyUnicode_AsUTF8(mime_obj);
+        if (mime_str) {
+            FLAC__metadata_object_picture_set_mime_type(picture, const_cast<char*>(mime_str), true);
+        }
+    }
+    Py_XDECREF(mime_obj);
+    
+    PyObject* desc_obj = PyErr_Occurred() ? NULL : mapping_get(picture_dict, "description");
+    if (desc_obj && PyUnicode_Check(desc_obj)) {
+        const char* desc_str = PyUnicode_AsUTF8(desc_obj);
+        if (desc_str) {
+            FLAC__metadata_object_picture_set_description(picture, (FLAC__byte*)desc_str, true);
+        }
+    }
+    Py_XDECREF(desc_obj);
+    
+    // picture data, copied once into the block
+    PyObject* data_obj = PyErr_Occurred() ? NULL : mapping_get(picture_dict, "data");
+    if (data_obj && PyObject_CheckBuffer(data_obj)) {
+        Py_buffer view;
+        if (PyObject_GetBuffer(data_obj, &view, PyBUF_CONTIG_RO) == 0) {
+            if (!FLAC__metadata_object_picture_set_data(picture, (FLAC__byte*)view.buf,
+                                                        static_cast<FLAC__uint32>(view.len), true)) {
+                PyErr_NoMemory();
+            }
+            PyBuffer_Release(&view);
+        }
+    }
+    Py_XDECREF(data_obj);
+    
+    if (PyErr_Occurred()) {
+        FLAC__metadata_object_delete(picture);
+        return nullptr;
+    }
+    return picture;
+}
+
+// create metadata blocks from a Python mapping, sets an exception and frees any blocks
+// already made on failure
+bool create_metadata_from_dict(PyObject* metadata_dict, std::vector<FLAC__StreamMetadata*>& blocks) {
+    // handle Vorbis comments
+    PyObject* vorbis_comments = mapping_get(metadata_dict, "vorbis_comment");
+    if (vorbis_comments && is_metadata_mapping(vorbis_comments)) {
+        FLAC__StreamMetadata* vorbis_block = create_vorbis_comment_from_dict(vorbis_comments);
+        if (vorbis_block) {
+            blocks.push_back(vorbis_block);
+        }
+    }
+    Py_XDECREF(vorbis_comments);
+    
+    // handle pictures, any sequence of mappings
+    PyObject* pictures = PyErr_Occurred() ? NULL : mapping_get(metadata_dict, "pictures");
+    if (pictures && PySequence_Check(pictures) && !PyUnicode_Check(pictures)) {
+        PyObject* items = PySequence_Fast(pictures, "pictures must be a sequence");
+        for (Py_ssize_t i = 0; items && i < PySequence_Fast_GET_SIZE(items); i++) {
+            FLAC__StreamMetadata* picture_block = create_picture_from_dict(PySequence_Fast_GET_ITEM(items, i));
+            if (picture_block) {
+                blocks.push_back(picture_block);
+            } else if (PyErr_Occurred()) {
+                break;
+            }
+        }
+        Py_XDECREF(items);
+    }
+    Py_XDECREF(pictures);
+    
+    // tbd: add other metadata types as needed...
+    
+    if (PyErr_Occurred()) {
+        free_metadata_blocks(blocks);
+        return false;
+    }
+    return true;
+}
+
+// metadata blocks for an encode: the caller's dict, a seektable template when the length is
+// known up front, and padding that brings the blocks up to metadata_pad_len, seektable included.
+// sets a Python error on failure
+static bool build_encode_metadata(PyObject* metadata_dict, int metadata_pad_len, int sample_rate, uint64_t num_samples,
+                                  PyObject* seekpoint_interval_obj, std::vector<FLAC__StreamMetadata*>& metadata_blocks) {
+    // gather metadata blocks, from a dict or any other mapping such as load's Metadata
+    if (metadata_dict && metadata_dict != Py_None && is_metadata_mapping(metadata_dict)) {
+        if (!create_metadata_from_dict(metadata_dict, metadata_blocks)) {
+            return false;
+        }
+    }
+    
+    // seekpoints every seekpoint_interval, an int counts samples and a float counts seconds
+    uint64_t seekpoint_spacing = static_cast<uint64_t>(sample_rate) * 10;
+    if (seekpoint_interval_obj && seekpoint_interval_obj != Py_None) {
+        double interval = PyFloat_Check(seekpoint_interval_obj)
+                              ? PyFloat_AsDouble(seekpoint_interval_obj) * sample_rate
+                              : static_cast<double>(PyLong_AsLongLong(seekpoint_interval_obj));
+        if (PyErr_Occurred()) {
+            return false;
+        }
+        if (interval < 0) {
+            PyErr_SetString(PyExc_ValueError, "seekpoint_interval must not be negative");
+            return false;
+        }
+        seekpoint_spacing = static_cast<uint64_t>(interval + 0.5);
+    }
+    
+    // libFLAC fills in the template's byte offsets as it writes the frames
+    if (seekpoint_spacing > 0 && num_samples > 0) {
+        FLAC__StreamMetadata* seektable = FLAC__metadata_object_new(FLAC__METADATA_TYPE_SEEKTABLE);
+        uint32_t spacing = static_cast<uint32_t>(std::min<uint64_t>(seekpoint_spacing, UINT32_MAX));
+        if (!seektable ||
+            !FLAC__metadata_object_seektable_template_append_spaced_points_by_samples(seektable, spacing, num_samples) ||
+            !FLAC__metadata_object_seektable_template_sort(seektable, true)) {
+            if (seektable) {
+                FLAC__metadata_object_delete(seektable);
+            }
+            PyErr_NoMemory();
+            return false;
+        }
+        metadata_blocks.insert(metadata_blocks.begin(), seektable);
+    }
+    
+    // calculate total metadata size, and add padding if needed
+    unsigned total_metadata_size = 0;
+    for (const auto* block : metadata_blocks) {
+        total_metadata_size += block->length;
+    }
+    if (metadata_pad_len > 0 && total_metadata_size < static_cast<unsigned>(metadata_pad_len)) {
+        FLAC__StreamMetadata* padding = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PADDING);
+        if (padding) {
+            padding->length = metadata_pad_len - total_metadata_size;
+            metadata_blocks.push_back(padding);
+        }
+    }
+    return true;
+}
+
+// audio, settings and metadata for one save or encode call, gathered with the GIL held.
+// owns a reference to the audio array, so it must be destroyed with the GIL held
+struct EncodeJob {
+    PyObject* audio_obj = nullptr;
+    AudioView audio;  // borrows from audio_obj
+    EncoderSettings settings;
+    std::vector<FLAC__StreamMetadata*> metadata_blocks;  // libFLAC only borrows these
+    size_t num_threads = 1;
+    bool native_threads = false;  // libFLAC accepted num_threads, set by configure_encoder
+
+    EncodeJob() = default;
+    EncodeJob(const EncodeJob&) = delete;
+    EncodeJob& operator=(const EncodeJob&) = delete;
+
+    ~EncodeJob() {
+        free_metadata_blocks(metadata_blocks);
+        Py_XDECREF(audio_obj);
+    }
+
+    // only meaningful after configure_encoder. a libFLAC that encodes on one thread (before 1.5,
+    // or built without threading) gets the stream split into independently encoded chunks instead
+    bool stitch_chunks() const {
+        return num_threads > 1 && audio.num_samples > 0 && !native_threads;
+    }
+};
+
+// optional encoder arguments of save and encode as passed, NULL or None keeps the default
+// (or the preset's value when a preset is given)
+struct EncoderOptionArgs {
+    PyObject* compression_level = NULL;
+    PyObject* preset = NULL;
+    PyObject* verify = NULL;
+    PyObject* do_md5 = NULL;
+    PyObject* blocksize = NULL;
+    PyObject* max_lpc_order = NULL;
+    PyObject* qlp_coeff_precision = NULL;
+    PyObject* apodization = NULL;
+    PyObject* exhaustive_model_search = NULL;
+    PyObject* max_residual_partition_order = NULL;
+};
+
+// read an optional integer argument, sets a Python error if it is out of range
+template <typename T>
+static bool parse_optional_int(PyObject* obj, const char* name, long min, long max, T& value) {
+    if (!obj || obj == Py_None) {
+        return true;
+    }
+    long number = PyLong_AsLong(obj);
+    if (number == -1 && PyErr_Occurred()) {
+        return false;
+    }
+    if (number < min || number > max) {
+        PyErr_Format(PyExc_ValueError, "%s must be between %ld and %ld", name, min, max);
+        return false;
+    }
+    value = static_cast<T>(number);
+    return true;
+}
+
+// read an optional bool argument
+static bool parse_optional_bool(PyObject* obj, bool& value) {
+    if (!obj || obj == Py_None) {
+        return true;
+    }
+    int truth = PyObject_IsTrue(obj);
+    value = truth == 1;
+    return truth >= 0;
+}
+
+// apply the preset and then the explicit arguments on top of it, sets a Python error on failure
+static bool parse_encoder_options(const EncoderOptionArgs& args, EncoderSettings& settings) {
+    if (args.preset && args.preset != Py_None) {
+        const char* name = PyUnicode_Check(args.preset) ? PyUnicode_AsUTF8(args.preset) : NULL;
+        const EncoderPreset* preset = NULL;
+        for (const EncoderPreset& candidate : encoder_presets) {
+            if (name && std::strcmp(name, candidate.name) == 0) {
+                preset = &candidate;
+            }
+        }
+        if (!preset) {
+            PyErr_Format(PyExc_ValueError, "unknown preset %R, expected 'fast', 'balanced', 'small' or 'archive'", args.preset);
+            return false;
+        }
+        settings.compression_level = preset->compression_level;
+        settings.verify = preset->verify;
+        settings.do_md5 = preset->do_md5;
+        settings.exhaustive_model_search = preset->exhaustive_model_search ? 1 : -1;
+    }
+    
+    bool exhaustive_model_search = settings.exhaustive_model_search == 1;
+    if (!parse_optional_int(args.compression_level, "compression_level", 0, 8, settings.compression_level) ||
+        !parse_optional_bool(args.verify, settings.verify) ||
+        !parse_optional_bool(args.do_md5, settings.do_md5) ||
+        !parse_optional_int(args.blocksize, "blocksize", 16, 65535, settings.blocksize) ||
+        !parse_optional_int(args.max_lpc_order, "max_lpc_order", 0, 32, settings.max_lpc_order) ||
+        !parse_optional_int(args.qlp_coeff_precision, "qlp_coeff_precision", 0, 15, settings.qlp_coeff_precision) ||
+        !parse_optional_int(args.max_residual_partition_order, "max_residual_partition_order", 0, 15,
+                            settings.max_residual_partition_order) ||
+        !parse_optional_bool(args.exhaustive_model_search, exhaustive_model_search)) {
+        return false;
+    }
+    if (args.exhaustive_model_search && args.exhaustive_model_search != Py_None) {
+        settings.exhaustive_model_search = exhaustive_model_search ? 1 : 0;
+    }
+    if (args.apodization && args.apodization != Py_None) {
+        const char* apodization = PyUnicode_Check(args.apodization) ? PyUnicode_AsUTF8(args.apodization) : NULL;
+        if (!apodization) {
+            PyErr_SetString(PyExc_TypeError, "apodization must be a str such as \"tukey(5e-1);partial_tukey(2)\"");
+            return false;
+        }
+        settings.apodization = apodization;
+    }
+    return true;
+}
+
+// validate the arguments shared by save and encode, sets a Python error on failure
+static bool prepare_encode_job(PyObject* audio_obj, PyObject* metadata_dict, int sample_rate, int bits_per_sample,
+                               const EncoderOptionArgs& options, int metadata_pad_len, int threads,
+                               PyObject* seekpoint_interval_obj, bool normalize, bool dither, EncodeJob& job) {
+    // ensure audio_obj is a NumPy array
+    if (!PyArray_Check(audio_obj)) {
+        audio_obj = PyArray_FROM_O(audio_obj);
+        if (!audio_obj) {
+            PyErr_SetString(PyExc_TypeError, "Could not convert audio data to NumPy array");
+            return false;
+        }
+    } else {
+        Py_INCREF(audio_obj);
+    }
+    job.audio_obj = audio_obj;
+    
+    PyArrayObject* audio_array = reinterpret_cast<PyArrayObject*>(audio_obj);
+    
+    // validate array dimensions
+    int ndim = PyArray_NDIM(audio_array);
+    if (ndim != 2) {
+        PyErr_SetString(PyExc_ValueError, "Audio data must be a 2D array (frames x channels)");
+        return false;
+    }
+    
+    // int16, int32, float32 and float64 in any memory layout are read in place and quantized
+    // block by block while encoding, only other dtypes and unaligned or byte-swapped arrays
+    // are converted first
+    int type = PyArray_TYPE(audio_array);
+    bool supported = type == NPY_INT16 || type == NPY_INT32 || type == NPY_FLOAT32 || type == NPY_FLOAT64;
+    if (!supported || !PyArray_ISALIGNED(audio_array) || !PyArray_ISNOTSWAPPED(audio_array)) {
+        PyObject* tmp = PyArray_FromArray(audio_array, PyArray_DescrFromType(supported ? type : NPY_INT32),
+                                          NPY_ARRAY_ALIGNED | NPY_ARRAY_NOTSWAPPED | NPY_ARRAY_FORCECAST);
+        if (!tmp) {
+            return false;
+        }
+        Py_DECREF(job.audio_obj);
+        job.audio_obj = tmp;
+        audio_array = reinterpret_cast<PyArrayObject*>(tmp);
+    }
+    
+    job.audio = audio_view(audio_array);
+    job.audio.set_quantization(bits_per_sample, normalize, dither);
+    
+    job.settings.channels = job.audio.channels;
+    job.settings.bits_per_sample = bits_per_sample;
+    job.settings.sample_rate = sample_rate;
+    if (!parse_encoder_options(options, job.settings)) {
+        return false;
+    }
+    
+    if (!build_encode_metadata(metadata_dict, metadata_pad_len, sample_rate, job.audio.num_samples,
+                               seekpoint_interval_obj, job.metadata_blocks)) {
+        return false;
+    }
+    
+    job.num_threads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    return true;
+}
+
+// apply a job's settings and metadata to a file or buffer encoder, which the caller then initializes
+// unless job.stitch_chunks() says libFLAC refused the threads and the stitched encoder takes over
+template <typename Encoder>
+static void configure_encoder(Encoder& encoder, EncodeJob& job) {
+    apply_encoder_settings(encoder, job.settings);
+    encoder.set_total_samples_estimate(job.audio.num_samples);
+    job.native_threads = job.num_threads > 1 && set_encoder_threads(encoder, static_cast<unsigned>(job.num_threads));
+    if (!job.metadata_blocks.empty()) {
+        encoder.set_metadata(job.metadata_blocks.data(), job.metadata_blocks.size());
+    }
+}
+
+// feed a job's audio to an initialized encoder and finish the stream
+static bool encode_job_audio(FLAC::Encoder::Stream& encoder, const EncodeJob& job, std::string& error,
+                             SaveStats* stats) {
+    // encode the audio data straight from the array, finishing writes out the final STREAMINFO
+    bool ok = encode_view(encoder, job.audio, 0, job.audio.num_samples, stats);
+    {
+        StatsTimer timer(stats_field(stats, &SaveStats::finish_ns));
+        ok = encoder.finish() && ok;
+    }
+    if (!ok) {
+        error = "Failed to encode audio data";
+    }
+    return ok;
+}
+
+// save a FLAC file with optional metadata
+PyObject* flacpy_save(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    PyObject* audio_obj;
+    PyObject* metadata_dict = NULL;
+    int sample_rate = 44100;
+    int bits_per_sample = 16;
+    EncoderOptionArgs options;  // compression level (0-8, default 5), preset, verify and tuning
+    int metadata_pad_len = 0;   // default padding length (0 means no padding)
+    int threads = 1;            // 0 means one per core
+    PyObject* seekpoint_interval = NULL;  // samples or seconds between seekpoints, 0 for no seektable
+    int normalize = 0;          // input is full scale of its dtype, [-1, 1) for floats
+    int dither = 0;             // TPDF dither when quantizing float input
+    
+    static const char* kwlist[] = {"filename", "audio", "metadata", "sample_rate", "bits_per_sample", "compression_level", "metadata_pad_len", "threads", "seekpoint_interval", "normalize", "dither",
+                                   "verify", "do_md5", "preset", "blocksize", "max_lpc_order", "qlp_coeff_precision",
+                                   "apodization", "exhaustive_model_search", "max_residual_partition_order", NULL};
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|OiiOiiOppOOOOOOOOO", const_cast<char**>(kwlist),
+                                   &filename, &audio_obj, &metadata_dict,
+                                   &sample_rate, &bits_per_sample, &options.compression_level, &metadata_pad_len, &threads,
+                                   &seekpoint_interval, &normalize, &dither,
+                                   &options.verify, &options.do_md5, &options.preset, &options.blocksize,
+                                   &options.max_lpc_order, &options.qlp_coeff_precision, &options.apodization,
+                                   &options.exhaustive_model_search, &options.max_residual_partition_order)) {
+        return NULL;
+    }
+    
+    EncodeJob job;
+    if (!prepare_encode_job(audio_obj, metadata_dict, sample_rate, bits_per_sample, options, metadata_pad_len,
+                            threads, seekpoint_interval, normalize != 0, dither != 0, job)) {
+        return NULL;
+    }
+
+    // everything from here on is libFLAC work, file i/o and plain memory traffic on the
+    // array we hold a reference to, so none of it needs the GIL
+    std::string error;
+    bool ok = false;
+    SaveStats job_stats;
+    
+    Py_BEGIN_ALLOW_THREADS
+    SaveStats* stats = stats_enabled().load(std::memory_order_relaxed) ? &job_stats : nullptr;
+    StatsCall<SaveStats> call(stats, save_stats_totals());
+    stats_count(stats_field(stats, &SaveStats::samples_encoded), job.audio.num_samples);
+    FLACEncoder encoder;
+    configure_encoder(encoder, job);
+    if (job.stitch_chunks()) {
+        std::vector<std::vector<uint8_t>> stream;
+        ok = encode_threaded(job.audio, job.settings, job.metadata_blocks,
+                             job.num_threads, stream, error, stats);
+        if (ok) {
+            StatsTimer timer(stats_field(stats, &SaveStats::write_ns));
+            ok = write_file(filename, stream, error);
+        }
+    } else {
+        FLAC__StreamEncoderInitStatus init_status = encoder.init(filename);
+        if (init_status == FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+            ok = encode_job_audio(encoder, job, error, stats);
+        } else {
+            error = std::string("Failed to initialize FLAC encoder: ") + FLAC__StreamEncoderInitStatusString[init_status];
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    if (!ok) {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return NULL;
+    }   
+    
+    Py_RETURN_NONE;
 }
 
-// create picture metadata from Python dict
-FLAC__StreamMetadata* create_picture_from_dict(PyObject* picture_dict) {
-    if (!PyDict_Check(picture_dict)) {
-        return nullptr;
-    }
+// encode audio to a FLAC stream in memory, returned as bytes or written into a caller buffer
+PyObject* flacpy_encode(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* audio_obj;
+    PyObject* metadata_dict = NULL;
+    int sample_rate = 44100;
+    int bits_per_sample = 16;
+    EncoderOptionArgs options;
+    int metadata_pad_len = 0;
+    int threads = 1;
+    PyObject* seekpoint_interval = NULL;
+    PyObject* out_obj = NULL;
+    int normalize = 0;
+    int dither = 0;
     
-    FLAC__StreamMetadata* picture = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PICTURE);
-    if (!picture) {
-        return nullptr;
-    }
+    static const char* kwlist[] = {"audio", "metadata", "sample_rate", "bits_per_sample", "compression_level", "metadata_pad_len", "threads", "seekpoint_interval", "out", "normalize", "dither",
+                                   "verify", "do_md5", "preset", "blocksize", "max_lpc_order", "qlp_coeff_precision",
+                                   "apodization", "exhaustive_model_search", "max_residual_partition_order", NULL};
     
-    // extract picture type
-    PyObject* type_obj = PyDict_GetItemString(picture_dict, "type");
-    if (type_obj && PyLong_Check(type_obj)) {
-        picture->data.picture.type = (FLAC__StreamMetadata_Picture_Type)PyLong_AsLong(type_obj);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OiiOiiOOppOOOOOOOOO", const_cast<char**>(kwlist),
+                                   &audio_obj, &metadata_dict, &sample_rate, &bits_per_sample,
+                                   &options.compression_level, &metadata_pad_len, &threads, &seekpoint_interval, &out_obj,
+                                   &normalize, &dither,
+                                   &options.verify, &options.do_md5, &options.preset, &options.blocksize,
+                                   &options.max_lpc_order, &options.qlp_coeff_precision, &options.apodization,
+                                   &options.exhaustive_model_search, &options.max_residual_partition_order)) {
+        return NULL;
     }
     
-    // extract MIME type
-    PyObject* mime_obj = PyDict_GetItemString(picture_dict, "mime_type");
-    if (mime_obj && PyUnicode_Check(mime_obj)) {
-        const char* mime_str = PyUnicode_AsUTF8(mime_obj);
-        picture->data.picture.mime_type = strdup(mime_str);
+    EncodeJob job;
+    if (!prepare_encode_job(audio_obj, metadata_dict, sample_rate, bits_per_sample, options, metadata_pad_len,
+                            threads, seekpoint_interval, normalize != 0, dither != 0, job)) {
+        return NULL;
     }
     
-    // extract description
-    PyObject* desc_obj = PyDict_GetItemString(picture_dict, "description");
-    if (desc_obj && PyUnicode_Check(desc_obj)) {
-        const char* desc_str = PyUnicode_AsUTF8(desc_obj);
-        picture->data.picture.description = (FLAC__byte*)strdup(desc_str);
+    const bool has_out = out_obj && out_obj != Py_None;
+    Py_buffer out_view;
+    if (has_out && PyObject_GetBuffer(out_obj, &out_view, PyBUF_WRITABLE) < 0) {
+        return NULL;
     }
     
-    // extract dimensions
-    PyObject* width_obj = PyDict_GetItemString(picture_dict, "width");
-    if (width_obj && PyLong_Check(width_obj)) {
-        picture->data.picture.width = PyLong_AsLong(width_obj);
-    }
+    BufferFLACEncoder encoder;
+    std::vector<std::vector<uint8_t>> stream;
+    size_t encoded_size = 0;
+    bool too_small = false;
+    std::string error;
+    bool ok = false;
+    SaveStats job_stats;
     
-    PyObject* height_obj = PyDict_GetItemString(picture_dict, "height");
-    if (height_obj && PyLong_Check(height_obj)) {
-        picture->data.picture.height = PyLong_AsLong(height_obj);
+    Py_BEGIN_ALLOW_THREADS
+    SaveStats* stats = stats_enabled().load(std::memory_order_relaxed) ? &job_stats : nullptr;
+    StatsCall<SaveStats> call(stats, save_stats_totals());
+    stats_count(stats_field(stats, &SaveStats::samples_encoded), job.audio.num_samples);
+    configure_encoder(encoder, job);
+    if (job.stitch_chunks()) {
+        ok = encode_threaded(job.audio, job.settings, job.metadata_blocks,
+                             job.num_threads, stream, error, stats);
+        for (const auto& part : stream) {
+            encoded_size += part.size();
+        }
+        if (ok && has_out) {
+            StatsTimer timer(stats_field(stats, &SaveStats::write_ns));
+            too_small = encoded_size > static_cast<size_t>(out_view.len);
+            ok = !too_small;
+            uint8_t* dest = static_cast<uint8_t*>(out_view.buf);
+            for (size_t i = 0; ok && i < stream.size(); i++) {
+                std::memcpy(dest, stream[i].data(), stream[i].size());
+                dest += stream[i].size();
+            }
+        }
+    } else {
+        if (has_out) {
+            encoder.set_output(static_cast<uint8_t*>(out_view.buf), static_cast<size_t>(out_view.len));
+        } else {
+            // most material compresses to around half its pcm size, the arena grows past that if needed
+            encoder.reserve(job.audio.num_samples * job.settings.channels * ((job.settings.bits_per_sample + 7) / 8) / 2 + 8192);
+        }
+        FLAC__StreamEncoderInitStatus init_status = encoder.init();
+        if (init_status == FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+            ok = encode_job_audio(encoder, job, error, stats);
+        } else {
+            error = std::string("Failed to initialize FLAC encoder: ") + FLAC__StreamEncoderInitStatusString[init_status];
+        }
+        too_small = encoder.overflowed();
+        encoded_size = encoder.size();
     }
+    Py_END_ALLOW_THREADS
     
-    PyObject* depth_obj = PyDict_GetItemString(picture_dict, "depth");
-    if (depth_obj && PyLong_Check(depth_obj)) {
-        picture->data.picture.depth = PyLong_AsLong(depth_obj);
+    if (has_out) {
+        Py_ssize_t available = out_view.len;
+        PyBuffer_Release(&out_view);
+        if (too_small) {
+            PyErr_Format(PyExc_ValueError, "out is too small for the encoded stream (%zd bytes available)", available);
+            return NULL;
+        }
     }
-    
-    PyObject* colors_obj = PyDict_GetItemString(picture_dict, "colors");
-    if (colors_obj && PyLong_Check(colors_obj)) {
-        picture->data.picture.colors = PyLong_AsLong(colors_obj);
+    if (!ok) {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return NULL;
+    }
+    if (has_out) {
+        return PyLong_FromSize_t(encoded_size);
     }
     
-    // extract picture data
-    PyObject* data_obj = PyDict_GetItemString(picture_dict, "data");
-    if (data_obj && PyBytes_Check(data_obj)) {
-        char* data_ptr;
-        Py_ssize_t data_len;
-        if (PyBytes_AsStringAndSize(data_obj, &data_ptr, &data_len) == 0) {
-            picture->data.picture.data = (FLAC__byte*)malloc(data_len);
-            if (picture->data.picture.data) {
-                memcpy(picture->data.picture.data, data_ptr, data_len);
-                picture->data.picture.data_length = data_len;
-            }
+    if (!job.stitch_chunks()) {
+        return PyBytes_FromStringAndSize(reinterpret_cast<const char*>(encoder.data()), encoded_size);
+    }
+    PyObject* result = PyBytes_FromStringAndSize(NULL, encoded_size);
+    if (result) {
+        char* dest = PyBytes_AS_STRING(result);
+        for (const auto& part : stream) {
+            std::memcpy(dest, part.data(), part.size());
+            dest += part.size();
         }
     }
-    
-    return picture;
+    return result;
 }
 
-// create metadata blocks from Python dict
-std::vector<FLAC__StreamMetadata*> create_metadata_from_dict(PyObject* metadata_dict) {
+// the blocks update_metadata writes, and which kinds of existing block they replace
+struct MetadataUpdate {
+    bool vorbis_comment = false;  // replace the vorbis comment, dropping it if blocks has none
+    bool vendor = false;          // the new vorbis comment names its own vendor string
+    bool pictures = false;        // replace every picture
     std::vector<FLAC__StreamMetadata*> blocks;
     
-    if (!PyDict_Check(metadata_dict)) {
-        return blocks;
-    }
+    ~MetadataUpdate() { free_metadata_blocks(blocks); }
     
-    // handle Vorbis comments
-    PyObject* vorbis_comments = PyDict_GetItemString(metadata_dict, "vorbis_comment");
-    if (vorbis_comments) {
-        FLAC__StreamMetadata* vorbis_block = create_vorbis_comment_from_dict(vorbis_comments);
-        if (vorbis_block) {
-            blocks.push_back(vorbis_block);
+    // keys that are present replace what the file has, keys that are missing leave it alone,
+    // and anything else (such as the stream info of a loaded Metadata) is ignored
+    bool parse(PyObject* metadata) {
+        if (!is_metadata_mapping(metadata)) {
+            PyErr_SetString(PyExc_TypeError, "metadata must be a mapping");
+            return false;
         }
+        PyObject* value = mapping_get(metadata, "vorbis_comment");
+        vorbis_comment = value != NULL;
+        if (value && value != Py_None && is_metadata_mapping(value)) {
+            // only a str is taken as the vendor, as in create_vorbis_comment_from_dict
+            PyObject* vendor_obj = mapping_get(value, "vendor");
+            vendor = vendor_obj && PyUnicode_Check(vendor_obj);
+            Py_XDECREF(vendor_obj);
+        }
+        Py_XDECREF(value);
+        value = PyErr_Occurred() ? NULL : mapping_get(metadata, "pictures");
+        pictures = value != NULL;
+        Py_XDECREF(value);
+        return !PyErr_Occurred() && create_metadata_from_dict(metadata, blocks);
+    }
+};
+
+// rewrite the metadata blocks of one file through a libFLAC chain, called without the GIL.
+// when the new blocks fit in the file's padding only the header is rewritten in place,
+// otherwise libFLAC copies the audio frames into a new file byte for byte, nothing is
+// ever decoded or re-encoded
+static bool update_file_metadata(const std::string& path, const MetadataUpdate& update, bool use_padding, std::string& error) {
+    FLAC::Metadata::Chain chain;
+    if (!chain.is_valid() || !chain.read(path.c_str())) {
+        error = std::string("Failed to read metadata: ") + chain.status().as_cstring();
+        return false;
     }
     
-    // handle pictures
-    PyObject* pictures = PyDict_GetItemString(metadata_dict, "pictures");
-    if (pictures && PyList_Check(pictures)) {
-        Py_ssize_t num_pics = PyList_Size(pictures);
-        for (Py_ssize_t i = 0; i < num_pics; i++) {
-            PyObject* pic_dict = PyList_GetItem(pictures, i);
-            FLAC__StreamMetadata* picture_block = create_picture_from_dict(pic_dict);
-            if (picture_block) {
-                blocks.push_back(picture_block);
+    // drop the blocks being replaced, keeping the vendor string of the old vorbis comment
+    FLAC::Metadata::Iterator iterator;
+    iterator.init(chain);
+    std::string vendor;
+    do {
+        FLAC__MetadataType type = iterator.get_block_type();
+        if (!(type == FLAC__METADATA_TYPE_VORBIS_COMMENT && update.vorbis_comment) &&
+            !(type == FLAC__METADATA_TYPE_PICTURE && update.pictures)) {
+            continue;
+        }
+        if (type == FLAC__METADATA_TYPE_VORBIS_COMMENT && vendor.empty()) {
+            std::unique_ptr<FLAC::Metadata::Prototype> block(iterator.get_block());
+            const ::FLAC__StreamMetadata* object = block ? static_cast<const ::FLAC__StreamMetadata*>(*block) : nullptr;
+            if (object && object->data.vorbis_comment.vendor_string.entry) {
+                vendor.assign(reinterpret_cast<const char*>(object->data.vorbis_comment.vendor_string.entry),
+                              object->data.vorbis_comment.vendor_string.length);
             }
         }
-    }
+        if (!iterator.delete_block(false)) {
+            error = "Failed to remove a metadata block";
+            return false;
+        }
+    } while (iterator.next());
     
-    // tbd: add other metadata types as needed...
+    // insert the new blocks in order, after the last block that isn't padding
+    while (iterator.get_block_type() == FLAC__METADATA_TYPE_PADDING && iterator.prev()) {
+    }
+    for (const FLAC__StreamMetadata* block : update.blocks) {
+        FLAC__StreamMetadata* copy = FLAC__metadata_object_clone(block);
+        if (!copy) {
+            error = "Out of memory";
+            return false;
+        }
+        FLAC::Metadata::Prototype* prototype;
+        if (copy->type == FLAC__METADATA_TYPE_VORBIS_COMMENT) {
+            // libFLAC gives every new vorbis comment its own vendor string, put the file's back
+            // unless the update names one
+            if (!update.vendor && !vendor.empty()) {
+                FLAC__StreamMetadata_VorbisComment_Entry entry;
+                entry.entry = (FLAC__byte*)vendor.data();
+                entry.length = static_cast<FLAC__uint32>(vendor.size());
+                FLAC__metadata_object_vorbiscomment_set_vendor_string(copy, entry, true);
+            }
+            prototype = new FLAC::Metadata::VorbisComment(copy, false);
+        } else {
+            prototype = new FLAC::Metadata::Picture(copy, false);
+        }
+        // on success the chain takes the block and deletes the wrapper
+        if (!iterator.insert_block_after(prototype)) {
+            delete prototype;
+            error = "Failed to insert a metadata block";
+            return false;
+        }
+    }
     
-    return blocks;
+    if (use_padding) {
+        chain.sort_padding();
+    }
+    if (!chain.write(use_padding, false)) {
+        error = std::string("Failed to write metadata: ") + chain.status().as_cstring();
+        return false;
+    }
+    return true;
 }
 
-// save a FLAC file with optional metadata
-PyObject* flacpy_save(PyObject* self, PyObject* args, PyObject* kwargs) {
-    const char* filename;
-    PyObject* audio_obj;
-    PyObject* metadata_dict = NULL;
-    int sample_rate = 44100;
-    int bits_per_sample = 16;
-    int compression_level = 5;  // default compression level (0-8)
-    int metadata_pad_len = 0;   // default padding length (0 means no padding)
+// edit the metadata of one file, or of many in parallel, without touching the audio
+PyObject* flacpy_update_metadata(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* filename_obj;
+    PyObject* metadata_obj;
+    int threads = 0;
+    int use_padding = 1;
     
-    static const char* kwlist[] = {"filename", "audio", "metadata", "sample_rate", "bits_per_sample", "compression_level", "metadata_pad_len", NULL};
+    static const char* kwlist[] = {"filename", "metadata", "threads", "use_padding", NULL};
     
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|Oiiii", const_cast<char**>(kwlist),
-                                   &filename, &audio_obj, &metadata_dict,
-                                   &sample_rate, &bits_per_sample, &compression_level, &metadata_pad_len)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|ip", const_cast<char**>(kwlist),
+                                   &filename_obj, &metadata_obj, &threads, &use_padding)) {
         return NULL;
     }
     
-    // ensure audio_obj is a NumPy array
-    if (!PyArray_Check(audio_obj)) {
-        audio_obj = PyArray_FROM_OTF(audio_obj, NPY_INT32, NPY_ARRAY_IN_ARRAY);
-        if (!audio_obj) {
-            PyErr_SetString(PyExc_TypeError, "Could not convert audio data to NumPy array");
+    // a single path raises on failure, a sequence of paths reports an error per file
+    const bool batch = !PyUnicode_Check(filename_obj) && !PyBytes_Check(filename_obj) &&
+                       !PyObject_HasAttrString(filename_obj, "__fspath__");
+    std::vector<std::string> paths;
+    if (batch) {
+        PyObject* seq = PySequence_Fast(filename_obj, "filename must be a path or a sequence of paths");
+        if (!seq) {
             return NULL;
         }
+        paths.resize(PySequence_Fast_GET_SIZE(seq));
+        for (size_t i = 0; i < paths.size(); i++) {
+            if (!parse_path(PySequence_Fast_GET_ITEM(seq, i), paths[i])) {
+                Py_DECREF(seq);
+                return NULL;
+            }
+        }
+        Py_DECREF(seq);
     } else {
-        Py_INCREF(audio_obj);
+        paths.resize(1);
+        if (!parse_path(filename_obj, paths[0])) {
+            return NULL;
+        }
     }
     
-    PyArrayObject* audio_array = reinterpret_cast<PyArrayObject*>(audio_obj);
-    
-    // validate array dimensions
-    int ndim = PyArray_NDIM(audio_array);
-    if (ndim != 2) {
-        Py_DECREF(audio_obj);
-        PyErr_SetString(PyExc_ValueError, "Audio data must be a 2D array (frames x channels)");
-        return NULL;
+    // one mapping for every file, or in batch mode a sequence with one per file
+    std::vector<std::unique_ptr<MetadataUpdate>> updates;
+    if (is_metadata_mapping(metadata_obj) || !batch) {
+        updates.emplace_back(new MetadataUpdate());
+        if (!updates[0]->parse(metadata_obj)) {
+            return NULL;
+        }
+    } else {
+        PyObject* seq = PySequence_Fast(metadata_obj, "metadata must be a mapping or a sequence of mappings");
+        if (!seq) {
+            return NULL;
+        }
+        if (static_cast<size_t>(PySequence_Fast_GET_SIZE(seq)) != paths.size()) {
+            Py_DECREF(seq);
+            PyErr_SetString(PyExc_ValueError, "metadata must have one mapping per file");
+            return NULL;
+        }
+        for (size_t i = 0; i < paths.size(); i++) {
+            updates.emplace_back(new MetadataUpdate());
+            if (!updates[i]->parse(PySequence_Fast_GET_ITEM(seq, i))) {
+                Py_DECREF(seq);
+                return NULL;
+            }
+        }
+        Py_DECREF(seq);
     }
     
-    // get array info
-    npy_intp* dims = PyArray_DIMS(audio_array);
-    unsigned num_samples = dims[0];     // number of frames
-    unsigned num_channels = dims[1];    // number of channels
+    std::vector<std::string> errors(paths.size());
+    std::vector<char> ok(paths.size(), 0);
+    size_t num_threads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
     
-    // ensure we have int32 data
-    if (PyArray_TYPE(audio_array) != NPY_INT32) {
-        PyObject* tmp = PyArray_Cast(audio_array, NPY_INT32);
-        Py_DECREF(audio_obj);
-        audio_obj = tmp;
-        audio_array = reinterpret_cast<PyArrayObject*>(audio_obj);
-    }
-    
-    // get a pointer to the audio data
-    int32_t* audio_data = static_cast<int32_t*>(PyArray_DATA(audio_array));
+    Py_BEGIN_ALLOW_THREADS
+    parallel_for(get_thread_pool(), paths.size(), num_threads, [&](size_t i) {
+        const MetadataUpdate& update = *updates[updates.size() == 1 ? 0 : i];
+        ok[i] = update_file_metadata(paths[i], update, use_padding != 0, errors[i]);
+    });
+    Py_END_ALLOW_THREADS
     
-    // set up the encoder
-    FLACEncoder encoder;
-    encoder.set_verify(true);
-    encoder.set_compression_level(compression_level);
-    encoder.set_channels(num_channels);
-    encoder.set_bits_per_sample(bits_per_sample);
-    encoder.set_sample_rate(sample_rate);
+    if (!batch) {
+        if (!ok[0]) {
+            PyErr_SetString(PyExc_RuntimeError, (paths[0] + ": " + errors[0]).c_str());
+            return NULL;
+        }
+        Py_RETURN_NONE;
+    }
     
-    // add metadata if provided
-    if (metadata_dict && PyDict_Check(metadata_dict)) {
-        std::vector<FLAC__StreamMetadata*> metadata_blocks = create_metadata_from_dict(metadata_dict);
-        
-        // calculate total metadata size
-        unsigned total_metadata_size = 0;
-        for (const auto* block : metadata_blocks) {
-            total_metadata_size += block->length;
+    PyObject* result = PyList_New(static_cast<Py_ssize_t>(paths.size()));
+    for (size_t i = 0; result && i < paths.size(); i++) {
+        PyObject* item = ok[i] ? Py_NewRef(Py_None) : PyUnicode_DecodeFSDefault((paths[i] + ": " + errors[i]).c_str());
+        if (!item) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, static_cast<Py_ssize_t>(i), item);
+    }
+    return result;
+}
+
+// incremental encoder behind flacpy.Writer, fed one block of interleaved audio at a time.
+// optionally encodes on a background thread, with at most max_queued blocks copied and waiting
+class StreamWriter {
+public:
+    std::unique_ptr<FLAC::Encoder::Stream> encoder;
+    BufferFLACEncoder* memory = nullptr;  // the encoder, when writing to memory
+    Py_buffer view = {};                  // caller memory being written into, if any
+    std::vector<FLAC__StreamMetadata*> metadata_blocks;  // borrowed by the encoder until it finishes
+    unsigned channels = 0;
+    uint64_t samples_written = 0;
+    bool closed = false;
+    size_t max_queued = 0;                // 0 encodes in write itself
+    std::mutex mutex;                     // held for a whole write or finish, guards the encoder, closed and samples_written
+
+    ~StreamWriter() {
+        finish();
+        if (view.obj) {
+            PyBuffer_Release(&view);
+        }
+        free_metadata_blocks(metadata_blocks);
+    }
+
+    void start() {
+        if (max_queued > 0) {
+            worker_ = std::thread([this] { run(); });
         }
+    }
 
-        // add padding if needed
-        if (metadata_pad_len > 0 && total_metadata_size < static_cast<unsigned>(metadata_pad_len)) {
-            unsigned padding_size = metadata_pad_len - total_metadata_size;
-            FLAC__StreamMetadata* padding = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PADDING);
-            if (padding) {
-                padding->length = padding_size;
-                metadata_blocks.push_back(padding);
+    // encode or queue a block, called without the GIL. value_error is set for a closed writer or
+    // an output buffer that is too small
+    bool write(const AudioView& audio, std::string& error, bool& value_error) {
+        std::lock_guard<std::mutex> guard(mutex);
+        const uint64_t num_samples = audio.num_samples;
+        if (closed) {
+            error = "write to a closed Writer";
+            value_error = true;
+            return false;
+        }
+        if (max_queued == 0) {
+            if (!encode_view(*encoder, audio, 0, num_samples)) {
+                value_error = overflowed();
+                error = value_error ? overflow_error : std::string("Failed to encode audio data: ") + encoder->get_state().as_cstring();
+                return false;
             }
+            samples_written += num_samples;
+            return true;
         }
         
-        if (!metadata_blocks.empty()) {
-            encoder.set_metadata(metadata_blocks.data(), metadata_blocks.size());
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return queue_.size() < max_queued || !error_.empty(); });
+        if (!error_.empty()) {
+            value_error = overflowed();
+            error = value_error ? overflow_error : error_;
+            return false;
+        }
+        std::vector<int32_t> block;
+        if (!spare_.empty()) {
+            block.swap(spare_.back());
+            spare_.pop_back();
         }
-        // note: metadata_blocks ownership is transferred to the encoder, do not free here
+        lock.unlock();
+        block.resize(num_samples * channels);
+        audio.copy_interleaved(0, num_samples, block.data());
+        lock.lock();
+        queue_.push_back(std::move(block));
+        samples_written += num_samples;
+        lock.unlock();
+        cv_.notify_all();
+        return true;
     }
-    else if (metadata_pad_len > 0) {
-        // add padding if needed but no metadata was provided
-        FLAC__StreamMetadata* padding = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PADDING);
-        if (padding) {
-            padding->length = metadata_pad_len;
-            encoder.set_metadata(&padding, 1);
+
+    // drain the queue and finish the stream, called without the GIL. finishing a closed writer
+    // does nothing
+    bool finish(std::string* error = nullptr, bool* value_error = nullptr) {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (closed) {
+            return true;
+        }
+        if (worker_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            cv_.notify_all();
+            worker_.join();
+        }
+        closed = true;
+        bool ok = encoder && encoder->finish() && error_.empty();
+        if (!ok && error) {
+            *error = overflowed() ? overflow_error : !error_.empty() ? error_ :
+                     std::string("Failed to finish the FLAC stream: ") + encoder->get_state().as_cstring();
+        }
+        if (!ok && value_error) {
+            *value_error = overflowed();
         }
+        return ok;
     }
 
-    // initialize the encoder
-    FLAC__StreamEncoderInitStatus init_status = encoder.init(filename);
-    if (init_status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
-        Py_DECREF(audio_obj);
-        PyErr_Format(PyExc_RuntimeError, "Failed to initialize FLAC encoder: %s",
-                    FLAC__StreamEncoderInitStatusString[init_status]);
-        return NULL;
+private:
+    static constexpr const char* overflow_error = "The output buffer is too small for the encoded stream";
+
+    bool overflowed() const { return memory && memory->overflowed(); }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            std::vector<int32_t> block = std::move(queue_.front());
+            queue_.pop_front();
+            bool failed = !error_.empty();
+            lock.unlock();
+            
+            bool ok = failed || encode_interleaved(*encoder, block.data(), channels, block.size() / channels);
+            
+            lock.lock();
+            if (!ok) {
+                error_ = std::string("Failed to encode audio data: ") + encoder->get_state().as_cstring();
+            }
+            spare_.push_back(std::move(block));
+            cv_.notify_all();
+        }
     }
+
+    std::thread worker_;
+    std::deque<std::vector<int32_t>> queue_;
+    std::vector<std::vector<int32_t>> spare_;  // finished blocks, reused to avoid reallocating
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::string error_;
+};
+
+static PyObject* FLACWriter_new(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+    PyObject* target_obj;
+    int channels;
+    int sample_rate;
+    int bits_per_sample = 16;
+    PyObject* compression_level = NULL;  // 0-8, default 5
+    PyObject* metadata_dict = NULL;
+    int metadata_pad_len = 0;
+    uint64_t total_samples = 0;  // expected length if known, needed for a seektable
+    PyObject* seekpoint_interval = NULL;
+    int background = 0;
+    int max_queued = 4;
+    
+    static const char* kwlist[] = {"target", "channels", "sample_rate", "bits_per_sample", "compression_level", "metadata",
+                                   "metadata_pad_len", "total_samples", "seekpoint_interval", "background", "max_queued", NULL};
     
-    // prepare buffer for interleaved to non-interleaved conversion
-    std::vector<FLAC__int32*> buffer(num_channels);
-    std::vector<std::vector<FLAC__int32>> channel_data(num_channels);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oii|iOOiKOpi", const_cast<char**>(kwlist),
+                                   &target_obj, &channels, &sample_rate, &bits_per_sample, &compression_level,
+                                   &metadata_dict, &metadata_pad_len, &total_samples, &seekpoint_interval,
+                                   &background, &max_queued)) {
+        return NULL;
+    }
+    if (channels <= 0) {
+        PyErr_SetString(PyExc_ValueError, "channels must be positive");
+        return NULL;
+    }
+    EncoderSettings settings;
+    if (!parse_optional_int(compression_level, "compression_level", 0, 8, settings.compression_level)) {
+        return NULL;
+    }
     
-    for (unsigned c = 0; c < num_channels; c++) {
-        channel_data[c].resize(num_samples);
-        buffer[c] = channel_data[c].data();
+    FLACWriterObject* self = reinterpret_cast<FLACWriterObject*>(type->tp_alloc(type, 0));
+    if (!self) {
+        return NULL;
     }
+    StreamWriter* writer = new StreamWriter();
+    self->writer = writer;
+    writer->channels = channels;
+    writer->max_queued = background ? std::max(1, max_queued) : 0;
     
-    // de-interleave the audio data
-    for (unsigned s = 0; s < num_samples; s++) {
-        for (unsigned c = 0; c < num_channels; c++) {
-            channel_data[c][s] = audio_data[s * num_channels + c];
+    // None writes to a growable arena, a writable buffer is filled in place, anything else is a path
+    std::string path;
+    if (target_obj == Py_None) {
+        writer->memory = new BufferFLACEncoder();
+        writer->encoder.reset(writer->memory);
+    } else if (!PyUnicode_Check(target_obj) && PyObject_CheckBuffer(target_obj)) {
+        if (PyObject_GetBuffer(target_obj, &writer->view, PyBUF_WRITABLE) < 0) {
+            Py_DECREF(self);
+            return NULL;
         }
+        writer->memory = new BufferFLACEncoder();
+        writer->memory->set_output(static_cast<uint8_t*>(writer->view.buf), static_cast<size_t>(writer->view.len));
+        writer->encoder.reset(writer->memory);
+    } else {
+        if (!parse_path(target_obj, path)) {
+            Py_DECREF(self);
+            return NULL;
+        }
+        writer->encoder.reset(new FLACEncoder());
+    }
+    
+    if (!build_encode_metadata(metadata_dict, metadata_pad_len, sample_rate, total_samples,
+                               seekpoint_interval, writer->metadata_blocks)) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    
+    settings.channels = channels;
+    settings.bits_per_sample = bits_per_sample;
+    settings.sample_rate = sample_rate;
+    
+    FLAC::Encoder::Stream& encoder = *writer->encoder;
+    apply_encoder_settings(encoder, settings);
+    encoder.set_total_samples_estimate(total_samples);
+    if (!writer->metadata_blocks.empty()) {
+        encoder.set_metadata(writer->metadata_blocks.data(), writer->metadata_blocks.size());
     }
     
-    // encode the audio data
-    bool ok = encoder.process(buffer.data(), num_samples);
+    FLAC__StreamEncoderInitStatus init_status;
+    Py_BEGIN_ALLOW_THREADS
+    init_status = writer->memory ? writer->memory->init() : static_cast<FLACEncoder&>(encoder).init(path);
+    Py_END_ALLOW_THREADS
+    if (init_status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+        PyErr_SetString(PyExc_RuntimeError, (std::string("Failed to initialize FLAC encoder: ") +
+                                             FLAC__StreamEncoderInitStatusString[init_status]).c_str());
+        writer->closed = true;
+        Py_DECREF(self);
+        return NULL;
+    }
     
-    // clean up
-    encoder.finish();
-    Py_DECREF(audio_obj);
+    writer->start();
+    return reinterpret_cast<PyObject*>(self);
+}
 
-    if (!ok) {
-        PyErr_SetString(PyExc_RuntimeError, "Failed to encode audio data");
+static void FLACWriter_dealloc(FLACWriterObject* self) {
+    if (self->writer) {
+        // an unclosed writer still finishes its stream
+        Py_BEGIN_ALLOW_THREADS
+        self->writer->finish();
+        Py_END_ALLOW_THREADS
+        delete self->writer;
+    }
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+// write(block), block is a (frames x channels) array
+static PyObject* FLACWriter_write(FLACWriterObject* self, PyObject* block_obj) {
+    StreamWriter* writer = self->writer;
+    
+    // any int32 layout is accepted as is
+    PyObject* array_obj = PyArray_FROM_OTF(block_obj, NPY_INT32, NPY_ARRAY_ALIGNED | NPY_ARRAY_NOTSWAPPED);
+    if (!array_obj) {
         return NULL;
-    }   
+    }
+    PyArrayObject* array = reinterpret_cast<PyArrayObject*>(array_obj);
+    if (PyArray_NDIM(array) != 2 || PyArray_DIM(array, 1) != static_cast<npy_intp>(writer->channels)) {
+        Py_DECREF(array_obj);
+        PyErr_Format(PyExc_ValueError, "Audio blocks must be 2D arrays of (frames x %u channels)", writer->channels);
+        return NULL;
+    }
     
+    AudioView audio = audio_view(array);
+    std::string error;
+    bool value_error = false;
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = writer->write(audio, error, value_error);
+    Py_END_ALLOW_THREADS
+    Py_DECREF(array_obj);
+    
+    if (!ok) {
+        PyErr_SetString(value_error ? PyExc_ValueError : PyExc_RuntimeError, error.c_str());
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+// finish the stream, waiting for any queued blocks to be encoded
+static PyObject* FLACWriter_close(FLACWriterObject* self, PyObject* Py_UNUSED(ignored)) {
+    StreamWriter* writer = self->writer;
+    std::string error;
+    bool value_error = false;
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = writer->finish(&error, &value_error);
+    Py_END_ALLOW_THREADS
+    // finished, so no write can still be filling the buffer
+    if (writer->view.obj) {
+        PyBuffer_Release(&writer->view);
+    }
+    if (!ok) {
+        PyErr_SetString(value_error ? PyExc_ValueError : PyExc_RuntimeError, error.c_str());
+        return NULL;
+    }
     Py_RETURN_NONE;
 }
 
+// the encoded stream of a closed writer that had no target
+static PyObject* FLACWriter_getvalue(FLACWriterObject* self, PyObject* Py_UNUSED(ignored)) {
+    StreamWriter* writer = self->writer;
+    std::unique_lock<std::mutex> lock = lock_with_gil(writer->mutex);
+    if (!writer->memory || writer->view.obj || !writer->closed) {
+        PyErr_SetString(PyExc_ValueError, "getvalue() needs a Writer created with target=None that has been closed");
+        return NULL;
+    }
+    return PyBytes_FromStringAndSize(reinterpret_cast<const char*>(writer->memory->data()), writer->memory->size());
+}
+
+static PyObject* FLACWriter_enter(FLACWriterObject* self, PyObject* Py_UNUSED(ignored)) {
+    Py_INCREF(self);
+    return reinterpret_cast<PyObject*>(self);
+}
+
+static PyObject* FLACWriter_exit(FLACWriterObject* self, PyObject* Py_UNUSED(args)) {
+    return FLACWriter_close(self, NULL);
+}
+
+static PyObject* FLACWriter_get_samples_written(FLACWriterObject* self, void* closure) {
+    std::unique_lock<std::mutex> lock = lock_with_gil(self->writer->mutex);
+    return PyLong_FromUnsignedLongLong(self->writer->samples_written);
+}
+
+static PyObject* FLACWriter_get_bytes_written(FLACWriterObject* self, void* closure) {
+    StreamWriter* writer = self->writer;
+    if (!writer->memory) {
+        Py_RETURN_NONE;
+    }
+    std::unique_lock<std::mutex> lock = lock_with_gil(writer->mutex);
+    return PyLong_FromSize_t(writer->closed ? writer->memory->size() : 0);
+}
+
+static PyObject* FLACWriter_get_closed(FLACWriterObject* self, void* closure) {
+    std::unique_lock<std::mutex> lock = lock_with_gil(self->writer->mutex);
+    return PyBool_FromLong(self->writer->closed);
+}
+
+static PyMethodDef FLACWriter_methods[] = {
+    {"write", (PyCFunction)FLACWriter_write, METH_O,
+     "Encode a (frames x channels) block of audio"},
+    {"close", (PyCFunction)FLACWriter_close, METH_NOARGS,
+     "Finish the stream"},
+    {"getvalue", (PyCFunction)FLACWriter_getvalue, METH_NOARGS,
+     "Return the encoded stream of a closed Writer created with target=None"},
+    {"__enter__", (PyCFunction)FLACWriter_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)FLACWriter_exit, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef FLACWriter_getset[] = {
+    {"samples_written", (getter)FLACWriter_get_samples_written, NULL, "Samples accepted by write so far", NULL},
+    {"bytes_written", (getter)FLACWriter_get_bytes_written, NULL, "Size of the finished stream when writing to memory", NULL},
+    {"closed", (getter)FLACWriter_get_closed, NULL, "True once close has been called", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+PyTypeObject FLACWriterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "flacpy.Writer",              /* tp_name */
+    sizeof(FLACWriterObject),     /* tp_basicsize */
+    0,                            /* tp_itemsize */
+    (destructor)FLACWriter_dealloc, /* tp_dealloc */
+    0,                            /* tp_print */
+    0,                            /* tp_getattr */
+    0,                            /* tp_setattr */
+    0,                            /* tp_compare */
+    0,                            /* tp_repr */
+    0,                            /* tp_as_number */
+    0,                            /* tp_as_sequence */
+    0,                            /* tp_as_mapping */
+    0,                            /* tp_hash */
+    0,                            /* tp_call */
+    0,                            /* tp_str */
+    0,                            /* tp_getattro */
+    0,                            /* tp_setattro */
+    0,                            /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,           /* tp_flags */
+    "Incremental FLAC encoder writing to a file or to memory", /* tp_doc */
+    0,                            /* tp_traverse */
+    0,                            /* tp_clear */
+    0,                            /* tp_richcompare */
+    0,                            /* tp_weaklistoffset */
+    0,                            /* tp_iter */
+    0,                            /* tp_iternext */
+    FLACWriter_methods,           /* tp_methods */
+    0,                            /* tp_members */
+    FLACWriter_getset,            /* tp_getset */
+    0,                            /* tp_base */
+    0,                            /* tp_dict */
+    0,                            /* tp_descr_get */
+    0,                            /* tp_descr_set */
+    0,                            /* tp_dictoffset */
+    0,                            /* tp_init */
+    0,                            /* tp_alloc */
+    FLACWriter_new,               /* tp_new */
+};
+
 // module method definitions
 static PyMethodDef FLACPyMethods[] = {
     {"load", (PyCFunction)flacpy_load, METH_VARARGS | METH_KEYWORDS, 
      "Load a FLAC file with optional offset and length"},
+    {"load_async", (PyCFunction)flacpy_load_async, METH_VARARGS | METH_KEYWORDS,
+     "Load a FLAC file on a worker thread, returning an asyncio future"},
+    {"open", (PyCFunction)flacpy_open, METH_VARARGS | METH_KEYWORDS,
+     "Open a FLAC file for repeated reads"},
+    {"iter_chunks", (PyCFunction)flacpy_iter_chunks, METH_VARARGS | METH_KEYWORDS,
+     "Iterate over a FLAC file in fixed-size chunks with bounded memory"},
+    {"load_many", (PyCFunction)flacpy_load_many, METH_VARARGS | METH_KEYWORDS,
+     "Load many FLAC files in parallel on a native thread pool"},
+    {"overview", (PyCFunction)flacpy_overview, METH_VARARGS | METH_KEYWORDS,
+     "Compute per-bin min, max and rms of a FLAC file without keeping its samples"},
+    {"update_metadata", (PyCFunction)flacpy_update_metadata, METH_VARARGS | METH_KEYWORDS,
+     "Rewrite the tags and pictures of FLAC files in place, without re-encoding the audio"},
+    {"scan", (PyCFunction)flacpy_scan, METH_VARARGS | METH_KEYWORDS,
+     "Read the stream info and tags of many FLAC files in parallel"},
+    {"build_index", (PyCFunction)flacpy_build_index, METH_VARARGS | METH_KEYWORDS,
+     "Index the frames of a FLAC file for fast partial loads"},
     {"save", (PyCFunction)flacpy_save, METH_VARARGS | METH_KEYWORDS,
      "Save audio data to a FLAC file with optional metadata"},
+    {"encode", (PyCFunction)flacpy_encode, METH_VARARGS | METH_KEYWORDS,
+     "Encode audio data to an in-memory FLAC stream"},
+    {"stats", (PyCFunction)flacpy_stats, METH_VARARGS | METH_KEYWORDS,
+     "Phase timings and counters of loads and saves, summed since import or the last reset"},
     {NULL, NULL, 0, NULL}
 };
 
@@ -740,10 +5984,28 @@ PyMODINIT_FUNC PyInit__flacpy(void) {  // Note: double underscore before flacpy
     // initialize our custom types
     if (PyType_Ready(&FLACAudioType) < 0)
         return NULL;
+    if (PyType_Ready(&FLACChunkIteratorType) < 0)
+        return NULL;
+    if (PyType_Ready(&FLACWriterType) < 0)
+        return NULL;
+    if (PyType_Ready(&FLACMetadataType) < 0)
+        return NULL;
+    if (PyType_Ready(&FLACPictureDataType) < 0)
+        return NULL;
+    if (PyType_Ready(&FLACAsyncLoadType) < 0)
+        return NULL;
+    if (PyType_Ready(&FLACDecoderPoolType) < 0)
+        return NULL;
     
     // add types to the module
     Py_INCREF(&FLACAudioType);
     PyModule_AddObject(m, "FLACAudio", (PyObject*)&FLACAudioType);
+    Py_INCREF(&FLACWriterType);
+    PyModule_AddObject(m, "Writer", (PyObject*)&FLACWriterType);
+    Py_INCREF(&FLACMetadataType);
+    PyModule_AddObject(m, "Metadata", (PyObject*)&FLACMetadataType);
+    Py_INCREF(&FLACDecoderPoolType);
+    PyModule_AddObject(m, "DecoderPool", (PyObject*)&FLACDecoderPoolType);
     
     return m;
 }
\ No newline at end of file
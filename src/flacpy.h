@@ -34,19 +34,71 @@ SOFTWARE.
 #include <string>
 #include <memory>
 
-// type definition for FLACAudio object
+struct MetadataBlocks;
+
+// type definition for flacpy.Metadata, the read-only mapping load returns as "metadata".
+// keeps the decoder's cloned blocks and only builds Python objects for the keys accessed
+typedef struct {
+    PyObject_HEAD
+    std::shared_ptr<MetadataBlocks>* blocks;
+    PyObject* values;       // dict of the values built so far
+} FLACMetadataObject;
+
+extern PyTypeObject FLACMetadataType;
+
+class FLACReader;
+
+// type definition for FLACAudio object, an open stream returned by flacpy.open
 typedef struct {
     PyObject_HEAD
-    std::vector<int32_t>* buffer;
-    unsigned int channels;
-    unsigned int sample_rate;
-    unsigned int bits_per_sample;
+    FLACReader* reader;
+    PyObject* metadata;     // Metadata mapping, taken from the reader on first access
 } FLACAudioObject;
 
 extern PyTypeObject FLACAudioType;
 
+class ChunkStream;
+
+// type definition for the iterator returned by flacpy.iter_chunks
+typedef struct {
+    PyObject_HEAD
+    ChunkStream* stream;
+} FLACChunkIteratorObject;
+
+extern PyTypeObject FLACChunkIteratorType;
+
+class StreamWriter;
+
+// type definition for flacpy.Writer
+typedef struct {
+    PyObject_HEAD
+    StreamWriter* writer;
+} FLACWriterObject;
+
+extern PyTypeObject FLACWriterType;
+
+class DecoderPool;
+
+// type definition for flacpy.DecoderPool, decoders and output memory shared by its loads
+typedef struct {
+    PyObject_HEAD
+    std::shared_ptr<DecoderPool>* pool;
+} FLACDecoderPoolObject;
+
+extern PyTypeObject FLACDecoderPoolType;
+
 // api function declarations
 PyObject* flacpy_load(PyObject* self, PyObject* args, PyObject* kwargs);
+PyObject* flacpy_load_async(PyObject* self, PyObject* args, PyObject* kwargs);
+PyObject* flacpy_open(PyObject* self, PyObject* args, PyObject* kwargs);
+PyObject* flacpy_iter_chunks(PyObject* self, PyObject* args, PyObject* kwargs);
+PyObject* flacpy_build_index(PyObject* self, PyObject* args, PyObject* kwargs);
+PyObject* flacpy_overview(PyObject* self, PyObject* args, PyObject* kwargs);
+PyObject* flacpy_scan(PyObject* self, PyObject* args, PyObject* kwargs);
+PyObject* flacpy_load_many(PyObject* self, PyObject* args, PyObject* kwargs);
 PyObject* flacpy_save(PyObject* self, PyObject* args, PyObject* kwargs);
+PyObject* flacpy_encode(PyObject* self, PyObject* args, PyObject* kwargs);
+PyObject* flacpy_update_metadata(PyObject* self, PyObject* args, PyObject* kwargs);
+PyObject* flacpy_stats(PyObject* self, PyObject* args, PyObject* kwargs);
 
 #endif // FLACPY_H
\ No newline at end of file
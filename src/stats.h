@@ -0,0 +1,189 @@
+/*
+MIT License
+
+Copyright (c) 2025 Christopher Friesen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef FLACPY_STATS_H
+#define FLACPY_STATS_H
+
+// counters behind flacpy.stats and load(..., return_stats=True). every field is a relaxed
+// atomic, so the threads of one call can add to the same counters, and each call adds its
+// own counters to the module-wide totals once it's done
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+typedef std::atomic<uint64_t> StatsCounter;
+
+template <typename Stats>
+struct StatsField {
+    const char* name;
+    StatsCounter Stats::* counter;
+};
+
+// add every field of one set of counters to another, optionally zeroing the source
+template <typename Stats>
+inline void stats_add(Stats& totals, Stats& stats, bool reset = false) {
+    for (const StatsField<Stats>& field : Stats::fields) {
+        StatsCounter& counter = stats.*field.counter;
+        uint64_t value = reset ? counter.exchange(0, std::memory_order_relaxed) : counter.load(std::memory_order_relaxed);
+        (totals.*field.counter).fetch_add(value, std::memory_order_relaxed);
+    }
+}
+
+// phases of decoding, summed over every thread a call used. bytes are as read from the input
+struct LoadStats {
+    StatsCounter calls{0};
+    StatsCounter total_ns{0};
+    StatsCounter open_ns{0};         // opening the input and initializing the decoder
+    StatsCounter metadata_ns{0};     // reading metadata blocks
+    StatsCounter seek_ns{0};         // seeking to the first sample, which decodes the frame holding it
+    StatsCounter decode_ns{0};
+    StatsCounter output_ns{0};       // allocating, trimming and filling the output array
+    StatsCounter bytes_read{0};
+    StatsCounter frames_decoded{0};
+    StatsCounter frames_skipped{0};  // decoded before the requested range started
+    StatsCounter seeks{0};
+
+    static const StatsField<LoadStats> fields[11];
+};
+
+inline const StatsField<LoadStats> LoadStats::fields[11] = {
+    {"calls", &LoadStats::calls},
+    {"total_ns", &LoadStats::total_ns},
+    {"open_ns", &LoadStats::open_ns},
+    {"metadata_ns", &LoadStats::metadata_ns},
+    {"seek_ns", &LoadStats::seek_ns},
+    {"decode_ns", &LoadStats::decode_ns},
+    {"output_ns", &LoadStats::output_ns},
+    {"bytes_read", &LoadStats::bytes_read},
+    {"frames_decoded", &LoadStats::frames_decoded},
+    {"frames_skipped", &LoadStats::frames_skipped},
+    {"seeks", &LoadStats::seeks},
+};
+
+// phases of save and encode. libFLAC verifies and hashes inside the same calls that encode,
+// so those are part of encode_ns unless the audio is encoded in stitched chunks
+struct SaveStats {
+    StatsCounter calls{0};
+    StatsCounter total_ns{0};
+    StatsCounter convert_ns{0};      // converting and interleaving input that isn't int32
+    StatsCounter encode_ns{0};
+    StatsCounter finish_ns{0};       // flushing the last frame and rewriting STREAMINFO
+    StatsCounter md5_ns{0};          // hashing done outside libFLAC, for stitched chunks
+    StatsCounter write_ns{0};        // writing stitched chunks to the file or out
+    StatsCounter samples_encoded{0};
+
+    static const StatsField<SaveStats> fields[8];
+};
+
+inline const StatsField<SaveStats> SaveStats::fields[8] = {
+    {"calls", &SaveStats::calls},
+    {"total_ns", &SaveStats::total_ns},
+    {"convert_ns", &SaveStats::convert_ns},
+    {"encode_ns", &SaveStats::encode_ns},
+    {"finish_ns", &SaveStats::finish_ns},
+    {"md5_ns", &SaveStats::md5_ns},
+    {"write_ns", &SaveStats::write_ns},
+    {"samples_encoded", &SaveStats::samples_encoded},
+};
+
+// whether calls that didn't ask for their own stats still add to the totals
+inline std::atomic<bool>& stats_enabled() {
+    static std::atomic<bool> enabled(false);
+    return enabled;
+}
+
+// module-wide totals since import or the last reset
+inline LoadStats& load_stats_totals() {
+    static LoadStats totals;
+    return totals;
+}
+
+inline SaveStats& save_stats_totals() {
+    static SaveStats totals;
+    return totals;
+}
+
+// one counter of a set of stats, or null when the stats aren't being collected
+template <typename Stats>
+inline StatsCounter* stats_field(Stats* stats, StatsCounter Stats::* counter) {
+    return stats ? &(stats->*counter) : nullptr;
+}
+
+inline void stats_count(StatsCounter* counter, uint64_t value = 1) {
+    if (counter) {
+        counter->fetch_add(value, std::memory_order_relaxed);
+    }
+}
+
+inline uint64_t stats_elapsed_ns(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+// adds the time from construction to destruction to a counter, if there is one
+class StatsTimer {
+public:
+    explicit StatsTimer(StatsCounter* counter) :
+        counter_(counter), start_(counter ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {}
+    ~StatsTimer() {
+        if (counter_) {
+            stats_count(counter_, stats_elapsed_ns(start_));
+        }
+    }
+
+    StatsTimer(const StatsTimer&) = delete;
+    StatsTimer& operator=(const StatsTimer&) = delete;
+
+private:
+    StatsCounter* counter_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// times a whole call into its stats and adds them to the totals when it returns, however it
+// returns. the time from the phase timers is summed over threads and may exceed total_ns
+template <typename Stats>
+class StatsCall {
+public:
+    StatsCall(Stats* stats, Stats& totals) :
+        stats_(stats), totals_(totals), start_(stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {}
+    ~StatsCall() {
+        if (stats_) {
+            stats_count(&stats_->calls);
+            stats_count(&stats_->total_ns, stats_elapsed_ns(start_));
+            stats_add(totals_, *stats_);
+        }
+    }
+
+    StatsCall(const StatsCall&) = delete;
+    StatsCall& operator=(const StatsCall&) = delete;
+
+private:
+    Stats* stats_;
+    Stats& totals_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif // FLACPY_STATS_H
@@ -0,0 +1,215 @@
+/*
+MIT License
+
+Copyright (c) 2025 Christopher Friesen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef FLACPY_THREAD_POOL_H
+#define FLACPY_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// one per core, the most workers a pool grows to and the most threads a parallel_for runs on
+inline size_t max_parallel_threads() {
+    static const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    return max_threads;
+}
+
+// simple fifo worker pool, threads are only ever added, up to max_parallel_threads
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t num_threads) : stopping_(false) { ensure_size(num_threads); }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // grow the pool to at least num_threads workers, or max_parallel_threads if that's fewer
+    void ensure_size(size_t num_threads) {
+        num_threads = std::min(num_threads, max_parallel_threads());
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (threads_.size() < num_threads) {
+            threads_.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return threads_.size();
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        cv_.notify_one();
+    }
+
+private:
+    void worker_loop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (stopping_ && tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_;
+};
+
+// module-wide pool sized to the host, intentionally never destroyed so that interpreter
+// shutdown never has to join workers
+inline ThreadPool& get_thread_pool() {
+    static ThreadPool* pool = new ThreadPool(max_parallel_threads());
+    return *pool;
+}
+
+// feeds tasks to a pool with at most max_running of them in flight and at most max_waiting
+// queued behind those, so that a burst of submissions can neither grow without bound nor take
+// every worker away from parallel_for. a finished task's worker runs the next waiting one
+class BoundedTaskQueue {
+public:
+    BoundedTaskQueue(ThreadPool& pool, size_t max_running, size_t max_waiting) :
+        pool_(pool), max_running_(std::max<size_t>(1, max_running)), max_waiting_(max_waiting), running_(0) {}
+
+    BoundedTaskQueue(const BoundedTaskQueue&) = delete;
+    BoundedTaskQueue& operator=(const BoundedTaskQueue&) = delete;
+
+    // false, with the task dropped, if the queue is full
+    bool submit(std::function<void()> task) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ < max_running_) {
+            running_++;
+            pool_.submit([this, task = std::move(task)]() mutable { run(std::move(task)); });
+            return true;
+        }
+        if (waiting_.size() >= max_waiting_) {
+            return false;
+        }
+        waiting_.push_back(std::move(task));
+        return true;
+    }
+
+private:
+    void run(std::function<void()> task) {
+        for (;;) {
+            task();
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (waiting_.empty()) {
+                running_--;
+                return;
+            }
+            task = std::move(waiting_.front());
+            waiting_.pop_front();
+        }
+    }
+
+    ThreadPool& pool_;
+    const size_t max_running_;
+    const size_t max_waiting_;
+    size_t running_;
+    std::deque<std::function<void()>> waiting_;
+    std::mutex mutex_;
+};
+
+// run fn(i) for every i in [0, count) on up to num_threads threads, the calling thread included.
+// helpers that haven't started by the time the caller runs out of work simply do nothing, so this
+// is safe to call from inside a pool task even when every worker is busy
+inline void parallel_for(ThreadPool& pool, size_t count, size_t num_threads, const std::function<void(size_t)>& fn) {
+    struct State {
+        std::atomic<size_t> next{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t active = 0;
+        bool done = false;
+    };
+
+    // asking for more threads than cores only leaves idle workers behind
+    num_threads = std::max<size_t>(1, std::min({num_threads, count, max_parallel_threads()}));
+    auto state = std::make_shared<State>();
+
+    auto run = [state, count, &fn] {
+        for (size_t i = state->next++; i < count; i = state->next++) {
+            fn(i);
+        }
+    };
+
+    if (num_threads > 1) {
+        pool.ensure_size(num_threads - 1);
+    }
+    for (size_t t = 1; t < num_threads; t++) {
+        pool.submit([state, run] {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->done) {
+                    return;
+                }
+                state->active++;
+            }
+            run();
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->active--;
+            }
+            state->cv.notify_all();
+        });
+    }
+
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done = true;
+    state->cv.wait(lock, [&state] { return state->active == 0; });
+}
+
+#endif // FLACPY_THREAD_POOL_H
@@ -25,6 +25,7 @@ import numpy as np
 import flacpy
 import time
 import os
+from concurrent.futures import ThreadPoolExecutor
 
 def generate_audio(duration, sample_rate=44100, channels=2):
     """Generate test audio data."""
@@ -92,5 +93,128 @@ def run_benchmark():
     os.remove(temp_file)
     print("\nBenchmark complete!")
 
+def run_threaded_benchmark():
+    # Test parameters
+    duration = 30  # seconds
+    sample_rate = 44100
+    jobs = 32
+    thread_counts = [1, 2, 4, 8]
+    # one file per job, so that concurrent saves never write to the same path
+    temp_files = [f"benchmark_thread_{i}.flac" for i in range(jobs)]
+    
+    print("\n=== FLACPY THREADED BENCHMARK ===")
+    audio = generate_audio(duration, sample_rate)
+    samples = audio.shape[0]
+    print(f"{jobs} jobs of {duration} seconds of audio per run, cpu count: {os.cpu_count()}")
+    
+    def save_job(i):
+        flacpy.save(temp_files[i], audio, sample_rate=sample_rate, bits_per_sample=16)
+    
+    def load_job(i):
+        return flacpy.load(temp_files[i])
+    
+    for name, job in [("SAVE", save_job), ("LOAD", load_job)]:
+        print(f"\n{name} SCALING:")
+        base_elapsed = None
+        for threads in thread_counts:
+            with ThreadPoolExecutor(max_workers=threads) as executor:
+                start_time = time.time()
+                list(executor.map(job, range(jobs)))
+                elapsed = time.time() - start_time
+            if base_elapsed is None:
+                base_elapsed = elapsed
+            print(f"  {threads} threads: {elapsed:.3f} seconds, "
+                  f"{jobs * samples / elapsed:.1f} samples/sec, speedup {base_elapsed / elapsed:.2f}x")
+    
+    # Clean up
+    for temp_file in temp_files:
+        if os.path.exists(temp_file):
+            os.remove(temp_file)
+
+def run_seektable_benchmark():
+    # Test parameters
+    duration = 600  # seconds
+    sample_rate = 44100
+    loads = 200
+    length = sample_rate  # one second per load
+    temp_file = "benchmark_seek.flac"
+    
+    print("\n=== FLACPY SEEKTABLE BENCHMARK ===")
+    audio = generate_audio(duration, sample_rate)
+    samples = audio.shape[0]
+    rng = np.random.default_rng(0)
+    offsets = rng.integers(0, samples - length, loads)
+    print(f"{loads} random {length}-sample loads from {duration} seconds of audio")
+    
+    for name, interval in [("no seektable", 0), ("seekpoint every 10s", 10.0), ("seekpoint every 1s", 1.0)]:
+        flacpy.save(temp_file, audio, sample_rate=sample_rate, bits_per_sample=16, seekpoint_interval=interval)
+        start_time = time.time()
+        for offset in offsets:
+            flacpy.load(temp_file, start_sample=int(offset), num_samples=length)
+        elapsed = time.time() - start_time
+        print(f"  {name}: {elapsed / loads * 1000:.2f} ms per load")
+    
+    # Clean up
+    os.remove(temp_file)
+
+def run_parallel_load_benchmark():
+    # Test parameters
+    duration = 1200  # seconds
+    sample_rate = 44100
+    thread_counts = [1, 2, 4, 8]
+    temp_file = "benchmark_parallel.flac"
+    
+    print("\n=== FLACPY PARALLEL LOAD BENCHMARK ===")
+    audio = generate_audio(duration, sample_rate)
+    samples = audio.shape[0]
+    flacpy.save(temp_file, audio, sample_rate=sample_rate, bits_per_sample=16)
+    print(f"full load of {duration} seconds of audio, cpu count: {os.cpu_count()}")
+    
+    base_elapsed = None
+    for threads in thread_counts:
+        start_time = time.time()
+        flacpy.load(temp_file, threads=threads)
+        elapsed = time.time() - start_time
+        if base_elapsed is None:
+            base_elapsed = elapsed
+        print(f"  {threads} threads: {elapsed:.3f} seconds, "
+              f"{samples / elapsed:.1f} samples/sec, speedup {base_elapsed / elapsed:.2f}x")
+    
+    # Clean up
+    os.remove(temp_file)
+
+def run_preset_benchmark():
+    # Test parameters
+    durations = [10, 60, 600]  # seconds, to see throughput against file size
+    sample_rate = 44100
+    presets = ["fast", "balanced", None, "small", "archive"]
+    temp_file = "benchmark_presets.flac"
+    
+    print("\n=== FLACPY ENCODER PRESET BENCHMARK ===")
+    for duration in durations:
+        # noise on top of the tones so the presets have something to disagree about
+        audio = generate_audio(duration, sample_rate)
+        audio += np.random.default_rng(0).integers(-256, 256, size=audio.shape, dtype=np.int32)
+        samples = audio.shape[0]
+        pcm_size = samples * audio.shape[1] * 2
+        print(f"save of {duration} seconds of 16 bit stereo audio, single threaded")
+        
+        for preset in presets:
+            for verify in [True, False]:
+                start_time = time.time()
+                flacpy.save(temp_file, audio, sample_rate=sample_rate, bits_per_sample=16, preset=preset, verify=verify)
+                elapsed = time.time() - start_time
+                file_size = os.path.getsize(temp_file)
+                print(f"  {preset or 'default':>8}, verify {'on ' if verify else 'off'}: {elapsed:.3f} seconds, "
+                      f"{samples / elapsed / 1e6:.2f} M samples/sec, {file_size / 1024.0:.1f} KB, "
+                      f"ratio {file_size / pcm_size:.3f}")
+    
+    # Clean up
+    os.remove(temp_file)
+
 if __name__ == "__main__":
-    run_benchmark()
\ No newline at end of file
+    run_benchmark()
+    run_threaded_benchmark()
+    run_seektable_benchmark()
+    run_parallel_load_benchmark()
+    run_preset_benchmark()
\ No newline at end of file
@@ -25,6 +25,11 @@ import numpy as np
 import flacpy
 import os
 import time
+import asyncio
+import collections.abc
+import gc
+import weakref
+from concurrent.futures import ThreadPoolExecutor
 
 def get_test_data(sample_rate: int = 32000):
     duration = 2.0  # seconds
@@ -99,5 +104,845 @@ def test_load_and_save():
     #os.remove(test_filename)
     print("All tests completed!")
 
+def test_partial_load_matches_full():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    output_file = "./tests/test_partial.flac"
+    flacpy.save(output_file, audio_data, sample_rate=sample_rate, bits_per_sample=16)
+
+    full = flacpy.load(output_file)
+    assert full["audio"].dtype == np.int32
+    assert np.array_equal(full["audio"], audio_data)
+
+    # ranges inside, across and past the end of the stream
+    for start, length in [(1000, 5000), (0, 1), (len(audio_data) - 100, 1000)]:
+        segment = flacpy.load(output_file, start_sample=start, num_samples=length)
+        assert np.array_equal(segment["audio"], audio_data[start:start + length])
+
+    os.remove(output_file)
+
+def test_load_many():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    output_files = [f"./tests/test_many_{i}.flac" for i in range(4)]
+    for i, output_file in enumerate(output_files):
+        flacpy.save(output_file, audio_data[i * 1000:], sample_rate=sample_rate, bits_per_sample=16)
+
+    results = flacpy.load_many(output_files, start_samples=500, num_samples=[100, 200, 300, 400], threads=4)
+    for i, result in enumerate(results):
+        assert np.array_equal(result["audio"], audio_data[i * 1000 + 500:i * 1000 + 600 + i * 100])
+
+    # decode into one padded batch array
+    out = np.full((len(output_files), 5000, 2), -1, dtype=np.int32)
+    results = flacpy.load_many(output_files, start_samples=len(audio_data) - 5000 - 1000, out=out)
+    for i, result in enumerate(results):
+        expected = audio_data[len(audio_data) - 5000 - 1000 + i * 1000:][:5000]
+        assert result["num_samples"] == len(expected)
+        assert np.array_equal(out[i, :len(expected)], expected)
+        assert not out[i, len(expected):].any()
+
+    for output_file in output_files:
+        os.remove(output_file)
+
+def test_threaded_save():
+    sample_rate = 32000
+    audio_data = np.tile(get_test_data(sample_rate), (8, 1))
+    audio_data[:, 1] //= 3
+    output_file = "./tests/test_threaded.flac"
+    metadata = {"vorbis_comment": {"TITLE": "Threaded"}}
+
+    for threads in [1, 2, 4, 0]:
+        flacpy.save(output_file, audio_data, metadata=metadata, sample_rate=sample_rate,
+                    bits_per_sample=16, compression_level=8, threads=threads)
+        result = flacpy.load(output_file)
+        assert np.array_equal(result["audio"], audio_data)
+        assert result["metadata"]["total_samples"] == len(audio_data)
+        assert result["metadata"]["vorbis_comment"]["TITLE"] == "Threaded"
+
+        # frames were renumbered correctly if seeking lands on the right samples
+        segment = flacpy.load(output_file, start_sample=300000, num_samples=1000)
+        assert np.array_equal(segment["audio"], audio_data[300000:301000])
+
+    os.remove(output_file)
+
+def test_load_from_memory():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    output_file = "./tests/test_memory.flac"
+    shard_file = "./tests/test_memory.shard"
+    flacpy.save(output_file, audio_data, sample_rate=sample_rate, bits_per_sample=16)
+    with open(output_file, "rb") as f:
+        flac_bytes = f.read()
+
+    for source in [flac_bytes, bytearray(flac_bytes), memoryview(flac_bytes)]:
+        result = flacpy.load(source, start_sample=1234, num_samples=5678)
+        assert np.array_equal(result["audio"], audio_data[1234:1234 + 5678])
+
+    # a stream packed at an unaligned offset inside a larger shard
+    offset = 4097
+    with open(shard_file, "wb") as f:
+        f.write(b"\0" * offset + flac_bytes + b"\0" * 100)
+    result = flacpy.load((shard_file, offset, len(flac_bytes)), start_sample=20000)
+    assert np.array_equal(result["audio"], audio_data[20000:])
+
+    os.remove(output_file)
+    os.remove(shard_file)
+
+def get_seekpoints(flac_bytes):
+    """Return the (sample_number, offset) pairs of the non-placeholder seekpoints in a stream."""
+    pos = 4
+    while True:
+        header = flac_bytes[pos]
+        length = int.from_bytes(flac_bytes[pos + 1:pos + 4], "big")
+        if header & 0x7F == 3:
+            points = np.frombuffer(flac_bytes[pos + 4:pos + 4 + length], dtype=">u8,>u8,>u2")
+            points = points[points["f0"] != 0xFFFFFFFFFFFFFFFF]
+            return list(zip(points["f0"].tolist(), points["f1"].tolist()))
+        if header & 0x80:
+            return []
+        pos += 4 + length
+
+def test_seektable():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+
+    flac_bytes = flacpy.encode(audio_data, sample_rate=sample_rate, seekpoint_interval=0.5)
+    seekpoints = get_seekpoints(flac_bytes)
+    assert len(seekpoints) >= len(audio_data) // sample_rate
+    assert seekpoints[0] == (0, 0)
+    assert all(a[0] < b[0] and a[1] < b[1] for a, b in zip(seekpoints, seekpoints[1:]))
+
+    assert len(get_seekpoints(flacpy.encode(audio_data, sample_rate=sample_rate, seekpoint_interval=8192))) > 1
+    assert get_seekpoints(flacpy.encode(audio_data, sample_rate=sample_rate, seekpoint_interval=0)) == []
+
+    # the seektable comes out of the padding budget, only its 4 byte block header is extra
+    padded = [flacpy.encode(audio_data, sample_rate=sample_rate, seekpoint_interval=interval, metadata_pad_len=8192)
+              for interval in [0, 0.5]]
+    assert len(padded[1]) == len(padded[0]) + 4
+
+    # the threaded encoder resolves the same seektable template
+    assert get_seekpoints(flacpy.encode(audio_data, sample_rate=sample_rate, seekpoint_interval=0.5, threads=4)) == seekpoints
+
+    result = flacpy.load(flac_bytes, start_sample=len(audio_data) // 2, num_samples=1000)
+    assert np.array_equal(result["audio"], audio_data[len(audio_data) // 2:len(audio_data) // 2 + 1000])
+
+def test_frame_index():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    output_file = "./tests/test_index.flac"
+    index_file = "./tests/test_index.flac.idx"
+    flacpy.save(output_file, audio_data, metadata={"vorbis_comment": {"title": "indexed"}},
+                sample_rate=sample_rate, bits_per_sample=16)
+
+    index = flacpy.build_index(output_file, save_path=index_file)
+    assert index.dtype == np.uint64 and index.shape[1] == 2
+    assert index[0, 0] == 0 and np.all(np.diff(index[:, 0]) > 0) and np.all(np.diff(index[:, 1]) > 0)
+    assert np.array_equal(flacpy.build_index(open(output_file, "rb").read()), index)
+
+    for start, length in [(0, 100), (1234, 5678), (int(index[3, 0]), 4096), (len(audio_data) - 10, 0)]:
+        expected = audio_data[start:start + length] if length else audio_data[start:]
+        for source_index in [index, index_file]:
+            result = flacpy.load(output_file, start_sample=start, num_samples=length, index=source_index)
+            assert np.array_equal(result["audio"], expected)
+
+    # once the file is saved again with longer tags every frame moves, and the old index is refused
+    flacpy.save(output_file, audio_data, metadata={"vorbis_comment": {"title": "indexed again"}},
+                sample_rate=sample_rate, bits_per_sample=16)
+    for source_index in [index, index_file]:
+        try:
+            flacpy.load(output_file, start_sample=1234, num_samples=5678, index=source_index)
+            assert False, "a stale index should be rejected"
+        except RuntimeError:
+            pass
+
+    os.remove(output_file)
+    os.remove(index_file)
+
+def test_reader():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    output_file = "./tests/test_reader.flac"
+    flacpy.save(output_file, audio_data, metadata={"vorbis_comment": {"title": "reader"}},
+                sample_rate=sample_rate, bits_per_sample=16)
+
+    with flacpy.open(output_file) as reader:
+        assert reader.channels == 2 and reader.sample_rate == sample_rate and reader.bits_per_sample == 16
+        assert reader.total_samples == len(audio_data)
+        assert reader.metadata["vorbis_comment"]["title"] == "reader"
+
+        # sequential reads that split frames, then random and repeated ones
+        chunks = [reader.read(num_samples=1000) for _ in range(5)]
+        assert np.array_equal(np.concatenate(chunks), audio_data[:5000])
+        assert reader.position == 5000
+        for start, length in [(40000, 3000), (100, 50), (40000, 3000), (len(audio_data) - 20, 0)]:
+            expected = audio_data[start:start + length] if length else audio_data[start:]
+            assert np.array_equal(reader.read(start, length), expected)
+        assert len(reader.read()) == 0
+
+        reader.seek(12345)
+        assert np.array_equal(reader.read(num_samples=10), audio_data[12345:12355])
+
+        # reads from several threads run one at a time while others seek and poll the position
+        def read_at(start):
+            reader.seek(start)
+            assert reader.position >= 0 and not reader.closed
+            return np.array_equal(reader.read(start, 2000), audio_data[start:start + 2000])
+        with ThreadPoolExecutor(max_workers=4) as executor:
+            assert all(executor.map(read_at, range(0, 64000, 1000)))
+    assert reader.closed
+
+    os.remove(output_file)
+
+def test_iter_chunks():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    output_file = "./tests/test_chunks.flac"
+    flacpy.save(output_file, audio_data, sample_rate=sample_rate, bits_per_sample=16)
+
+    for prefetch in [0, 1, 3]:
+        chunks = list(flacpy.iter_chunks(output_file, 5000, prefetch=prefetch))
+        assert all(len(chunk) == 5000 for chunk in chunks[:-1]) and 0 < len(chunks[-1]) <= 5000
+        assert np.array_equal(np.concatenate(chunks), audio_data)
+
+        chunks = list(flacpy.iter_chunks(output_file, 3000, start_sample=1234, num_samples=10000, prefetch=prefetch))
+        assert [len(chunk) for chunk in chunks] == [3000, 3000, 3000, 1000]
+        assert np.array_equal(np.concatenate(chunks), audio_data[1234:11234])
+
+    # abandoning an iterator part way stops its background decoder
+    iterator = flacpy.iter_chunks(output_file, 1000, prefetch=2)
+    assert np.array_equal(next(iterator), audio_data[:1000])
+    iterator.close()
+    assert list(iterator) == []
+
+    # closing from another thread while a synchronous iterator is reading doesn't deadlock
+    for _ in range(20):
+        iterator = flacpy.iter_chunks(output_file, 100, prefetch=0)
+        with ThreadPoolExecutor(max_workers=1) as executor:
+            def drain():
+                try:
+                    return len(list(iterator))
+                except RuntimeError:
+                    return -1
+            count = executor.submit(drain)
+            iterator.close()
+            assert count.result(timeout=10) <= 640
+
+    os.remove(output_file)
+
+def test_writer():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    output_file = "./tests/test_writer.flac"
+    blocks = np.array_split(audio_data, 7)
+
+    for background in [False, True]:
+        with flacpy.Writer(output_file, 2, sample_rate, metadata={"vorbis_comment": {"title": "live"}},
+                           background=background, max_queued=2) as writer:
+            for block in blocks:
+                writer.write(block)
+        assert writer.closed and writer.samples_written == len(audio_data)
+        result = flacpy.load(output_file)
+        assert np.array_equal(result["audio"], audio_data)
+        assert result["metadata"]["total_samples"] == len(audio_data)
+        assert result["metadata"]["vorbis_comment"]["title"] == "live"
+
+        writer = flacpy.Writer(None, 2, sample_rate, total_samples=len(audio_data), background=background)
+        for block in blocks:
+            writer.write(block)
+        writer.close()
+        flac_bytes = writer.getvalue()
+        assert writer.bytes_written == len(flac_bytes)
+        assert len(get_seekpoints(flac_bytes)) > 0
+        assert np.array_equal(flacpy.load(flac_bytes)["audio"], audio_data)
+
+        out = bytearray(len(flac_bytes) + 10)
+        with flacpy.Writer(out, 2, sample_rate, total_samples=len(audio_data), background=background) as writer:
+            for block in blocks:
+                writer.write(block)
+        assert out[:len(flac_bytes)] == flac_bytes
+
+        # blocks written from several threads at once are encoded one whole block at a time
+        writer = flacpy.Writer(None, 2, sample_rate, background=background)
+        with ThreadPoolExecutor(max_workers=4) as executor:
+            list(executor.map(writer.write, [audio_data[:1000]] * 16))
+        writer.close()
+        assert writer.samples_written == 16000
+        assert np.array_equal(flacpy.load(writer.getvalue())["audio"], np.tile(audio_data[:1000], (16, 1)))
+
+        # and a close racing the writes either lets a write through or fails it as closed
+        out = bytearray(1 << 20)
+        writer = flacpy.Writer(out, 2, sample_rate, background=background)
+        def write_or_closed(block):
+            try:
+                writer.write(block)
+                return True
+            except ValueError:
+                return False
+        with ThreadPoolExecutor(max_workers=4) as executor:
+            results = executor.map(write_or_closed, [audio_data[:1000]] * 32)
+            writer.close()
+            written = sum(results)
+        assert writer.closed and writer.samples_written == written * 1000
+
+    for level in [-1, 9]:
+        try:
+            flacpy.Writer(None, 2, sample_rate, compression_level=level)
+            assert False, "compression levels outside 0-8 should be rejected"
+        except ValueError:
+            pass
+
+    os.remove(output_file)
+
+def test_encode_to_memory():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    metadata = {"vorbis_comment": {"title": "in memory"}}
+
+    for threads in [1, 4]:
+        flac_bytes = flacpy.encode(audio_data, metadata=metadata, sample_rate=sample_rate, threads=threads)
+        assert isinstance(flac_bytes, bytes) and flac_bytes[:4] == b"fLaC"
+        result = flacpy.load(flac_bytes)
+        assert np.array_equal(result["audio"], audio_data)
+        assert result["metadata"]["total_samples"] == len(audio_data)
+        assert result["metadata"]["vorbis_comment"]["title"] == "in memory"
+
+        out = bytearray(len(flac_bytes) + 100)
+        num_bytes = flacpy.encode(audio_data, metadata=metadata, sample_rate=sample_rate, threads=threads, out=out)
+        assert num_bytes == len(flac_bytes) and out[:num_bytes] == flac_bytes
+
+        try:
+            flacpy.encode(audio_data, sample_rate=sample_rate, threads=threads, out=bytearray(1000))
+            assert False, "encoding into a buffer that is too small should fail"
+        except ValueError:
+            pass
+
+def test_save_array_layouts():
+    sample_rate = 32000
+    audio_data = np.tile(get_test_data(sample_rate), (4, 1))
+    audio_data[:, 1] //= 3
+    reference = flacpy.encode(audio_data, sample_rate=sample_rate)
+
+    # fortran-ordered, channel-major transposed, strided and byte-swapped arrays all encode the same stream
+    wide = np.repeat(audio_data, 2, axis=0)
+    layouts = [np.asfortranarray(audio_data), np.ascontiguousarray(audio_data.T).T,
+               wide[::2], audio_data.astype(">i4")]
+    for layout in layouts:
+        for threads in [1, 4]:
+            flac_bytes = flacpy.encode(layout, sample_rate=sample_rate, threads=threads)
+            assert np.array_equal(flacpy.load(flac_bytes)["audio"], audio_data)
+            if threads == 1:
+                assert flac_bytes == reference
+
+        with flacpy.Writer(None, 2, sample_rate) as writer:
+            for block in np.array_split(layout, 5):
+                writer.write(block)
+        assert np.array_equal(flacpy.load(writer.getvalue())["audio"], audio_data)
+
+def test_load_dtype():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    flac_bytes = flacpy.encode(audio_data, sample_rate=sample_rate, bits_per_sample=16)
+    flac_24 = flacpy.encode(audio_data * 256, sample_rate=sample_rate, bits_per_sample=24)
+
+    expected = {
+        (np.int16, False): audio_data.astype(np.int16),
+        (np.int16, True): audio_data.astype(np.int16),
+        (np.int32, True): audio_data << 16,
+        (np.float32, False): audio_data.astype(np.float32),
+        (np.float32, True): audio_data.astype(np.float32) / 32768,
+        (np.float64, True): audio_data / 32768,
+    }
+    for (dtype, normalize), reference in expected.items():
+        audio = flacpy.load(flac_bytes, dtype=dtype, normalize=normalize)["audio"]
+        assert audio.dtype == dtype and np.array_equal(audio, reference)
+
+        # ranges, and 24-bit streams normalized to the same scale
+        segment = flacpy.load(flac_bytes, start_sample=1000, num_samples=500, dtype=dtype, normalize=normalize)["audio"]
+        assert np.array_equal(segment, reference[1000:1500])
+        if normalize:
+            audio = flacpy.load(flac_24, dtype=dtype, normalize=True)["audio"]
+            assert np.array_equal(audio, reference)
+
+    assert flacpy.load(flac_bytes, dtype="float32")["audio"].dtype == np.float32
+    for dtype in [np.uint8, np.complex64, ">f4"]:
+        try:
+            flacpy.load(flac_bytes, dtype=dtype)
+            assert False, "unsupported dtypes should be rejected"
+        except ValueError:
+            pass
+    try:
+        flacpy.load(flac_24, dtype=np.int16)
+        assert False, "24-bit audio should need normalize=True to fit in int16"
+    except RuntimeError:
+        pass
+
+def test_save_dtypes():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    reference = flacpy.encode(audio_data, sample_rate=sample_rate)
+
+    # every input dtype quantizes to the same 16-bit stream, threaded or not
+    inputs = [
+        (audio_data.astype(np.int16), False),
+        (audio_data.astype(np.int16), True),
+        (audio_data << 16, True),
+        (audio_data.astype(np.float32), False),
+        (audio_data.astype(np.float32) / 32768, True),
+        (np.asfortranarray(audio_data / 32768), True),
+    ]
+    for audio, normalize in inputs:
+        for threads in [1, 4]:
+            flac_bytes = flacpy.encode(audio, sample_rate=sample_rate, threads=threads, normalize=normalize)
+            assert np.array_equal(flacpy.load(flac_bytes)["audio"], audio_data)
+            if threads == 1:
+                assert flac_bytes == reference
+
+    # floats are clipped to the sample range, and dither stays within one step of the signal
+    loud = np.clip(audio_data.astype(np.float64) / 16384, -1.5, 1.5)
+    clipped = flacpy.load(flacpy.encode(loud, sample_rate=sample_rate, normalize=True))["audio"]
+    assert clipped.max() == 32767 and clipped.min() == -32768
+    quiet = audio_data.astype(np.float32) / 32768 * 0.1
+    dithered = flacpy.load(flacpy.encode(quiet, sample_rate=sample_rate, normalize=True, dither=True))["audio"]
+    assert np.abs(dithered - quiet * 32768).max() < 1.5
+    assert not np.array_equal(dithered, np.round(quiet * 32768))
+
+    # dither is the same however the stream is split up
+    output_file = "./tests/test_dither.flac"
+    for threads in [1, 4]:
+        flacpy.save(output_file, quiet, sample_rate=sample_rate, normalize=True, dither=True, threads=threads)
+        assert np.array_equal(flacpy.load(output_file)["audio"], dithered)
+    os.remove(output_file)
+
+def test_parallel_load():
+    sample_rate = 32000
+    audio_data = np.tile(get_test_data(sample_rate), (8, 1))
+    audio_data[:, 1] //= 3
+
+    # with a seektable, without one, and with a frame index
+    with_seektable = flacpy.encode(audio_data, sample_rate=sample_rate, seekpoint_interval=1.0)
+    without_seektable = flacpy.encode(audio_data, sample_rate=sample_rate, seekpoint_interval=0)
+    index = flacpy.build_index(without_seektable)
+    for flac_bytes, flac_index in [(with_seektable, None), (without_seektable, None), (without_seektable, index)]:
+        for threads in [2, 3, 8, 0]:
+            result = flacpy.load(flac_bytes, threads=threads, index=flac_index)
+            assert np.array_equal(result["audio"], audio_data)
+            segment = flacpy.load(flac_bytes, start_sample=12345, num_samples=300000, threads=threads,
+                                  index=flac_index, dtype=np.float32, normalize=True)["audio"]
+            assert np.array_equal(segment, audio_data[12345:312345].astype(np.float32) / 32768)
+
+    # truncated streams still load whatever is there
+    truncated = flacpy.load(with_seektable[:len(with_seektable) // 2], threads=4)["audio"]
+    assert 0 < len(truncated) < len(audio_data)
+    assert np.array_equal(truncated, audio_data[:len(truncated)])
+
+def test_load_channels():
+    sample_rate = 32000
+    stereo = np.tile(get_test_data(sample_rate), (4, 1))
+    audio_data = np.hstack([stereo, stereo // 3, -stereo // 5])
+    flac_bytes = flacpy.encode(audio_data, sample_rate=sample_rate)
+
+    for threads in [1, 4]:
+        audio = flacpy.load(flac_bytes, channels=[2], threads=threads)["audio"]
+        assert audio.shape == (len(audio_data), 1) and np.array_equal(audio, audio_data[:, [2]])
+        audio = flacpy.load(flac_bytes, channels=[3, 0, 3], start_sample=1000, num_samples=70000, threads=threads)["audio"]
+        assert np.array_equal(audio, audio_data[1000:71000, [3, 0, 3]])
+
+        mono = flacpy.load(flac_bytes, downmix="mono", threads=threads)["audio"]
+        assert mono.shape == (len(audio_data), 1)
+        assert np.array_equal(mono[:, 0], np.floor(audio_data.mean(axis=1) + 0.5))
+        mono = flacpy.load(flac_bytes, channels=[0, 2], downmix="mono", dtype=np.float32, normalize=True,
+                           threads=threads)["audio"]
+        assert np.array_equal(mono[:, 0], (audio_data[:, [0, 2]].mean(axis=1) / 32768).astype(np.float32))
+
+    for kwargs in [{"channels": []}, {"channels": [-1]}, {"downmix": "stereo"}]:
+        try:
+            flacpy.load(flac_bytes, **kwargs)
+            assert False, "invalid channel selections should be rejected"
+        except ValueError:
+            pass
+    try:
+        flacpy.load(flac_bytes, channels=[4])
+        assert False, "channels past the end of the stream should be rejected"
+    except RuntimeError:
+        pass
+
+def test_overview():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    audio_data[:, 1] //= 3
+    flac_bytes = flacpy.encode(audio_data, sample_rate=sample_rate)
+
+    def reference(audio, block):
+        bins = [audio[i:i + block].astype(np.float64) for i in range(0, len(audio), block)]
+        return (np.array([b.min(axis=0) for b in bins]), np.array([b.max(axis=0) for b in bins]),
+                np.array([np.sqrt((b ** 2).mean(axis=0)) for b in bins]))
+
+    for kwargs, audio in [({"bins": 100}, audio_data), ({"block": 4096}, audio_data),
+                          ({"bins": 7, "start_sample": 10000, "num_samples": 30001}, audio_data[10000:40001])]:
+        result = flacpy.overview(flac_bytes, **kwargs)
+        low, high, rms = reference(audio, result["block"])
+        assert result["num_samples"] == len(audio) and result["min"].shape == low.shape
+        assert np.array_equal(result["min"], low) and np.array_equal(result["max"], high)
+        assert np.allclose(result["rms"], rms)
+    assert flacpy.overview(flac_bytes, bins=100)["min"].shape == (100, 2)
+
+def test_encoder_options():
+    sample_rate = 44100
+    audio_data = get_test_data(sample_rate)[:sample_rate * 4]
+
+    sizes = {}
+    for preset in [None, "fast", "balanced", "small", "archive"]:
+        for threads in [1, 4]:
+            flac_bytes = flacpy.encode(audio_data, sample_rate=sample_rate, preset=preset, threads=threads)
+            result = flacpy.load(flac_bytes)
+            assert np.array_equal(result["audio"], audio_data)
+            sizes[preset] = len(flac_bytes)
+            # STREAMINFO's md5 follows "fLaC", the block header and 18 bytes of stream info
+            md5 = flac_bytes[26:42]
+            assert (md5 == bytes(16)) == (preset == "fast")
+    assert sizes["fast"] > sizes["small"]
+
+    # explicit arguments override the preset
+    flac_bytes = flacpy.encode(audio_data, sample_rate=sample_rate, preset="fast", do_md5=True, compression_level=8,
+                               blocksize=1152, max_lpc_order=8, qlp_coeff_precision=12, apodization="tukey(5e-1)",
+                               exhaustive_model_search=False, max_residual_partition_order=4, verify=True)
+    result = flacpy.load(flac_bytes)
+    assert np.array_equal(result["audio"], audio_data)
+    assert flac_bytes[26:42] != bytes(16)
+    assert result["metadata"]["min_blocksize"] == 1152 and result["metadata"]["max_blocksize"] == 1152
+
+    output_file = "./tests/test_encoder_options.flac"
+    flacpy.save(output_file, audio_data, sample_rate=sample_rate, verify=False, do_md5=False)
+    assert np.array_equal(flacpy.load(output_file)["audio"], audio_data)
+    os.remove(output_file)
+
+    for kwargs in [{"preset": "slow"}, {"compression_level": 9}, {"blocksize": 8}]:
+        try:
+            flacpy.encode(audio_data, sample_rate=sample_rate, **kwargs)
+            assert False, "expected ValueError"
+        except ValueError:
+            pass
+
+def test_lazy_metadata():
+    sample_rate = 44100
+    audio_data = get_test_data(sample_rate)[:sample_rate]
+    cover = bytes(range(256)) * 4096
+    metadata = {"vorbis_comment": {"TITLE": "Lazy"},
+                "pictures": [{"type": 3, "mime_type": "image/jpeg", "description": "", "width": 1, "height": 1,
+                              "depth": 24, "colors": 0, "data": cover}]}
+    output_file = "./tests/test_lazy_metadata.flac"
+    flacpy.save(output_file, audio_data, metadata=metadata, sample_rate=sample_rate)
+
+    result = flacpy.load(output_file)
+    loaded = result["metadata"]
+    assert isinstance(loaded, flacpy.Metadata) and isinstance(loaded, collections.abc.Mapping)
+    assert "pictures" in loaded and "missing" not in loaded and loaded.get("missing") is None
+    assert loaded["total_samples"] == len(audio_data) and loaded["sample_rate"] == sample_rate
+    assert loaded["vorbis_comment"] is loaded["vorbis_comment"]
+    assert loaded["vorbis_comment"]["TITLE"] == "Lazy"
+
+    # picture data is a read-only view of the decoded block and outlives the mapping
+    data = loaded["pictures"][0]["data"]
+    assert isinstance(data, memoryview) and data.readonly and data == cover
+    del result, loaded
+    assert bytes(data) == cover
+
+    # a loaded mapping (memoryview data included) saves straight back
+    loaded = flacpy.load(output_file, metadata_only=True)["metadata"]
+    flacpy.save(output_file, audio_data, metadata=loaded, sample_rate=sample_rate)
+    reloaded = flacpy.load(output_file, metadata_only=True)["metadata"]
+    assert reloaded == loaded and reloaded.to_dict() == dict(loaded)
+    assert reloaded["pictures"][0]["data"] == cover
+
+    # a cached value that refers back to its mapping is collected like any other cycle
+    class Marker:
+        pass
+    marker = Marker()
+    marker_ref = weakref.ref(marker)
+    cyclic = flacpy.load(output_file, metadata_only=True)["metadata"]
+    cyclic["vorbis_comment"]["marker"] = marker
+    cyclic["vorbis_comment"]["self"] = cyclic
+    del marker, cyclic
+    gc.collect()
+    assert marker_ref() is None
+
+    os.remove(output_file)
+
+def test_update_metadata():
+    sample_rate = 44100
+    audio_data = get_test_data(sample_rate)[:sample_rate * 2]
+    output_files = [f"./tests/test_update_metadata_{i}.flac" for i in range(3)]
+    for output_file in output_files:
+        flacpy.save(output_file, audio_data, metadata={"vorbis_comment": {"TITLE": "Old", "ALBUM": "Kept?"}},
+                    sample_rate=sample_rate, metadata_pad_len=4096)
+    vendor = flacpy.load(output_files[0], metadata_only=True)["metadata"]["vorbis_comment"]["vendor"]
+
+    # small tag edits fit in the padding and leave the file size alone
+    size = os.path.getsize(output_files[0])
+    assert flacpy.update_metadata(output_files[0], {"vorbis_comment": {"TITLE": "New"}}) is None
+    assert os.path.getsize(output_files[0]) == size
+    result = flacpy.load(output_files[0])
+    assert np.array_equal(result["audio"], audio_data)
+    assert result["metadata"]["vorbis_comment"] == {"vendor": vendor, "TITLE": "New"}
+
+    # a vendor differing from libFLAC's own is kept by later updates that don't name one
+    flacpy.update_metadata(output_files[0], {"vorbis_comment": {"vendor": "custom", "TITLE": "New"}})
+    assert flacpy.load(output_files[0], metadata_only=True)["metadata"]["vorbis_comment"]["vendor"] == "custom"
+    flacpy.update_metadata(output_files[0], {"vorbis_comment": {"TITLE": "New"}})
+    assert flacpy.load(output_files[0], metadata_only=True)["metadata"]["vorbis_comment"] == {"vendor": "custom", "TITLE": "New"}
+
+    # a picture bigger than the padding rewrites the file around the same frames
+    picture = {"type": 3, "mime_type": "image/png", "description": "", "width": 1, "height": 1,
+               "depth": 24, "colors": 0, "data": bytes(range(256)) * 64}
+    flacpy.update_metadata(output_files[0], {"pictures": [picture]})
+    assert os.path.getsize(output_files[0]) > size
+    result = flacpy.load(output_files[0])
+    assert np.array_equal(result["audio"], audio_data)
+    assert result["metadata"]["vorbis_comment"]["TITLE"] == "New"
+    assert result["metadata"]["pictures"] == [picture]
+    flacpy.update_metadata(output_files[0], {"pictures": [], "vorbis_comment": None})
+    assert "pictures" not in flacpy.load(output_files[0], metadata_only=True)["metadata"]
+    assert "vorbis_comment" not in flacpy.load(output_files[0], metadata_only=True)["metadata"]
+
+    # batch form, one mapping per file, failures reported per file
+    errors = flacpy.update_metadata(output_files[1:] + ["./tests/missing.flac"],
+                                    [{"vorbis_comment": {"TITLE": str(i)}} for i in range(3)], threads=2)
+    assert errors[:2] == [None, None] and errors[2]
+    for i, output_file in enumerate(output_files[1:]):
+        assert flacpy.load(output_file, metadata_only=True)["metadata"]["vorbis_comment"]["TITLE"] == str(i)
+    try:
+        flacpy.update_metadata("./tests/missing.flac", {"vorbis_comment": {}})
+        assert False, "expected RuntimeError"
+    except RuntimeError:
+        pass
+
+    for output_file in output_files:
+        os.remove(output_file)
+
+def test_scan():
+    sample_rate = 32000
+    audio_data = get_test_data(sample_rate)
+    picture = {"type": 3, "mime_type": "image/png", "description": "cover", "width": 16, "height": 16,
+               "depth": 24, "colors": 0, "data": b"\x89PNG" + bytes(range(256)) * 100}
+    metadata = {"vorbis_comment": {"TITLE": "First", "artist": "Someone"}, "pictures": [picture]}
+    output_file = "./tests/test_scan.flac"
+    flacpy.save(output_file, audio_data, metadata=metadata, sample_rate=sample_rate, bits_per_sample=24)
+    mono = flacpy.encode(audio_data[:1000, :1], sample_rate=16000)
+    sources = [output_file, mono, b"not a flac stream", "./tests/missing.flac"]
+
+    result = flacpy.scan(sources, threads=2)
+    assert result["valid"].tolist() == [True, True, False, False]
+    assert result["sample_rate"][:2].tolist() == [sample_rate, 16000]
+    assert result["channels"][:2].tolist() == [2, 1]
+    assert result["bits_per_sample"][0] == 24 and result["total_samples"][:2].tolist() == [len(audio_data), 1000]
+    assert result["errors"][:2] == [None, None] and all(result["errors"][2:])
+    tags = [{k: v for k, v in t.items() if k != "vendor"} for t in result["tags"]]
+    assert tags == [{"TITLE": "First", "artist": "Someone"}, {}, {}, {}]
+    assert result["tags"][0] == flacpy.load(output_file, metadata_only=True)["metadata"]["vorbis_comment"]
+    assert "pictures" not in result
+
+    result = flacpy.scan(sources, fields=["title", "ALBUM"], include_pictures=True)
+    assert result["tags"] == {"title": ["First", None, None, None], "ALBUM": [None] * 4}
+    assert result["pictures"][0] == [picture] and result["pictures"][1:] == [[], [], []]
+    assert "tags" not in flacpy.scan(sources, fields=[])
+
+    os.remove(output_file)
+
+def test_load_async():
+    sample_rate = 32000
+    audio_data = np.tile(get_test_data(sample_rate), (30, 1))
+    flac_bytes = flacpy.encode(audio_data, sample_rate=sample_rate)
+
+    async def run():
+        # results match load, with many loads in flight at once
+        crops = [(i * 40000, 20000) for i in range(40)]
+        results = await asyncio.gather(*[flacpy.load_async(flac_bytes, start_sample=start, num_samples=length)
+                                         for start, length in crops])
+        for (start, length), result in zip(crops, results):
+            assert np.array_equal(result["audio"], audio_data[start:start + length])
+        metadata = await flacpy.load_async(flac_bytes, metadata_only=True)
+        assert "audio" not in metadata and metadata["metadata"]["sample_rate"] == sample_rate
+
+        # cancelling the future stops the decode
+        future = flacpy.load_async(flac_bytes)
+        future.cancel()
+        try:
+            await future
+            assert False, "Expected the load to be cancelled"
+        except asyncio.CancelledError:
+            pass
+
+        # a zero timeout fails before anything is decoded
+        try:
+            await flacpy.load_async(flac_bytes, timeout=0)
+            assert False, "Expected TimeoutError"
+        except TimeoutError:
+            pass
+        result = await flacpy.load_async(flac_bytes, timeout=60, dtype=np.float32, normalize=True)
+        assert np.array_equal(result["audio"], audio_data.astype(np.float32) / 32768)
+
+        try:
+            await flacpy.load_async(b"not a flac stream")
+            assert False, "Expected RuntimeError"
+        except RuntimeError:
+            pass
+
+    asyncio.run(run())
+
+def test_decoder_pool():
+    sample_rate = 32000
+    audio_data = np.tile(get_test_data(sample_rate), (4, 1))
+    flac_bytes = flacpy.encode(audio_data, sample_rate=sample_rate, seekpoint_interval=1.0)
+    pool = flacpy.DecoderPool(max_decoders=4)
+
+    # pooled loads match plain ones, including parallel and converted ones
+    for kwargs in [{}, {"start_sample": 1234, "num_samples": 50000}, {"threads": 4},
+                   {"dtype": np.float32, "normalize": True}, {"channels": [1]}]:
+        expected = flacpy.load(flac_bytes, **kwargs)
+        result = pool.load(flac_bytes, **kwargs)
+        assert np.array_equal(result["audio"], expected["audio"]) and result["audio"].dtype == expected["audio"].dtype
+        assert result["metadata"] == expected["metadata"]
+    assert pool.idle_decoders > 0
+
+    # a freed array's memory backs the next one of a similar size
+    audio = pool.load(flac_bytes, num_samples=40000)["audio"]
+    address = audio.__array_interface__["data"][0]
+    del audio
+    assert pool.idle_bytes > 0
+    audio = pool.load(flac_bytes, start_sample=5, num_samples=39000)["audio"]
+    assert audio.__array_interface__["data"][0] == address
+    assert np.array_equal(audio, audio_data[5:39005])
+
+    # arrays stay valid after the pool is gone, and short streams still load
+    truncated = pool.load(flac_bytes[:len(flac_bytes) // 2])["audio"]
+    del pool
+    assert 0 < len(truncated) < len(audio_data)
+    assert np.array_equal(truncated, audio_data[:len(truncated)])
+    assert np.array_equal(audio, audio_data[5:39005])
+
+def test_load_into_out():
+    sample_rate = 32000
+    audio_data = np.tile(get_test_data(sample_rate), (4, 1))
+    audio_data[:, 1] //= 3
+    flac_bytes = flacpy.encode(audio_data, sample_rate=sample_rate, seekpoint_interval=1.0)
+
+    # rows of a batch array, at an offset, with the dtype taken from the batch
+    batch = np.zeros((3, 60000, 2), dtype=np.float32)
+    for i in range(3):
+        result = flacpy.load(flac_bytes, start_sample=i * 1000, num_samples=50000, out=batch[i], out_offset=10000,
+                             normalize=True)
+        assert np.shares_memory(result["audio"], batch) and len(result["audio"]) == 50000
+        assert np.array_equal(batch[i, 10000:], audio_data[i * 1000:i * 1000 + 50000].astype(np.float32) / 32768)
+        assert not batch[i, :10000].any()
+
+    # strided views: channel-major storage, every other frame, reversed, and one channel of many
+    expected = audio_data[:40000]
+    channel_major = np.zeros((2, 40000), dtype=np.int32)
+    flacpy.load(flac_bytes, num_samples=40000, out=channel_major.T, threads=4)
+    assert np.array_equal(channel_major.T, expected)
+    every_other = np.zeros((80000, 2), dtype=np.int32)
+    flacpy.load(flac_bytes, num_samples=40000, out=every_other[::2])
+    assert np.array_equal(every_other[::2], expected) and not every_other[1::2].any()
+    reversed_out = np.zeros((40000, 2), dtype=np.int16)
+    flacpy.load(flac_bytes, num_samples=40000, out=reversed_out[::-1])
+    assert np.array_equal(reversed_out[::-1], expected)
+    wide = np.zeros((40000, 4), dtype=np.float64)
+    flacpy.load(flac_bytes, num_samples=40000, out=wide[:, 2], channels=[1])
+    assert np.array_equal(wide[:, 2], expected[:, 1]) and not wide[:, [0, 1, 3]].any()
+
+    # a short stream fills what it can
+    short = np.full((len(audio_data) + 100, 2), -1, dtype=np.int32)
+    result = flacpy.load(flac_bytes, out=short)
+    assert len(result["audio"]) == len(audio_data) and np.array_equal(short[:len(audio_data)], audio_data)
+    assert (short[len(audio_data):] == -1).all()
+
+    # mismatches are refused
+    for out, kwargs in [(np.zeros((100, 3), dtype=np.int32), {}), (np.zeros((100, 2), dtype=np.int32), {"dtype": np.float32}),
+                        (np.zeros((100, 2), dtype=np.uint8), {}), (np.zeros((100, 2), dtype=np.int32), {"out_offset": 101})]:
+        try:
+            flacpy.load(flac_bytes, out=out, **kwargs)
+            assert False, "Expected an error"
+        except (ValueError, TypeError, RuntimeError):
+            pass
+    readonly = np.zeros((100, 2), dtype=np.int32)
+    readonly.flags.writeable = False
+    try:
+        flacpy.load(flac_bytes, out=readonly)
+        assert False, "Expected an error"
+    except (ValueError, BufferError):
+        pass
+
+    # as are layouts where two samples would land on the same element
+    base = np.zeros(400, dtype=np.int32)
+    for strides in [(0, 4), (8, 0), (4, 4), (8, 16)]:
+        try:
+            flacpy.load(flac_bytes, out=np.lib.stride_tricks.as_strided(base, shape=(100, 2), strides=strides))
+            assert False, "Expected an error"
+        except ValueError:
+            pass
+
+def test_stats():
+    sample_rate = 32000
+    audio_data = np.tile(get_test_data(sample_rate), (4, 1))
+    flac_bytes = flacpy.encode(audio_data, sample_rate=sample_rate, seekpoint_interval=1.0)
+    flacpy.stats(reset=True, enable=False)
+
+    # a single call's stats, which are also counted while collection is off
+    result = flacpy.load(flac_bytes, start_sample=100000, num_samples=20000, return_stats=True)
+    assert np.array_equal(result["audio"], audio_data[100000:120000])
+    stats = result["stats"]
+    assert stats["calls"] == 1 and stats["seeks"] == 1 and stats["frames_decoded"] > 0
+    assert 0 < stats["bytes_read"] and stats["output_ns"] > 0
+    assert stats["total_ns"] >= stats["open_ns"] + stats["metadata_ns"] + stats["decode_ns"] > 0
+    assert "stats" not in flacpy.load(flac_bytes, num_samples=10)
+    skipped = flacpy.load(flac_bytes, start_sample=100000, num_samples=20000, index=flacpy.build_index(flac_bytes),
+                          return_stats=True)["stats"]
+    assert skipped["frames_skipped"] == 0 and skipped["seeks"] == 1
+
+    totals = flacpy.stats()
+    assert not totals["enabled"] and totals["load"]["calls"] == 2 and totals["save"]["calls"] == 0
+    assert totals["load"]["frames_decoded"] == stats["frames_decoded"] + skipped["frames_decoded"]
+
+    # with collection on, every load and save adds to the totals
+    output_file = "./tests/test_stats.flac"
+    flacpy.stats(enable=True)
+    try:
+        flacpy.load(flac_bytes, threads=4)
+        flacpy.save(output_file, audio_data.astype(np.float32) / 32768, normalize=True, sample_rate=sample_rate)
+        os.remove(output_file)
+        flacpy.encode(audio_data, sample_rate=sample_rate)
+        totals = flacpy.stats(reset=True)
+    finally:
+        flacpy.stats(enable=False)
+    assert totals["load"]["calls"] == 1 and totals["load"]["bytes_read"] >= len(flac_bytes)
+    assert totals["save"]["calls"] == 2 and totals["save"]["samples_encoded"] == 2 * len(audio_data)
+    assert totals["save"]["convert_ns"] > 0 and totals["save"]["encode_ns"] > 0 and totals["save"]["finish_ns"] > 0
+    cleared = flacpy.stats()
+    assert not any(cleared["load"].values()) and not any(cleared["save"].values())
+
 if __name__ == "__main__":
-    test_load_and_save()
\ No newline at end of file
+    test_load_and_save()
+    test_partial_load_matches_full()
+    test_load_many()
+    test_threaded_save()
+    test_load_from_memory()
+    test_encode_to_memory()
+    test_seektable()
+    test_frame_index()
+    test_reader()
+    test_iter_chunks()
+    test_writer()
+    test_save_array_layouts()
+    test_load_dtype()
+    test_save_dtypes()
+    test_parallel_load()
+    test_load_channels()
+    test_overview()
+    test_encoder_options()
+    test_lazy_metadata()
+    test_scan()
+    test_update_metadata()
+    test_load_async()
+    test_decoder_pool()
+    test_load_into_out()
+    test_stats()